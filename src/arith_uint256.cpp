@@ -76,6 +76,21 @@ base_uint<BITS>& base_uint<BITS>::operator*=(const base_uint& b)
 template <unsigned int BITS>
 base_uint<BITS>& base_uint<BITS>::operator/=(const base_uint& b)
 {
+    // Divisors that fit in one limb, such as the block counts of difficulty
+    // retargeting, are divided limb by limb instead of bit by bit.
+    bool single_limb = b.pn[0] != 0;
+    for (int i = 1; i < WIDTH && single_limb; i++)
+        single_limb = b.pn[i] == 0;
+    if (single_limb) {
+        uint64_t rem = 0;
+        for (int i = WIDTH - 1; i >= 0; i--) {
+            const uint64_t cur = (rem << 32) | pn[i];
+            pn[i] = cur / b.pn[0];
+            rem = cur % b.pn[0];
+        }
+        return *this;
+    }
+
     base_uint<BITS> div = b;     // make a copy, so we can shift.
     base_uint<BITS> num = *this; // make a copy, so we can subtract.
     *this = 0;                   // the quotient.
@@ -6,9 +6,12 @@
 #include <bench/bench.h>
 #include <coins.h>
 #include <policy/policy.h>
+#include <random.h>
 #include <script/signingprovider.h>
 #include <test/util/transaction_utils.h>
 
+#include <cassert>
+#include <type_traits>
 #include <vector>
 
 // Microbenchmark for simple accesses to a CCoinsViewCache database. Note from
@@ -51,4 +54,86 @@ static void CCoinsCaching(benchmark::Bench& bench)
     ECC_Stop();
 }
 
+
+namespace {
+constexpr size_t NUM_MAP_COINS{100'000};
+
+std::vector<COutPoint> RandomOutpoints(FastRandomContext& rng, size_t count)
+{
+    std::vector<COutPoint> outpoints;
+    outpoints.reserve(count);
+    for (size_t i{0}; i < count; ++i) {
+        outpoints.emplace_back(Txid::FromUint256(rng.rand256()), rng.randrange(4));
+    }
+    return outpoints;
+}
+
+//! Empty, for the maps that take no memory resource
+struct NoResource {
+};
+
+template <typename Map>
+using ResourceFor = std::conditional_t<std::is_same_v<Map, CCoinsNodeMap>, CCoinsNodeMap::allocator_type::ResourceType, NoResource>;
+
+template <typename Map>
+void Fill(Map& map, const std::vector<COutPoint>& outpoints)
+{
+    for (const COutPoint& outpoint : outpoints) {
+        map.emplace(std::piecewise_construct, std::forward_as_tuple(outpoint),
+                    std::forward_as_tuple(Coin{CTxOut{1, CScript{} << OP_TRUE}, 1, false}, CCoinsCacheEntry::DIRTY | CCoinsCacheEntry::FRESH));
+    }
+}
+
+/** Add coins to an empty map and write them out as CCoinsViewCache::Flush() does. */
+template <typename Map>
+void CoinsMapInsertErase(benchmark::Bench& bench)
+{
+    FastRandomContext rng{/*fDeterministic=*/true};
+    const std::vector<COutPoint> outpoints{RandomOutpoints(rng, NUM_MAP_COINS)};
+    bench.batch(NUM_MAP_COINS).unit("coin").run([&] {
+        ResourceFor<Map> resource;
+        Map map{0, SaltedOutpointHasher{/*deterministic=*/true}, typename Map::key_equal{}, &resource};
+        Fill(map, outpoints);
+        for (auto it{map.begin()}; it != map.end(); it = map.erase(it)) {
+            assert(it->second.flags & CCoinsCacheEntry::DIRTY);
+        }
+        assert(map.empty());
+    });
+}
+
+/** Look up coins in a large map, half of which it does not hold, as FetchCoin() does. */
+template <typename Map>
+void CoinsMapFind(benchmark::Bench& bench)
+{
+    FastRandomContext rng{/*fDeterministic=*/true};
+    const std::vector<COutPoint> outpoints{RandomOutpoints(rng, NUM_MAP_COINS * 10)};
+    ResourceFor<Map> resource;
+    Map map{0, SaltedOutpointHasher{/*deterministic=*/true}, typename Map::key_equal{}, &resource};
+    Fill(map, outpoints);
+
+    std::vector<COutPoint> lookups{RandomOutpoints(rng, NUM_MAP_COINS / 2)};
+    for (size_t i{0}; i < NUM_MAP_COINS / 2; ++i) {
+        lookups.push_back(outpoints[rng.randrange(outpoints.size())]);
+    }
+    Shuffle(lookups.begin(), lookups.end(), rng);
+
+    bench.batch(lookups.size()).unit("lookup").run([&] {
+        size_t found{0};
+        for (const COutPoint& outpoint : lookups) {
+            found += map.find(outpoint) != map.end();
+        }
+        assert(found >= NUM_MAP_COINS / 2);
+    });
+}
+} // namespace
+
+static void CCoinsNodeMapInsertErase(benchmark::Bench& bench) { CoinsMapInsertErase<CCoinsNodeMap>(bench); }
+static void CCoinsFlatMapInsertErase(benchmark::Bench& bench) { CoinsMapInsertErase<CCoinsFlatMap>(bench); }
+static void CCoinsNodeMapFind(benchmark::Bench& bench) { CoinsMapFind<CCoinsNodeMap>(bench); }
+static void CCoinsFlatMapFind(benchmark::Bench& bench) { CoinsMapFind<CCoinsFlatMap>(bench); }
+
 BENCHMARK(CCoinsCaching, benchmark::PriorityLevel::HIGH);
+BENCHMARK(CCoinsNodeMapInsertErase, benchmark::PriorityLevel::HIGH);
+BENCHMARK(CCoinsFlatMapInsertErase, benchmark::PriorityLevel::HIGH);
+BENCHMARK(CCoinsNodeMapFind, benchmark::PriorityLevel::HIGH);
+BENCHMARK(CCoinsFlatMapFind, benchmark::PriorityLevel::HIGH);
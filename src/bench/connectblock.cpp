@@ -0,0 +1,79 @@
+// Copyright (c) 2024 The Regus Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <bench/bench.h>
+#include <consensus/amount.h>
+#include <consensus/validation.h>
+#include <primitives/transaction.h>
+#include <script/script.h>
+#include <sync.h>
+#include <test/util/script.h>
+#include <test/util/setup_common.h>
+#include <util/chaintype.h>
+#include <validation.h>
+
+#include <cassert>
+#include <vector>
+
+/**
+ * Disconnect the last blocks of a chain and connect them again, so that
+ * ConnectTip() reads them back from the local block files. This measures the
+ * connect rate including the disk reads and the CheckBlock() work that the
+ * BlockPrevalidator moves to the -par threads.
+ *
+ * With cold_coins, the coins cache is flushed and emptied before the blocks
+ * are connected again, so that every coin they spend comes from the database,
+ * as during IBD with a small -dbcache.
+ */
+static void ConnectBlocks(benchmark::Bench& bench, bool cold_coins, const std::vector<const char*>& extra_args)
+{
+    constexpr size_t NUM_OUTPUTS{500};
+    constexpr size_t NUM_BLOCKS{20};
+    const auto testing_setup{MakeNoLogFileContext<TestChain100Setup>(ChainType::REGTEST, extra_args)};
+    ChainstateManager& chainman{*testing_setup->m_node.chainman};
+    Chainstate& chainstate{chainman.ActiveChainstate()};
+
+    // Split a mature coinbase into many outputs...
+    const CTransactionRef coinbase{testing_setup->m_coinbase_txns.at(0)};
+    const CAmount output_value{(coinbase->vout[0].nValue - 1000) / static_cast<CAmount>(NUM_OUTPUTS)};
+    const std::vector<CTxOut> outputs(NUM_OUTPUTS, CTxOut{output_value, P2WSH_OP_TRUE});
+    const auto [split, fee] = testing_setup->CreateValidTransaction({coinbase}, {COutPoint{coinbase->GetHash(), 0}}, /*input_height=*/1,
+                                                                    {testing_setup->coinbaseKey}, outputs, /*feerate=*/std::nullopt, /*fee_output=*/std::nullopt);
+    const CBlock split_block{testing_setup->CreateAndProcessBlock({split}, P2WSH_OP_TRUE)};
+    CBlockIndex* const first{WITH_LOCK(::cs_main, return chainman.m_blockman.LookupBlockIndex(split_block.GetHash()))};
+
+    // ...and spend them over the following blocks.
+    CScriptWitness witness;
+    witness.stack.push_back(WITNESS_STACK_ELEM_OP_TRUE);
+    for (size_t b{0}; b < NUM_BLOCKS; ++b) {
+        std::vector<CMutableTransaction> txs;
+        for (size_t i{b * NUM_OUTPUTS / NUM_BLOCKS}; i < (b + 1) * NUM_OUTPUTS / NUM_BLOCKS; ++i) {
+            CMutableTransaction tx;
+            tx.vin.emplace_back(COutPoint{split.GetHash(), static_cast<uint32_t>(i)});
+            tx.vin.back().scriptWitness = witness;
+            tx.vout.emplace_back(output_value - 100, P2WSH_OP_TRUE);
+            txs.push_back(tx);
+        }
+        testing_setup->CreateAndProcessBlock(txs, P2WSH_OP_TRUE);
+    }
+    const CBlockIndex* const tip{WITH_LOCK(::cs_main, return chainman.ActiveTip())};
+    assert(tip->nHeight == first->nHeight + static_cast<int>(NUM_BLOCKS));
+
+    bench.batch(NUM_BLOCKS + 1).unit("block").run([&] {
+        BlockValidationState state;
+        bool ok{chainstate.InvalidateBlock(state, first)};
+        WITH_LOCK(::cs_main, chainstate.ResetBlockFailureFlags(first));
+        if (cold_coins) chainstate.ForceFlushStateToDisk();
+        ok &= chainstate.ActivateBestChain(state);
+        assert(ok && WITH_LOCK(::cs_main, return chainman.ActiveTip()) == tip);
+    });
+}
+
+static void ConnectBlocksFromDisk(benchmark::Bench& bench) { ConnectBlocks(bench, /*cold_coins=*/false, {}); }
+static void ConnectBlocksColdCoins(benchmark::Bench& bench) { ConnectBlocks(bench, /*cold_coins=*/true, {"-dbcache=4", "-utxoprefetch=0"}); }
+static void ConnectBlocksColdCoinsPrefetch(benchmark::Bench& bench) { ConnectBlocks(bench, /*cold_coins=*/true, {"-dbcache=4"}); }
+
+BENCHMARK(ConnectBlocksFromDisk, benchmark::PriorityLevel::HIGH);
+BENCHMARK(ConnectBlocksColdCoins, benchmark::PriorityLevel::HIGH);
+BENCHMARK(ConnectBlocksColdCoinsPrefetch, benchmark::PriorityLevel::HIGH);
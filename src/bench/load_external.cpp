@@ -23,15 +23,13 @@
  * This benchmark measures the performance of deserializing the block (or just
  * its header, beginning with PR 16981).
  */
-static void LoadExternalBlockFile(benchmark::Bench& bench)
+static fs::path CreateBlockFile(const TestingSetup& testing_setup)
 {
-    const auto testing_setup{MakeNoLogFileContext<const TestingSetup>(ChainType::MAIN)};
-
     // Create a single block as in the blocks files (magic bytes, block size,
     // block data) as a stream object.
-    const fs::path blkfile{testing_setup.get()->m_path_root / "blk.dat"};
+    const fs::path blkfile{testing_setup.m_path_root / "blk.dat"};
     DataStream ss{};
-    auto params{testing_setup->m_node.chainman->GetParams()};
+    auto params{testing_setup.m_node.chainman->GetParams()};
     ss << params.MessageStart();
     ss << static_cast<uint32_t>(benchmark::data::genesisBlock.size());
     // We can't use the streaming serialization (ss << benchmark::data::genesisBlock)
@@ -50,6 +48,13 @@ static void LoadExternalBlockFile(benchmark::Bench& bench)
         }
         fclose(file);
     }
+    return blkfile;
+}
+
+static void LoadExternalBlockFile(benchmark::Bench& bench)
+{
+    const auto testing_setup{MakeNoLogFileContext<const TestingSetup>(ChainType::MAIN)};
+    const fs::path blkfile{CreateBlockFile(*testing_setup)};
 
     std::multimap<uint256, FlatFilePos> blocks_with_unknown_parent;
     FlatFilePos pos;
@@ -62,4 +67,20 @@ static void LoadExternalBlockFile(benchmark::Bench& bench)
     fs::remove(blkfile);
 }
 
+/**
+ * The same file, read by LoadExternalBlockFiles(), which deserializes and
+ * checks the blocks on the worker threads of the test setup.
+ */
+static void LoadExternalBlockFiles(benchmark::Bench& bench)
+{
+    const auto testing_setup{MakeNoLogFileContext<const TestingSetup>(ChainType::MAIN)};
+    const fs::path blkfile{CreateBlockFile(*testing_setup)};
+
+    bench.run([&] {
+        testing_setup->m_node.chainman->LoadExternalBlockFiles({blkfile}, /*reindex=*/false);
+    });
+    fs::remove(blkfile);
+}
+
 BENCHMARK(LoadExternalBlockFile, benchmark::PriorityLevel::HIGH);
+BENCHMARK(LoadExternalBlockFiles, benchmark::PriorityLevel::HIGH);
@@ -0,0 +1,251 @@
+// Copyright (c) 2024 The Regus Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <bench/bench.h>
+
+#include <arith_uint256.h>
+#include <chainparams.h>
+#include <crypto/ethash/include/ethash/keccak.h>
+#include <crypto/ethash/include/ethash/keccak.hpp>
+#include <crypto/ethash/include/ethash/progpow.hpp>
+#include <crypto/ethash/lib/ethash/ethash-internal.hpp>
+#include <hash.h>
+#include <pow.h>
+#include <primitives/block.h>
+#include <tinyformat.h>
+#include <uint256.h>
+#include <util/chaintype.h>
+#include <validation.h>
+
+#include <cassert>
+#include <cstdint>
+#include <vector>
+
+static constexpr int BLOCK_NUMBER{1000};
+
+static void ProgPowHashLight(benchmark::Bench& bench)
+{
+    bench.name(strprintf("%s using the '%s' mix implementation", __func__, progpow::select_mix_implementation()));
+    const auto context = ethash::get_epoch_context(ethash::get_epoch_number(BLOCK_NUMBER));
+    assert(context);
+    uint64_t nonce{0};
+    bench.unit("hash").run([&] {
+        const auto result = progpow::hash(*context, BLOCK_NUMBER, {}, ++nonce);
+        ankerl::nanobench::doNotOptimizeAway(result);
+    });
+}
+
+// Light hashing reads the light cache at random offsets, so these show the
+// effect of the TLB. The mode in the name is the one the system granted.
+static void ProgPowHashLightMemory(benchmark::Bench& bench, bool huge_pages)
+{
+    ethash::set_huge_pages(huge_pages);
+    const auto context = ethash::create_epoch_context(ethash::get_epoch_number(BLOCK_NUMBER));
+    ethash::set_huge_pages(true);
+    assert(context);
+    bench.name(strprintf("ProgPowHashLight using %s", ethash::memory_mode_name(ethash::get_memory_info(ethash::memory_use::epoch_context).mode)));
+    uint64_t nonce{0};
+    bench.unit("hash").run([&] {
+        const auto result = progpow::hash(*context, BLOCK_NUMBER, {}, ++nonce);
+        ankerl::nanobench::doNotOptimizeAway(result);
+    });
+}
+
+static void ProgPowHashLight_PAGES(benchmark::Bench& bench) { ProgPowHashLightMemory(bench, false); }
+static void ProgPowHashLight_HUGE_PAGES(benchmark::Bench& bench) { ProgPowHashLightMemory(bench, true); }
+
+// Hashes a few recent headers over and over, as a node does when it verifies
+// a header on receipt, again with its block, and after reading it from disk.
+static void ProgPowHashLight_ITEM_CACHE(benchmark::Bench& bench)
+{
+    progpow::select_mix_implementation();
+    const auto context = ethash::get_epoch_context(ethash::get_epoch_number(BLOCK_NUMBER));
+    assert(context);
+    progpow::set_item_cache_size(64 << 20);
+    uint64_t nonce{0};
+    bench.unit("hash").run([&] {
+        const auto result = progpow::hash(*context, BLOCK_NUMBER, {}, ++nonce % 16);
+        ankerl::nanobench::doNotOptimizeAway(result);
+    });
+    progpow::set_item_cache_size(0);
+}
+
+static void ProgPowHashFull(benchmark::Bench& bench)
+{
+    bench.name(strprintf("%s using the '%s' mix implementation", __func__, progpow::select_mix_implementation()));
+    const auto context = ethash::create_epoch_context_full(ethash::get_epoch_number(BLOCK_NUMBER));
+    assert(context);
+    // The dataset is generated lazily. Hashing a fixed nonce keeps the
+    // handful of items it touches resident, so that only the mix is measured.
+    progpow::hash(*context, BLOCK_NUMBER, {}, 0);
+    bench.unit("hash").run([&] {
+        const auto result = progpow::hash(*context, BLOCK_NUMBER, {}, 0);
+        ankerl::nanobench::doNotOptimizeAway(result);
+    });
+}
+
+static void ProgPowHashNoVerify(benchmark::Bench& bench)
+{
+    ethash::hash256 header_hash{}, mix{};
+    uint64_t nonce{0};
+    bench.unit("hash").run([&] {
+        header_hash = progpow::hash_no_verify(BLOCK_NUMBER, header_hash, mix, ++nonce);
+    });
+}
+
+static void ETHashHeader(benchmark::Bench& bench)
+{
+    progpow::select_mix_implementation();
+    CBlockHeader header;
+    header.nHeight = BLOCK_NUMBER;
+    uint256 mix;
+    bench.unit("header").run([&] {
+        ++header.nNonce;
+        const uint256 hash{ETHash(header, mix)};
+        ankerl::nanobench::doNotOptimizeAway(hash);
+    });
+}
+
+// A block accepted from the network has its hashes asked for about this often:
+// logging, the proof-of-work checks, the block index lookups and insertion,
+// and the disk read with its index comparison before it is connected.
+static constexpr int HASHES_PER_BLOCK{6};
+static constexpr int HEADER_HASHES_PER_BLOCK{2};
+
+static void BlockHashes(benchmark::Bench& bench, bool cache)
+{
+    progpow::select_mix_implementation();
+    CBlock block;
+    block.nHeight = BLOCK_NUMBER;
+    bench.unit("block").run([&] {
+        ++block.nNonce;
+        CBlock received{block};
+        if (cache) received.CacheHashes();
+        for (int i = 0; i < HASHES_PER_BLOCK; ++i) {
+            ankerl::nanobench::doNotOptimizeAway(received.GetHash());
+        }
+        for (int i = 0; i < HEADER_HASHES_PER_BLOCK; ++i) {
+            ankerl::nanobench::doNotOptimizeAway(received.GetHeaderHash());
+        }
+    });
+}
+
+static void BlockHashes_UNCACHED(benchmark::Bench& bench) { BlockHashes(bench, false); }
+static void BlockHashes_CACHED(benchmark::Bench& bench) { BlockHashes(bench, true); }
+
+static void EthashCreateEpochContext(benchmark::Bench& bench)
+{
+    bench.unit("context").run([&] {
+        const auto context = ethash::create_epoch_context(0);
+        assert(context);
+    });
+}
+
+static void EthashCreateEpochContextFull(benchmark::Bench& bench)
+{
+    bench.unit("context").run([&] {
+        const auto context = ethash::create_epoch_context_full(0);
+        assert(context);
+    });
+}
+
+static void EthashDatasetItem2048(benchmark::Bench& bench)
+{
+    ethash::select_keccak_implementation();
+    const auto context = ethash::get_epoch_context(0);
+    assert(context);
+    uint32_t index{0};
+    bench.unit("item").run([&] {
+        const auto item = ethash::calculate_dataset_item_2048(*context, index++ % (context->full_dataset_num_items / 2));
+        ankerl::nanobench::doNotOptimizeAway(item);
+    });
+}
+
+static void Keccakf800(benchmark::Bench& bench)
+{
+    uint32_t state[25]{};
+    bench.unit("permutation").run([&] {
+        ethash_keccakf800(state);
+    });
+}
+
+static void Keccakf1600(benchmark::Bench& bench)
+{
+    uint64_t state[25]{};
+    bench.unit("permutation").run([&] {
+        ethash_keccakf1600(state);
+    });
+}
+
+static void Keccakf800x8(benchmark::Bench& bench, bool use_simd)
+{
+    bench.name(strprintf("Keccakf800x8 using the '%s' Keccak implementation", ethash::select_keccak_implementation(use_simd)));
+    uint32_t states[8][25]{};
+    bench.batch(8).unit("permutation").run([&] {
+        ethash::keccakf800_x8(states);
+    });
+    ethash::select_keccak_implementation();
+}
+
+static void Keccakf1600x4(benchmark::Bench& bench, bool use_simd)
+{
+    bench.name(strprintf("Keccakf1600x4 using the '%s' Keccak implementation", ethash::select_keccak_implementation(use_simd)));
+    uint64_t states[4][25]{};
+    bench.batch(4).unit("permutation").run([&] {
+        ethash::keccakf1600_x4(states);
+    });
+    ethash::select_keccak_implementation();
+}
+
+static void Keccakf800x8_GENERIC(benchmark::Bench& bench) { Keccakf800x8(bench, false); }
+static void Keccakf800x8_SIMD(benchmark::Bench& bench) { Keccakf800x8(bench, true); }
+static void Keccakf1600x4_GENERIC(benchmark::Bench& bench) { Keccakf1600x4(bench, false); }
+static void Keccakf1600x4_SIMD(benchmark::Bench& bench) { Keccakf1600x4(bench, true); }
+
+static void HasValidProofOfWork2000(benchmark::Bench& bench)
+{
+    ethash::select_keccak_implementation();
+    const auto chain_params = CreateChainParams(ChainType::REGTEST);
+    const Consensus::Params& consensus{chain_params->GetConsensus()};
+    const uint32_t bits{UintToArith256(consensus.powLimit).GetCompact()};
+
+    // A chain of headers meeting the regtest target. Only the final hash is
+    // checked, so any mix will do.
+    std::vector<CBlockHeader> headers(2000);
+    uint256 prev;
+    for (size_t i = 0; i < headers.size(); ++i) {
+        CBlockHeader& header{headers[i]};
+        header.hashPrevBlock = prev;
+        header.nHeight = i + 1;
+        header.nTime = 1712232000 + 60 * i;
+        header.nBits = bits;
+        while (!CheckProofOfWork(ETHash(header), header.nBits, consensus)) ++header.nNonce;
+        prev = header.GetHash();
+    }
+
+    bench.batch(headers.size()).unit("header").run([&] {
+        const bool valid{HasValidProofOfWork(headers, consensus)};
+        assert(valid);
+    });
+}
+
+BENCHMARK(ProgPowHashLight, benchmark::PriorityLevel::HIGH);
+BENCHMARK(ProgPowHashLight_PAGES, benchmark::PriorityLevel::HIGH);
+BENCHMARK(ProgPowHashLight_HUGE_PAGES, benchmark::PriorityLevel::HIGH);
+BENCHMARK(ProgPowHashLight_ITEM_CACHE, benchmark::PriorityLevel::HIGH);
+BENCHMARK(ProgPowHashFull, benchmark::PriorityLevel::HIGH);
+BENCHMARK(ProgPowHashNoVerify, benchmark::PriorityLevel::HIGH);
+BENCHMARK(ETHashHeader, benchmark::PriorityLevel::HIGH);
+BENCHMARK(BlockHashes_UNCACHED, benchmark::PriorityLevel::HIGH);
+BENCHMARK(BlockHashes_CACHED, benchmark::PriorityLevel::HIGH);
+BENCHMARK(EthashCreateEpochContext, benchmark::PriorityLevel::LOW);
+BENCHMARK(EthashCreateEpochContextFull, benchmark::PriorityLevel::LOW);
+BENCHMARK(EthashDatasetItem2048, benchmark::PriorityLevel::HIGH);
+BENCHMARK(Keccakf800, benchmark::PriorityLevel::HIGH);
+BENCHMARK(Keccakf1600, benchmark::PriorityLevel::HIGH);
+BENCHMARK(Keccakf800x8_GENERIC, benchmark::PriorityLevel::HIGH);
+BENCHMARK(Keccakf800x8_SIMD, benchmark::PriorityLevel::HIGH);
+BENCHMARK(Keccakf1600x4_GENERIC, benchmark::PriorityLevel::HIGH);
+BENCHMARK(Keccakf1600x4_SIMD, benchmark::PriorityLevel::HIGH);
+BENCHMARK(HasValidProofOfWork2000, benchmark::PriorityLevel::HIGH);
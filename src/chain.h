@@ -213,6 +213,10 @@ public:
     //! (memory only) Maximum nTime in the chain up to and including this block.
     unsigned int nTimeMax{0};
 
+    //! (memory only) nBits required of a child of this block, cached by
+    //! CalculateNextWorkRequired(); 0 until computed.
+    mutable uint32_t nNextWorkRequired GUARDED_BY(::cs_main){0};
+
     explicit CBlockIndex(const CBlockHeader& block)
         : nHeight(block.nHeight),
           nVersion{block.nVersion},
@@ -7,8 +7,13 @@
 #ifndef REGUS_COINS_H
 #define REGUS_COINS_H
 
+#if defined(HAVE_CONFIG_H)
+#include <config/regus-config.h>
+#endif
+
 #include <compressor.h>
 #include <core_memusage.h>
+#include <flathashmap.h>
 #include <memusage.h>
 #include <primitives/transaction.h>
 #include <serialize.h>
@@ -141,14 +146,27 @@ struct CCoinsCacheEntry
  * Using an additional sizeof(void*)*4 for MAX_BLOCK_SIZE_BYTES should thus be sufficient so that
  * all implementations can allocate the nodes from the PoolAllocator.
  */
-using CCoinsMap = std::unordered_map<COutPoint,
-                                     CCoinsCacheEntry,
-                                     SaltedOutpointHasher,
-                                     std::equal_to<COutPoint>,
-                                     PoolAllocator<std::pair<const COutPoint, CCoinsCacheEntry>,
-                                                   sizeof(std::pair<const COutPoint, CCoinsCacheEntry>) + sizeof(void*) * 4>>;
+using CCoinsNodeMap = std::unordered_map<COutPoint,
+                                         CCoinsCacheEntry,
+                                         SaltedOutpointHasher,
+                                         std::equal_to<COutPoint>,
+                                         PoolAllocator<std::pair<const COutPoint, CCoinsCacheEntry>,
+                                                       sizeof(std::pair<const COutPoint, CCoinsCacheEntry>) + sizeof(void*) * 4>>;
 
+/**
+ * Keeps the entries in one array, without the per-node overhead of
+ * CCoinsNodeMap, and finds most of them with a single cache miss.
+ */
+using CCoinsFlatMap = FlatHashMap<COutPoint, CCoinsCacheEntry, SaltedOutpointHasher>;
+
+#ifdef USE_FLAT_COINS_MAP
+using CCoinsMap = CCoinsFlatMap;
+/** CCoinsFlatMap does not take a memory resource. */
+struct CCoinsMapMemoryResource {};
+#else
+using CCoinsMap = CCoinsNodeMap;
 using CCoinsMapMemoryResource = CCoinsMap::allocator_type::ResourceType;
+#endif
 
 /** Cursor for iterating over CoinsView state */
 class CCoinsViewCursor
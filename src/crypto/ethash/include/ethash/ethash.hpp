@@ -149,6 +149,88 @@ search_result search(const epoch_context_full& context, const hash256& header_ha
 int find_epoch_number(const hash256& seed) noexcept;
 
 
+/// Reference counted epoch context shared between threads.
+using epoch_context_shared_ptr = std::shared_ptr<const epoch_context>;
+
+/// Get the light epoch context from the process-wide cache of recently used
+/// contexts, building it if needed.
+///
+/// Thread-safe. Concurrent callers asking for the same epoch share one build,
+/// and callers working in other resident epochs are never blocked by it.
+///
+/// @return  The shared context or null in case of memory allocation failure.
+epoch_context_shared_ptr get_epoch_context(int epoch_number) noexcept;
+
+/// Start building the light epoch context on a background thread, unless it is
+/// already resident or being built. Returns immediately.
+///
+/// Builds for different epochs run concurrently, up to as many as the contexts
+/// kept resident; beyond that nothing is started. A resident context is marked
+/// as recently used instead.
+void prebuild_epoch_context(int epoch_number) noexcept;
+
+/// Number of light epoch contexts kept resident by default. Header sync and
+/// block validation may run in different epochs, and each of them may have
+/// the following epoch prebuilt, so keep room for two pairs.
+constexpr size_t default_max_resident_epoch_contexts = 4;
+
+/// Change the number of light epoch contexts kept resident. The least recently
+/// used ones beyond it are released; contexts still being built are kept
+/// until they are done, and released by the next get_epoch_context().
+void set_max_resident_epoch_contexts(size_t max_contexts) noexcept;
+
+/// How often get_epoch_context() found an epoch context ready on its first
+/// use, because it had been prebuilt, versus had to build it or wait for it.
+struct epoch_context_stats
+{
+    uint64_t hits = 0;
+    uint64_t misses = 0;
+};
+
+epoch_context_stats get_epoch_context_stats() noexcept;
+
+/// Function used by get_epoch_context() to obtain contexts missing from the
+/// cache, e.g. by loading a previously persisted light cache.
+using epoch_context_builder = epoch_context_shared_ptr (*)(int epoch_number);
+
+/// Install the builder used for new shared contexts, or restore the default
+/// (create_epoch_context()) by passing null. Already resident contexts are kept.
+void set_epoch_context_builder(epoch_context_builder builder) noexcept;
+
+/// How the memory of light caches and datasets is backed.
+enum class memory_mode
+{
+    none,  ///< Nothing was allocated yet.
+    heap,  ///< calloc(), if the platform has no anonymous mappings or mapping failed.
+    pages,  ///< Anonymous mapping with regular pages.
+    transparent_huge_pages,  ///< Anonymous mapping the kernel was asked to back with huge pages.
+    huge_pages,  ///< Mapping of huge pages reserved by the administrator (MAP_HUGETLB).
+};
+
+/// What a large allocation is used for.
+enum class memory_use
+{
+    epoch_context,  ///< Light cache and L1 cache, plus the full dataset of full contexts.
+    dataset,  ///< Items of a progpow::epoch_dataset.
+};
+
+struct memory_info
+{
+    memory_mode mode = memory_mode::none;
+    /// The NUMA node the memory is bound to, or -1.
+    int numa_node = -1;
+};
+
+const char* memory_mode_name(memory_mode mode) noexcept;
+
+/// Allow huge pages for light caches and datasets allocated from now on
+/// (default), or use regular pages only. Either way the memory prefers the
+/// NUMA node of the thread that builds it.
+void set_huge_pages(bool enabled) noexcept;
+
+/// How the most recent allocation for the given use is backed.
+memory_info get_memory_info(memory_use use) noexcept;
+
 /// Get global shared epoch context.
 inline const epoch_context& get_global_epoch_context(int epoch_number) noexcept
 {
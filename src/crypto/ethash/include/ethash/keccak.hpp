@@ -33,4 +33,20 @@ inline hash512 keccak512(const hash512& input) noexcept
 static constexpr auto keccak256_32 = ethash_keccak256_32;
 static constexpr auto keccak512_64 = ethash_keccak512_64;
 
+/// Selects the fastest batched Keccak backend supported by the CPU, or the
+/// portable one if use_simd is false. Until this is called the portable one is
+/// used.
+///
+/// @return  The name of the selected backend.
+const char* select_keccak_implementation(bool use_simd = true) noexcept;
+
+/// Applies Keccak-f[1600] to four independent states.
+void keccakf1600_x4(uint64_t states[4][25]) noexcept;
+
+/// Applies Keccak-f[800] to eight independent states.
+void keccakf800_x8(uint32_t states[8][25]) noexcept;
+
+/// Computes keccak512() of four 512-bit inputs. `out` may alias `in`.
+void keccak512_x4(hash512 out[4], const hash512 in[4]) noexcept;
+
 }  // namespace ethash
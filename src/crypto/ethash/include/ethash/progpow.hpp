@@ -3,8 +3,13 @@
 // Distributed under the MIT software license, see the accompanying
 // file COPYING or http://www.opensource.org/licenses/mit-license.php.
 
+#pragma once
+
 #include <crypto/ethash/include/ethash/ethash.hpp>
 
+#include <atomic>
+#include <memory>
+
 namespace progpow
 {
 using namespace ethash;  // Include ethash namespace.
@@ -21,9 +26,88 @@ constexpr int num_math_operations = 18;
 constexpr size_t l1_cache_size = 16 * 1024;
 constexpr size_t l1_cache_num_items = l1_cache_size / sizeof(uint32_t);
 
+/// Lazily generated ProgPoW dataset of one epoch, for verification by table lookup.
+///
+/// Memory is reserved for the first `num_items` 2048-bit items (all of them if
+/// the budget allows); the remaining items are computed from the light cache on
+/// every use. Safe to share between threads: an item is written by a single
+/// thread and then published with a release store of its state, while other
+/// threads that need it meanwhile compute it themselves.
+struct epoch_dataset : epoch_context
+{
+    epoch_dataset(epoch_context_shared_ptr light, uint32_t cached_items, hash2048* item_data,
+        std::atomic<uint8_t>* states) noexcept;
+    ~epoch_dataset();
+
+    epoch_dataset(const epoch_dataset&) = delete;
+    epoch_dataset& operator=(const epoch_dataset&) = delete;
+
+    /// The light context the items are derived from.
+    const epoch_context_shared_ptr light_context;
+
+    /// Number of leading items backed by memory.
+    const uint32_t num_items;
+
+    hash2048* const items;
+    std::atomic<uint8_t>* const item_states;
+
+    /// Number of items generated so far.
+    mutable std::atomic<uint32_t> num_filled{0};
+};
+
+using epoch_dataset_ptr = std::shared_ptr<const epoch_dataset>;
+
+/// Creates an empty dataset for the context's epoch using at most max_bytes.
+///
+/// @return  The dataset or null if the budget is too small or memory allocation failed.
+epoch_dataset_ptr create_epoch_dataset(epoch_context_shared_ptr context, uint64_t max_bytes) noexcept;
+
+/// Returns the 2048-bit dataset item, generating and storing it if needed.
+hash2048 lookup_dataset_item(const epoch_dataset& dataset, uint32_t index) noexcept;
+
+/// Generates the missing items in [begin, end).
+void fill_epoch_dataset(const epoch_dataset& dataset, uint32_t begin, uint32_t end) noexcept;
+
+/// Configures the dataset the node keeps for its current epoch: at most
+/// max_bytes (0 disables it), optionally generated ahead of use on a background
+/// thread. Drops the current dataset; select_dataset_epoch() creates a new one.
+void set_dataset_options(uint64_t max_bytes, bool prefill) noexcept;
+
+/// Makes the given epoch the current one, replacing the dataset of any other epoch.
+void select_dataset_epoch(int epoch_number) noexcept;
+
+/// Returns the dataset for the epoch if it is the current one, null otherwise.
+epoch_dataset_ptr get_epoch_dataset(int epoch_number) noexcept;
+
+/// Cache of dataset items computed by light hashing and verification, for
+/// nodes that cannot afford a dataset. Shared by all epochs.
+struct item_cache_stats
+{
+    /// Bytes of items the cache holds at most, 0 if it is disabled.
+    uint64_t size = 0;
+    uint64_t hits = 0;
+    uint64_t misses = 0;
+};
+
+/// Replaces the item cache with an empty one of at most max_bytes, or disables
+/// it if max_bytes is 0 (the default) or the memory cannot be allocated.
+void set_item_cache_size(uint64_t max_bytes) noexcept;
+
+item_cache_stats get_item_cache_stats() noexcept;
+
+/// Selects the fastest implementation of the mix supported by the CPU (AVX-512,
+/// AVX2), or the portable one if use_simd is false. All implementations give
+/// identical results. Until this is called the portable one is used.
+///
+/// @return  The name of the selected implementation.
+const char* select_mix_implementation(bool use_simd = true) noexcept;
+
 result hash(const epoch_context& context, int block_number, const hash256& header_hash,
     uint64_t nonce) noexcept;
 
+result hash(const epoch_dataset& dataset, int block_number, const hash256& header_hash,
+    uint64_t nonce) noexcept;
+
 result hash(const epoch_context_full& context, int block_number, const hash256& header_hash,
     uint64_t nonce) noexcept;
 
@@ -33,6 +117,11 @@ bool verify(const epoch_context& context, int block_number, const hash256& heade
 hash256 hash_no_verify(const int& block_number, const hash256& header_hash,
     const hash256& hashMix, const uint64_t& nonce) noexcept;
 
+/// Computes hash_no_verify() for `count` headers, batching the Keccak
+/// permutations (see ethash::select_keccak_implementation()).
+void hash_no_verify_batch(size_t count, const hash256 header_hashes[], const hash256 mixes[],
+    const uint64_t nonces[], hash256 out[]) noexcept;
+
 search_result search_light(const epoch_context& context, int block_number,
     const hash256& header_hash, const hash256& boundary, uint64_t start_nonce,
     size_t iterations) noexcept;
@@ -41,4 +130,8 @@ search_result search(const epoch_context_full& context, int block_number,
     const hash256& header_hash, const hash256& boundary, uint64_t start_nonce,
     size_t iterations) noexcept;
 
+search_result search(const epoch_dataset& dataset, int block_number,
+    const hash256& header_hash, const hash256& boundary, uint64_t start_nonce,
+    size_t iterations) noexcept;
+
 }  // namespace progpow
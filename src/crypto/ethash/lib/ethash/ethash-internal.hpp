@@ -44,6 +44,13 @@ inline bool is_equal(const hash256& a, const hash256& b) noexcept
 
 void build_light_cache(hash512 cache[], int num_items, const hash256& seed) noexcept;
 
+/// Allocates zeroed memory for a buffer that is read at random offsets, backed
+/// by huge pages if possible and bound to the NUMA node of the calling thread.
+/// Returns null if out of memory. Must be released with free_large().
+void* allocate_large(size_t size, memory_use use) noexcept;
+
+void free_large(void* ptr) noexcept;
+
 hash512 calculate_dataset_item_512(const epoch_context& context, int64_t index) noexcept;
 hash1024 calculate_dataset_item_1024(const epoch_context& context, uint32_t index) noexcept;
 hash2048 calculate_dataset_item_2048(const epoch_context& context, uint32_t index) noexcept;
@@ -144,7 +144,7 @@ epoch_context_full* create_epoch_context(
 
     const size_t alloc_size = context_alloc_size + light_cache_size + full_dataset_size;
 
-    char* const alloc_data = static_cast<char*>(std::calloc(1, alloc_size));
+    char* const alloc_data = static_cast<char*>(allocate_large(alloc_size, memory_use::epoch_context));
     if (!alloc_data)
         return nullptr;  // Signal out-of-memory by returning null pointer.
 
@@ -187,13 +187,22 @@ struct item_state
     hash512 mix;
 
     ALWAYS_INLINE item_state(const epoch_context& context, int64_t index) noexcept
+      : item_state{context, index, keccak512(initial_mix(context, index))}
+    {}
+
+    /// Creates the state from keccak512(initial_mix(context, index)), computed by the caller.
+    ALWAYS_INLINE item_state(const epoch_context& context, int64_t index, const hash512& initial_hash) noexcept
       : cache{context.light_cache},
         num_cache_items{context.light_cache_num_items},
-        seed{static_cast<uint32_t>(index)}
+        seed{static_cast<uint32_t>(index)},
+        mix{le::uint32s(initial_hash)}
+    {}
+
+    static ALWAYS_INLINE hash512 initial_mix(const epoch_context& context, int64_t index) noexcept
     {
-        mix = cache[index % num_cache_items];
-        mix.word32s[0] ^= le::uint32(seed);
-        mix = le::uint32s(keccak512(mix));
+        hash512 init = context.light_cache[index % context.light_cache_num_items];
+        init.word32s[0] ^= le::uint32(static_cast<uint32_t>(index));
+        return init;
     }
 
     ALWAYS_INLINE void update(uint32_t round) noexcept
@@ -205,6 +214,9 @@ struct item_state
     }
 
     ALWAYS_INLINE hash512 final() noexcept { return keccak512(le::uint32s(mix)); }
+
+    /// The input of keccak512() in final().
+    ALWAYS_INLINE hash512 final_input() const noexcept { return le::uint32s(mix); }
 };
 
 hash512 calculate_dataset_item_512(const epoch_context& context, int64_t index) noexcept
@@ -235,10 +247,18 @@ hash1024 calculate_dataset_item_1024(const epoch_context& context, uint32_t inde
 
 hash2048 calculate_dataset_item_2048(const epoch_context& context, uint32_t index) noexcept
 {
-    item_state item0{context, int64_t(index) * 4};
-    item_state item1{context, int64_t(index) * 4 + 1};
-    item_state item2{context, int64_t(index) * 4 + 2};
-    item_state item3{context, int64_t(index) * 4 + 3};
+    // The four items are processed in lockstep, so their initial and final
+    // Keccak-512 hashes are computed as one batch.
+    const int64_t first = int64_t(index) * 4;
+    hash512 hashes[4];
+    for (int i = 0; i < 4; ++i)
+        hashes[i] = item_state::initial_mix(context, first + i);
+    keccak512_x4(hashes, hashes);
+
+    item_state item0{context, first, hashes[0]};
+    item_state item1{context, first + 1, hashes[1]};
+    item_state item2{context, first + 2, hashes[2]};
+    item_state item3{context, first + 3, hashes[3]};
 
     for (uint32_t j = 0; j < full_dataset_item_parents; ++j)
     {
@@ -248,7 +268,9 @@ hash2048 calculate_dataset_item_2048(const epoch_context& context, uint32_t inde
         item3.update(j);
     }
 
-    return hash2048{{item0.final(), item1.final(), item2.final(), item3.final()}};
+    hash2048 item{{item0.final_input(), item1.final_input(), item2.final_input(), item3.final_input()}};
+    keccak512_x4(item.hash512s, item.hash512s);
+    return item;
 }
 
 namespace
@@ -411,7 +433,7 @@ void ethash_destroy_epoch_context_full(epoch_context_full* context) noexcept
 void ethash_destroy_epoch_context(epoch_context* context) noexcept
 {
     context->~epoch_context();
-    std::free(context);
+    free_large(context);
 }
 
 ethash_result ethash_hash(
@@ -0,0 +1,124 @@
+// Copyright (c) 2024 The Regus Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+// Cache of 2048-bit dataset items for light hashing. Each item takes 512
+// Keccak and FNV rounds over the light cache to compute, and the same header
+// is usually hashed several times (on receipt, when its block is checked and
+// when it is read back from disk), so keeping recently computed items saves
+// most of that work without the memory of a full dataset.
+
+#include <crypto/ethash/lib/ethash/ethash-internal.hpp>
+#include <crypto/ethash/lib/ethash/progpow-internal.hpp>
+#include <sync.h>
+
+#include <array>
+#include <new>
+#include <vector>
+
+namespace progpow
+{
+namespace
+{
+/// Number of locks protecting the slots, so that lookups of different items
+/// rarely contend. Slot i is protected by stripe i % num_item_cache_stripes.
+constexpr size_t num_item_cache_stripes = 64;
+}  // namespace
+
+/// Direct-mapped: item i of any epoch is kept in slot i % slots.size(),
+/// replacing whatever was there.
+class item_cache
+{
+public:
+    struct slot
+    {
+        int epoch_number = -1;
+        uint32_t index = 0;
+        hash2048 item{};
+    };
+
+    struct alignas(64) stripe
+    {
+        Mutex mutex;
+        uint64_t hits GUARDED_BY(mutex){0};
+        uint64_t misses GUARDED_BY(mutex){0};
+    };
+
+    explicit item_cache(size_t num_slots) : slots(num_slots) {}
+
+    /// Guarded by the stripe of each slot.
+    std::vector<slot> slots;
+    std::array<stripe, num_item_cache_stripes> stripes;
+};
+
+namespace
+{
+Mutex g_item_cache_mutex;
+std::shared_ptr<item_cache> g_item_cache GUARDED_BY(g_item_cache_mutex);
+}  // namespace
+
+std::shared_ptr<item_cache> get_item_cache() noexcept
+{
+    LOCK(g_item_cache_mutex);
+    return g_item_cache;
+}
+
+hash2048 lookup_cached_item(item_cache& cache, const epoch_context& context, uint32_t index) noexcept
+{
+    const size_t slot_index = index % cache.slots.size();
+    item_cache::slot& slot = cache.slots[slot_index];
+    item_cache::stripe& stripe = cache.stripes[slot_index % num_item_cache_stripes];
+    {
+        LOCK(stripe.mutex);
+        if (slot.epoch_number == context.epoch_number && slot.index == index)
+        {
+            ++stripe.hits;
+            return slot.item;
+        }
+        ++stripe.misses;
+    }
+
+    // Compute without holding the lock; a concurrent miss stores the same item.
+    const hash2048 item = calculate_dataset_item_2048(context, index);
+    LOCK(stripe.mutex);
+    slot = {context.epoch_number, index, item};
+    return item;
+}
+
+void set_item_cache_size(uint64_t max_bytes) noexcept
+{
+    std::shared_ptr<item_cache> cache;
+    const uint64_t num_slots = max_bytes / sizeof(item_cache::slot);
+    if (num_slots > 0)
+    {
+        try
+        {
+            cache = std::make_shared<item_cache>(num_slots);
+        }
+        catch (const std::bad_alloc&)
+        {
+            // Leave the cache disabled.
+        }
+    }
+
+    // Hashes in progress keep using the previous cache until they finish.
+    LOCK(g_item_cache_mutex);
+    g_item_cache.swap(cache);
+}
+
+item_cache_stats get_item_cache_stats() noexcept
+{
+    const std::shared_ptr<item_cache> cache = get_item_cache();
+    item_cache_stats stats;
+    if (!cache)
+        return stats;
+    stats.size = cache->slots.size() * sizeof(item_cache::slot);
+    for (item_cache::stripe& stripe : cache->stripes)
+    {
+        LOCK(stripe.mutex);
+        stats.hits += stripe.hits;
+        stats.misses += stripe.misses;
+    }
+    return stats;
+}
+}  // namespace progpow
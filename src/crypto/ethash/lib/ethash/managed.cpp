@@ -4,9 +4,16 @@
 // file COPYING or http://www.opensource.org/licenses/mit-license.php.
 
 #include <crypto/ethash/lib/ethash/ethash-internal.hpp>
+#include <crypto/ethash/include/ethash/progpow.hpp>
 #include <sync.h>
 
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <future>
+#include <list>
 #include <memory>
+#include <system_error>
 
 #if !defined(__has_cpp_attribute)
 #define __has_cpp_attribute(x) 0
@@ -24,40 +31,125 @@ using namespace ethash;
 
 namespace
 {
+using shared_context_future = std::shared_future<epoch_context_shared_ptr>;
 
-RecursiveMutex shared_context_cs;
-std::shared_ptr<epoch_context> shared_context;
-thread_local std::shared_ptr<epoch_context> thread_local_context;
+struct context_entry
+{
+    int epoch_number;
+    uint64_t id;
+    shared_context_future context;
+    /// Whether get_epoch_context() handed it out yet.
+    bool used = false;
+};
+
+Mutex g_contexts_mutex;
+/// Recently used light contexts, most recently used first. An entry may still
+/// be under construction; its future becomes ready once the build finishes.
+std::list<context_entry> g_contexts GUARDED_BY(g_contexts_mutex);
+uint64_t g_next_context_id GUARDED_BY(g_contexts_mutex){0};
+size_t g_max_resident_contexts GUARDED_BY(g_contexts_mutex){default_max_resident_epoch_contexts};
+epoch_context_stats g_context_stats GUARDED_BY(g_contexts_mutex);
+
+std::atomic<epoch_context_builder> g_context_builder{nullptr};
+
+epoch_context_shared_ptr build_shared_context(int epoch_number) noexcept
+{
+    if (const auto builder = g_context_builder.load())
+        return builder(epoch_number);
+    return epoch_context_shared_ptr{create_epoch_context(epoch_number)};
+}
+
+/// Find the entry for the given epoch and mark it as most recently used.
+std::list<context_entry>::iterator find_context(int epoch_number)
+    EXCLUSIVE_LOCKS_REQUIRED(g_contexts_mutex)
+{
+    for (auto it = g_contexts.begin(); it != g_contexts.end(); ++it)
+    {
+        if (it->epoch_number == epoch_number)
+        {
+            g_contexts.splice(g_contexts.begin(), g_contexts, it);
+            return g_contexts.begin();
+        }
+    }
+    return g_contexts.end();
+}
+
+bool is_ready(const shared_context_future& context)
+{
+    return context.wait_for(std::chrono::seconds{0}) == std::future_status::ready;
+}
+
+/// Move the least recently used entries that no longer fit into `evicted`.
+/// Pending builds are skipped, as the last reference to one waits for the
+/// build to finish; the caller releases `evicted` after dropping the lock.
+void evict_contexts(std::list<context_entry>& evicted) EXCLUSIVE_LOCKS_REQUIRED(g_contexts_mutex)
+{
+    size_t excess = g_contexts.size() > g_max_resident_contexts ? g_contexts.size() - g_max_resident_contexts : 0;
+    for (auto it = g_contexts.end(); excess > 0 && it != g_contexts.begin();)
+    {
+        const auto entry = std::prev(it);
+        if (is_ready(entry->context))
+        {
+            evicted.splice(evicted.end(), g_contexts, entry);
+            --excess;
+        }
+        else
+        {
+            it = entry;
+        }
+    }
+}
+
+/// Number of entries whose build has not finished yet.
+size_t count_pending_contexts() EXCLUSIVE_LOCKS_REQUIRED(g_contexts_mutex)
+{
+    return static_cast<size_t>(std::count_if(g_contexts.begin(), g_contexts.end(),
+        [](const context_entry& e) { return !is_ready(e.context); }));
+}
+
+/// Insert a new entry, moving entries that no longer fit into `evicted`.
+uint64_t insert_context(int epoch_number, shared_context_future context,
+    std::list<context_entry>& evicted) EXCLUSIVE_LOCKS_REQUIRED(g_contexts_mutex)
+{
+    const uint64_t id = g_next_context_id++;
+    g_contexts.push_front({epoch_number, id, std::move(context)});
+    evict_contexts(evicted);
+    return id;
+}
+
+/// Number of items generated between checks for a stop request.
+constexpr uint32_t dataset_fill_chunk = 1024;
+
+Mutex g_dataset_mutex;
+uint64_t g_dataset_max_bytes GUARDED_BY(g_dataset_mutex){0};
+bool g_dataset_prefill GUARDED_BY(g_dataset_mutex){false};
+progpow::epoch_dataset_ptr g_dataset GUARDED_BY(g_dataset_mutex);
+std::shared_ptr<std::atomic<bool>> g_dataset_fill_stop GUARDED_BY(g_dataset_mutex);
+std::future<void> g_dataset_fill GUARDED_BY(g_dataset_mutex);
+
+/// Drop the current dataset. The background fill is asked to stop; the caller
+/// waits for it by releasing the returned future outside the lock.
+std::future<void> reset_dataset() EXCLUSIVE_LOCKS_REQUIRED(g_dataset_mutex)
+{
+    if (g_dataset_fill_stop)
+        *g_dataset_fill_stop = true;
+    g_dataset_fill_stop.reset();
+    g_dataset.reset();
+    return std::move(g_dataset_fill);
+}
 
 RecursiveMutex shared_context_full_cs;
 std::shared_ptr<epoch_context_full> shared_context_full;
+thread_local epoch_context_shared_ptr thread_local_context;
 thread_local std::shared_ptr<epoch_context_full> thread_local_context_full;
 
-/// Update thread local epoch context.
-///
-/// This function is on the slow path. It's separated to allow inlining the fast
-/// path.
-///
-/// @todo: Redesign to guarantee deallocation before new allocation.
 ATTRIBUTE_NOINLINE
 void update_local_context(int epoch_number)
 {
     // Release the shared pointer of the obsoleted context.
     thread_local_context.reset();
 
-    // Local context invalid, check the shared context.
-    LOCK(shared_context_cs);
-
-    if (!shared_context || shared_context->epoch_number != epoch_number)
-    {
-        // Release the shared pointer of the obsoleted context.
-        shared_context.reset();
-
-        // Build new context.
-        shared_context = create_epoch_context(epoch_number);
-    }
-
-    thread_local_context = shared_context;
+    thread_local_context = get_epoch_context(epoch_number);
 }
 
 ATTRIBUTE_NOINLINE
@@ -82,6 +174,172 @@ void update_local_context_full(int epoch_number)
 }
 }  // namespace
 
+namespace ethash
+{
+epoch_context_shared_ptr get_epoch_context(int epoch_number) noexcept
+{
+    std::list<context_entry> evicted;
+    std::promise<epoch_context_shared_ptr> promise;
+    shared_context_future context;
+    uint64_t id{0};
+    bool build = false;
+    {
+        LOCK(g_contexts_mutex);
+        const auto it = find_context(epoch_number);
+        if (it != g_contexts.end())
+        {
+            context = it->context;
+            id = it->id;
+            // Count only the first use of each context: whether it was built
+            // ahead of time, or its user had to wait for it.
+            if (!it->used)
+            {
+                ++(is_ready(context) ? g_context_stats.hits : g_context_stats.misses);
+                it->used = true;
+            }
+        }
+        else
+        {
+            // Publish the pending entry before building, so that concurrent
+            // callers wait for this build instead of starting their own.
+            context = promise.get_future().share();
+            id = insert_context(epoch_number, context, evicted);
+            g_contexts.front().used = true;
+            ++g_context_stats.misses;
+            build = true;
+        }
+    }
+    evicted.clear();
+
+    if (build)
+        promise.set_value(build_shared_context(epoch_number));
+
+    epoch_context_shared_ptr result = context.get();
+    {
+        LOCK(g_contexts_mutex);
+        // Out of memory. Forget the failed entry so that a later call retries.
+        if (!result)
+            g_contexts.remove_if([id](const context_entry& e) { return e.id == id; });
+        // Entries skipped by eviction while their build was pending can go now.
+        evict_contexts(evicted);
+    }
+    evicted.clear();
+    return result;
+}
+
+void set_epoch_context_builder(epoch_context_builder builder) noexcept
+{
+    g_context_builder = builder;
+}
+
+void set_max_resident_epoch_contexts(size_t max_contexts) noexcept
+{
+    std::list<context_entry> evicted;
+    LOCK(g_contexts_mutex);
+    g_max_resident_contexts = std::max<size_t>(max_contexts, 1);
+    evict_contexts(evicted);
+}
+
+epoch_context_stats get_epoch_context_stats() noexcept
+{
+    LOCK(g_contexts_mutex);
+    return g_context_stats;
+}
+
+void prebuild_epoch_context(int epoch_number) noexcept
+{
+    if (epoch_number < 0)
+        return;
+
+    // Declared before the lock so that evicted entries are released after it.
+    std::list<context_entry> evicted;
+    LOCK(g_contexts_mutex);
+    if (find_context(epoch_number) != g_contexts.end())
+        return;
+    // Pending builds cannot be evicted, so bound them. A skipped context is
+    // built on first use, or by a later call once a build has finished.
+    if (count_pending_contexts() >= g_max_resident_contexts)
+        return;
+
+    try
+    {
+        insert_context(epoch_number,
+            std::async(std::launch::async, build_shared_context, epoch_number).share(), evicted);
+    }
+    catch (const std::system_error&)
+    {
+        // No thread available; the context will be built on first use instead.
+    }
+}
+}  // namespace ethash
+
+namespace progpow
+{
+void set_dataset_options(uint64_t max_bytes, bool prefill) noexcept
+{
+    std::future<void> fill;
+    {
+        LOCK(g_dataset_mutex);
+        fill = reset_dataset();
+        g_dataset_max_bytes = max_bytes;
+        g_dataset_prefill = prefill;
+    }
+    // Destroying `fill` waits for the previous background fill to stop.
+}
+
+void select_dataset_epoch(int epoch_number) noexcept
+{
+    uint64_t max_bytes;
+    {
+        std::future<void> fill;
+        LOCK(g_dataset_mutex);
+        if (g_dataset_max_bytes == 0 || epoch_number < 0)
+            return;
+        if (g_dataset && g_dataset->epoch_number == epoch_number)
+            return;
+        fill = reset_dataset();
+        max_bytes = g_dataset_max_bytes;
+        // Declared before the lock, `fill` waits for the old fill after unlocking.
+    }
+
+    // The light context is normally resident already, as the chain is in this
+    // epoch. Either way, the dataset is set up without holding the lock.
+    const epoch_dataset_ptr dataset =
+        create_epoch_dataset(get_epoch_context(epoch_number), max_bytes);
+    if (!dataset)
+        return;
+
+    LOCK(g_dataset_mutex);
+    if (g_dataset_max_bytes != max_bytes || g_dataset)
+        return;  // Raced with another selection or a reconfiguration.
+    g_dataset = dataset;
+    if (!g_dataset_prefill)
+        return;
+
+    auto stop = std::make_shared<std::atomic<bool>>(false);
+    try
+    {
+        g_dataset_fill = std::async(std::launch::async, [dataset, stop] {
+            for (uint32_t i = 0; i < dataset->num_items && !*stop; i += dataset_fill_chunk)
+                fill_epoch_dataset(*dataset, i, std::min(dataset->num_items, i + dataset_fill_chunk));
+        });
+        g_dataset_fill_stop = std::move(stop);
+    }
+    catch (const std::system_error&)
+    {
+        // No thread available; items are generated on first use instead.
+    }
+}
+
+epoch_dataset_ptr get_epoch_dataset(int epoch_number) noexcept
+{
+    LOCK(g_dataset_mutex);
+    if (g_dataset && g_dataset->epoch_number == epoch_number)
+        return g_dataset;
+    return nullptr;
+}
+}  // namespace progpow
+
 const ethash_epoch_context* ethash_get_global_epoch_context(int epoch_number) noexcept
 {
     // Check if local context matches epoch number.
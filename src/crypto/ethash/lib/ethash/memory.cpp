@@ -0,0 +1,156 @@
+// Copyright (c) 2024 The Regus Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+// Memory for light caches and datasets. ProgPoW reads these buffers at random
+// offsets, so with 4 KiB pages nearly every access misses the TLB. Backing them
+// with 2 MiB pages and keeping them on the NUMA node of the thread that builds
+// them makes those accesses cheaper.
+
+#include <crypto/ethash/lib/ethash/ethash-internal.hpp>
+
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+#if defined(__linux__)
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace ethash
+{
+namespace
+{
+constexpr size_t huge_page_size = size_t{2} << 20;
+
+/// Stored in front of every allocation, padded so that the data of a mapping
+/// starts on a cache line.
+struct allocation_header
+{
+    /// Size of the mapping, or 0 if the memory comes from calloc().
+    size_t mapped_size;
+    unsigned char padding[64 - sizeof(size_t)];
+};
+
+std::atomic<bool> huge_pages_enabled{true};
+std::atomic<memory_info> context_memory_info{};
+std::atomic<memory_info> dataset_memory_info{};
+
+#if defined(__linux__)
+/// Prefer the NUMA node of the calling thread for the pages of the mapping,
+/// even if the thread migrates while it fills them. Returns the node or -1.
+int bind_to_local_node(void* addr, size_t size) noexcept
+{
+#if defined(SYS_getcpu) && defined(SYS_mbind)
+    unsigned cpu = 0;
+    unsigned node = 0;
+    if (syscall(SYS_getcpu, &cpu, &node, nullptr) != 0 || node >= 63)
+        return -1;
+    constexpr int mpol_preferred = 1;
+    const unsigned long nodemask = 1UL << node;
+    if (syscall(SYS_mbind, addr, size, mpol_preferred, &nodemask, sizeof(nodemask) * 8, 0) != 0)
+        return -1;
+    return static_cast<int>(node);
+#else
+    (void)addr;
+    (void)size;
+    return -1;
+#endif
+}
+#endif
+}  // namespace
+
+const char* memory_mode_name(memory_mode mode) noexcept
+{
+    switch (mode)
+    {
+    case memory_mode::none:
+        return "none";
+    case memory_mode::heap:
+        return "heap";
+    case memory_mode::pages:
+        return "pages";
+    case memory_mode::transparent_huge_pages:
+        return "transparent_huge_pages";
+    case memory_mode::huge_pages:
+        return "huge_pages";
+    }
+    return "unknown";
+}
+
+void set_huge_pages(bool enabled) noexcept
+{
+    huge_pages_enabled.store(enabled, std::memory_order_relaxed);
+}
+
+memory_info get_memory_info(memory_use use) noexcept
+{
+    return (use == memory_use::epoch_context ? context_memory_info : dataset_memory_info).load();
+}
+
+void* allocate_large(size_t size, memory_use use) noexcept
+{
+    const size_t total = sizeof(allocation_header) + size;
+    memory_info info{memory_mode::heap, -1};
+    allocation_header* header = nullptr;
+
+#if defined(__linux__)
+    // Round up to whole huge pages, so that the tail can be backed by one too.
+    const size_t mapped_size = (total + huge_page_size - 1) / huge_page_size * huge_page_size;
+    const bool huge_pages = huge_pages_enabled.load(std::memory_order_relaxed);
+    void* base = MAP_FAILED;
+#if defined(MAP_HUGETLB)
+    // Only succeeds if the administrator reserved enough huge pages.
+    if (huge_pages)
+    {
+        base = mmap(nullptr, mapped_size, PROT_READ | PROT_WRITE,
+            MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+        info.mode = memory_mode::huge_pages;
+    }
+#endif
+    if (base == MAP_FAILED)
+    {
+        base = mmap(nullptr, mapped_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        info.mode = memory_mode::pages;
+#if defined(MADV_HUGEPAGE)
+        if (base != MAP_FAILED && huge_pages && madvise(base, mapped_size, MADV_HUGEPAGE) == 0)
+            info.mode = memory_mode::transparent_huge_pages;
+#endif
+    }
+    if (base != MAP_FAILED)
+    {
+        info.numa_node = bind_to_local_node(base, mapped_size);
+        header = new (base) allocation_header{mapped_size, {}};
+    }
+#endif
+
+    if (!header)
+    {
+        void* base = std::calloc(1, total);
+        if (!base)
+            return nullptr;
+        info = {memory_mode::heap, -1};
+        header = new (base) allocation_header{0, {}};
+    }
+
+    (use == memory_use::epoch_context ? context_memory_info : dataset_memory_info).store(info);
+    return header + 1;
+}
+
+void free_large(void* ptr) noexcept
+{
+    if (!ptr)
+        return;
+    auto* header = static_cast<allocation_header*>(ptr) - 1;
+#if defined(__linux__)
+    if (header->mapped_size != 0)
+    {
+        munmap(header, header->mapped_size);
+        return;
+    }
+#endif
+    std::free(header);
+}
+}  // namespace ethash
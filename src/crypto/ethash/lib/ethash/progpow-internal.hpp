@@ -0,0 +1,83 @@
+// Copyright (c) 2024 The Regus Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+/// @file
+/// Contains declarations of internal ProgPoW functions shared by the
+/// instruction-set specific implementations of the mix.
+
+#pragma once
+
+#include <crypto/ethash/include/ethash/progpow.hpp>
+
+#include <cstdint>
+#include <memory>
+
+namespace progpow
+{
+constexpr size_t num_words_per_lane = sizeof(hash2048) / (sizeof(uint32_t) * num_lanes);
+
+/// The mix state of all lanes.
+///
+/// Stored register-major, so that one register of all 16 lanes is contiguous
+/// and each operation of the program applies to a single 512-bit row.
+struct mix_array
+{
+    alignas(64) uint32_t regs[num_regs][num_lanes];
+};
+
+/// A decoded cache access or random math step of the ProgPoW program.
+///
+/// The selectors are resolved into a kernel specialized for the operation, so
+/// executing the program needs no RNG and no per-lane dispatch.
+struct mix_instruction
+{
+    using kernel_fn = void (*)(mix_array& mix, const mix_instruction& op, const uint32_t* l1_cache) noexcept;
+
+    kernel_fn kernel;
+    uint8_t src1;
+    uint8_t src2;
+    uint8_t dst;
+    uint8_t merge_shift;
+};
+
+/// A decoded merge of one word of the dataset item into every lane.
+struct dag_instruction
+{
+    using kernel_fn = void (*)(mix_array& mix, const dag_instruction& op, const hash2048& item, uint32_t r) noexcept;
+
+    kernel_fn kernel;
+    uint8_t word;
+    uint8_t dst;
+    uint8_t merge_shift;
+};
+
+/// The mix kernels of one implementation, indexed by selector:
+/// `cache[sel % 4]`, `math[(sel1 % 11) * 4 + sel2 % 4]` and `dag[sel % 4]`.
+struct mix_kernels
+{
+    const char* name;
+
+    /// Fills the initial mix of every lane from the KISS99 seed.
+    void (*init_mix)(mix_array& mix, uint32_t seed_lo, uint32_t seed_hi) noexcept;
+
+    mix_instruction::kernel_fn cache[4];
+    mix_instruction::kernel_fn math[11 * 4];
+    dag_instruction::kernel_fn dag[4];
+};
+
+class item_cache;
+
+/// The cache configured with set_item_cache_size(), or null if it is disabled.
+std::shared_ptr<item_cache> get_item_cache() noexcept;
+
+/// Returns the dataset item from the cache, computing and storing it if needed.
+hash2048 lookup_cached_item(item_cache& cache, const epoch_context& context, uint32_t index) noexcept;
+
+#if defined(ENABLE_AVX2)
+extern const mix_kernels avx2_mix_kernels;
+#endif
+#if defined(ENABLE_AVX512)
+extern const mix_kernels avx512_mix_kernels;
+#endif
+}  // namespace progpow
@@ -3,15 +3,26 @@
 // Distributed under the MIT software license, see the accompanying
 // file COPYING or http://www.opensource.org/licenses/mit-license.php.
 
+#if defined(HAVE_CONFIG_H)
+#include <config/regus-config.h>
+#endif
+
 #include <crypto/ethash/include/ethash/progpow.hpp>
 
 #include <crypto/ethash/lib/ethash/bit_manipulation.h>
 #include <crypto/ethash/lib/ethash/endianness.hpp>
 #include <crypto/ethash/lib/ethash/ethash-internal.hpp>
 #include <crypto/ethash/lib/ethash/kiss99.hpp>
+#include <crypto/ethash/lib/ethash/progpow-internal.hpp>
+#include <crypto/ethash/lib/support/cpu_features.hpp>
 #include <crypto/ethash/include/ethash/keccak.hpp>
 
+#include <algorithm>
 #include <array>
+#include <atomic>
+#include <cstdlib>
+#include <new>
+#include <utility>
 
 namespace progpow
 {
@@ -89,59 +100,51 @@ mix_rng_state::mix_rng_state(uint32_t* hash_seed) noexcept
 }
 
 
+/// Random math operation, selected by `selector % 11`.
+template <uint32_t Selector>
 NO_SANITIZE("unsigned-integer-overflow")
-inline uint32_t random_math(uint32_t a, uint32_t b, uint32_t selector) noexcept
+inline uint32_t random_math(uint32_t a, uint32_t b) noexcept
 {
-    switch (selector % 11)
-    {
-    default:
-    case 0:
+    if constexpr (Selector == 0)
         return a + b;
-    case 1:
+    else if constexpr (Selector == 1)
         return a * b;
-    case 2:
+    else if constexpr (Selector == 2)
         return mul_hi32(a, b);
-    case 3:
+    else if constexpr (Selector == 3)
         return std::min(a, b);
-    case 4:
+    else if constexpr (Selector == 4)
         return rotl32(a, b);
-    case 5:
+    else if constexpr (Selector == 5)
         return rotr32(a, b);
-    case 6:
+    else if constexpr (Selector == 6)
         return a & b;
-    case 7:
+    else if constexpr (Selector == 7)
         return a | b;
-    case 8:
+    else if constexpr (Selector == 8)
         return a ^ b;
-    case 9:
+    else if constexpr (Selector == 9)
         return clz32(a) + clz32(b);
-    case 10:
+    else
         return popcount32(a) + popcount32(b);
-    }
 }
 
-/// Merge data from `b` and `a`.
+/// Merge data from `b` and `a`, selected by `selector % 4`.
 /// Assuming `a` has high entropy, only do ops that retain entropy even if `b`
 /// has low entropy (i.e. do not do `a & b`).
+/// `x` is the additional non-zero selector `(selector >> 16) % 31 + 1`.
+template <uint32_t Selector>
 NO_SANITIZE("unsigned-integer-overflow")
-inline void random_merge(uint32_t& a, uint32_t b, uint32_t selector) noexcept
+inline void random_merge(uint32_t& a, uint32_t b, uint32_t x) noexcept
 {
-    const auto x = (selector >> 16) % 31 + 1;  // Additional non-zero selector from higher bits.
-    switch (selector % 4)
-    {
-    case 0:
+    if constexpr (Selector == 0)
         a = (a * 33) + b;
-        break;
-    case 1:
+    else if constexpr (Selector == 1)
         a = (a ^ b) * 33;
-        break;
-    case 2:
+    else if constexpr (Selector == 2)
         a = rotl32(a, x) ^ b;
-        break;
-    case 3:
+    else
         a = rotr32(a, x) ^ b;
-        break;
-    }
 }
 
 static const uint32_t round_constants[22] = {
@@ -165,33 +168,106 @@ static const uint32_t ethash_constants[15] = {
 
 using lookup_fn = hash2048 (*)(const epoch_context&, uint32_t);
 
-using mix_array = std::array<std::array<uint32_t, num_regs>, num_lanes>;
+template <uint32_t Merge>
+void cache_kernel(mix_array& mix, const mix_instruction& op, const uint32_t* l1_cache) noexcept
+{
+    for (size_t l = 0; l < num_lanes; ++l)
+    {
+        const size_t offset = mix.regs[op.src1][l] % l1_cache_num_items;
+        random_merge<Merge>(mix.regs[op.dst][l], le::uint32(l1_cache[offset]), op.merge_shift);
+    }
+}
 
-void round(
-    const epoch_context& context, uint32_t r, mix_array& mix, mix_rng_state state, lookup_fn lookup)
+template <uint32_t Math, uint32_t Merge>
+void math_kernel(mix_array& mix, const mix_instruction& op, const uint32_t*) noexcept
 {
-    const uint32_t num_items = static_cast<uint32_t>(context.full_dataset_num_items / 2);
-    const uint32_t item_index = mix[r % num_lanes][0] % num_items;
-    const hash2048 item = lookup(context, item_index);
+    for (size_t l = 0; l < num_lanes; ++l)
+    {
+        const uint32_t data = random_math<Math>(mix.regs[op.src1][l], mix.regs[op.src2][l]);
+        random_merge<Merge>(mix.regs[op.dst][l], data, op.merge_shift);
+    }
+}
+
+template <uint32_t Merge>
+void dag_kernel(mix_array& mix, const dag_instruction& op, const hash2048& item, uint32_t r) noexcept
+{
+    for (size_t l = 0; l < num_lanes; ++l)
+    {
+        const auto offset = ((l ^ r) % num_lanes) * num_words_per_lane;
+        const auto word = le::uint32(item.word32s[offset + op.word]);
+        random_merge<Merge>(mix.regs[op.dst][l], word, op.merge_shift);
+    }
+}
+
+void init_mix(mix_array& mix, uint32_t seed_lo, uint32_t seed_hi) noexcept
+{
+    const uint32_t z = fnv1a(fnv_offset_basis, seed_lo);
+    const uint32_t w = fnv1a(z, seed_hi);
+
+    for (uint32_t l = 0; l < num_lanes; ++l)
+    {
+        const uint32_t jsr = fnv1a(w, l);
+        const uint32_t jcong = fnv1a(jsr, l);
+        kiss99 rng{z, w, jsr, jcong};
+
+        for (uint32_t i = 0; i < num_regs; ++i)
+            mix.regs[i][l] = rng();
+    }
+}
+
+template <size_t... I>
+constexpr mix_kernels make_generic_kernels(std::index_sequence<I...>) noexcept
+{
+    return {"generic", &init_mix, {&cache_kernel<0>, &cache_kernel<1>, &cache_kernel<2>, &cache_kernel<3>},
+        {&math_kernel<I / 4, I % 4>...}, {&dag_kernel<0>, &dag_kernel<1>, &dag_kernel<2>, &dag_kernel<3>}};
+}
+
+constexpr mix_kernels generic_mix_kernels = make_generic_kernels(std::make_index_sequence<11 * 4>{});
+
+/// The mix implementation in use, see select_mix_implementation().
+std::atomic<const mix_kernels*> g_mix_kernels{&generic_mix_kernels};
+
+/// The ProgPoW program of one period.
+///
+/// The RNG state is the same at the start of every round, so all 64 rounds of
+/// every hash in a period execute the same sequence of operations.
+struct program
+{
+    uint64_t period = 0;
+    const mix_kernels* kernels = nullptr;
+    std::array<mix_instruction, num_cache_accesses + num_math_operations> mix_ops;
+    std::array<dag_instruction, num_words_per_lane> dag_ops;
+};
+
+inline uint8_t merge_shift(uint32_t selector) noexcept
+{
+    return static_cast<uint8_t>((selector >> 16) % 31 + 1);
+}
+
+/// Generates the program of a period, drawing from the RNG in exactly the
+/// order the reference round does.
+void compile_program(program& prog, uint64_t period, const mix_kernels& kernels) noexcept
+{
+    uint32_t seed[2];
+    seed[0] = static_cast<uint32_t>(period);
+    seed[1] = static_cast<uint32_t>(period >> 32);
+    mix_rng_state state{seed};
 
-    constexpr size_t num_words_per_lane = sizeof(item) / (sizeof(uint32_t) * num_lanes);
     constexpr int max_operations =
         num_cache_accesses > num_math_operations ? num_cache_accesses : num_math_operations;
 
-    // Process lanes.
+    size_t n = 0;
     for (int i = 0; i < max_operations; ++i)
     {
         if (i < num_cache_accesses)  // Random access to cached memory.
         {
-            const auto src = state.next_src();
-            const auto dst = state.next_dst();
+            auto& op = prog.mix_ops[n++];
+            op.src1 = static_cast<uint8_t>(state.next_src());
+            op.src2 = 0;
+            op.dst = static_cast<uint8_t>(state.next_dst());
             const auto sel = state.rng();
-
-            for (size_t l = 0; l < num_lanes; ++l)
-            {
-                const size_t offset = mix[l][src] % l1_cache_num_items;
-                random_merge(mix[l][dst], le::uint32(context.l1_cache[offset]), sel);
-            }
+            op.kernel = kernels.cache[sel % 4];
+            op.merge_shift = merge_shift(sel);
         }
         if (i < num_math_operations)  // Random math.
         {
@@ -206,73 +282,73 @@ void round(
             const auto dst = state.next_dst();
             const auto sel2 = state.rng();
 
-            for (size_t l = 0; l < num_lanes; ++l)
-            {
-                const uint32_t data = random_math(mix[l][src1], mix[l][src2], sel1);
-                random_merge(mix[l][dst], data, sel2);
-            }
+            auto& op = prog.mix_ops[n++];
+            op.src1 = static_cast<uint8_t>(src1);
+            op.src2 = static_cast<uint8_t>(src2);
+            op.dst = static_cast<uint8_t>(dst);
+            op.kernel = kernels.math[(sel1 % 11) * 4 + sel2 % 4];
+            op.merge_shift = merge_shift(sel2);
         }
     }
 
     // DAG access pattern.
-    uint32_t dsts[num_words_per_lane];
-    uint32_t sels[num_words_per_lane];
     for (size_t i = 0; i < num_words_per_lane; ++i)
     {
-        dsts[i] = i == 0 ? 0 : state.next_dst();
-        sels[i] = state.rng();
+        auto& op = prog.dag_ops[i];
+        op.word = static_cast<uint8_t>(i);
+        op.dst = static_cast<uint8_t>(i == 0 ? 0 : state.next_dst());
+        const auto sel = state.rng();
+        op.kernel = kernels.dag[sel % 4];
+        op.merge_shift = merge_shift(sel);
     }
 
-    // DAG access.
-    for (size_t l = 0; l < num_lanes; ++l)
-    {
-        const auto offset = ((l ^ r) % num_lanes) * num_words_per_lane;
-        for (size_t i = 0; i < num_words_per_lane; ++i)
-        {
-            const auto word = le::uint32(item.word32s[offset + i]);
-            random_merge(mix[l][dsts[i]], word, sels[i]);
-        }
-    }
+    prog.period = period;
+    prog.kernels = &kernels;
 }
 
-mix_array init_mix(uint32_t* hash_seed)
+/// Returns the program of a period, compiling it on first use in this thread.
+/// Hashes of a period are usually computed back to back (verification of a
+/// block, a mining search), so one cached program per thread suffices.
+const program& get_program(uint64_t period) noexcept
 {
-    const uint32_t z = fnv1a(fnv_offset_basis, static_cast<uint32_t>(hash_seed[0]));
-    const uint32_t w = fnv1a(z, static_cast<uint32_t>(hash_seed[1]));
+    thread_local program cached{};
+    const mix_kernels* kernels = g_mix_kernels.load(std::memory_order_relaxed);
+    if (cached.kernels != kernels || cached.period != period)
+        compile_program(cached, period, *kernels);
+    return cached;
+}
 
-    mix_array mix;
-    for (uint32_t l = 0; l < mix.size(); ++l)
-    {
-        const uint32_t jsr = fnv1a(w, l);
-        const uint32_t jcong = fnv1a(jsr, l);
-        kiss99 rng{z, w, jsr, jcong};
+void round(const epoch_context& context, uint32_t r, mix_array& mix, const program& prog, lookup_fn lookup)
+{
+    const uint32_t num_items = static_cast<uint32_t>(context.full_dataset_num_items / 2);
+    const uint32_t item_index = mix.regs[0][r % num_lanes] % num_items;
+    const hash2048 item = lookup(context, item_index);
 
-        for (auto& row : mix[l])
-            row = rng();
-    }
-    return mix;
+    for (const auto& op : prog.mix_ops)
+        op.kernel(mix, op, context.l1_cache);
+
+    for (const auto& op : prog.dag_ops)
+        op.kernel(mix, op, item, r);
 }
 
 hash256 hash_mix(
     const epoch_context& context, int block_number, uint32_t * seed, lookup_fn lookup) noexcept
 {
-    auto mix = init_mix(seed);
-    auto number = uint64_t(block_number / period_length);
-    uint32_t new_state[2];
-    new_state[0] = number;
-    new_state[1] = number >> 32;
-    mix_rng_state state{new_state};
+    const program& prog = get_program(uint64_t(block_number / period_length));
+    mix_array mix;
+    prog.kernels->init_mix(mix, seed[0], seed[1]);
 
     for (uint32_t i = 0; i < 64; ++i)
-        round(context, i, mix, state, lookup);
+        round(context, i, mix, prog, lookup);
 
     // Reduce mix data to a single per-lane result.
     uint32_t lane_hash[num_lanes];
     for (size_t l = 0; l < num_lanes; ++l)
-    {
         lane_hash[l] = fnv_offset_basis;
-        for (uint32_t i = 0; i < num_regs; ++i)
-            lane_hash[l] = fnv1a(lane_hash[l], mix[l][i]);
+    for (uint32_t i = 0; i < num_regs; ++i)
+    {
+        for (size_t l = 0; l < num_lanes; ++l)
+            lane_hash[l] = fnv1a(lane_hash[l], mix.regs[i][l]);
     }
 
     // Reduce all lanes to a single 256-bit result.
@@ -284,10 +360,10 @@ hash256 hash_mix(
         hashMix.word32s[l % num_words] = fnv1a(hashMix.word32s[l % num_words], lane_hash[l]);
     return le::uint32s(hashMix);
 }
-}  // namespace
 
-result hash(const epoch_context& context, int block_number, const hash256& header_hash,
-    uint64_t nonce) noexcept
+/// Computes the ProgPoW hash, fetching dataset items through the given lookup function.
+result hash_with_lookup(const epoch_context& context, int block_number,
+    const hash256& header_hash, uint64_t nonce, lookup_fn lookup) noexcept
 {
     uint32_t hash_seed[2];  // KISS99 initiator
 
@@ -317,7 +393,7 @@ result hash(const epoch_context& context, int block_number, const hash256& heade
 
     hash_seed[0] = state2[0];
     hash_seed[1] = state2[1];
-    const hash256 hashMix = hash_mix(context, block_number, hash_seed, calculate_dataset_item_2048);
+    const hash256 hashMix = hash_mix(context, block_number, hash_seed, lookup);
 
     // Absorb phase for last round of keccak (256 bits)
 
@@ -345,6 +421,63 @@ result hash(const epoch_context& context, int block_number, const hash256& heade
     return {output, hashMix};
 }
 
+}  // namespace
+
+const char* select_mix_implementation(bool use_simd) noexcept
+{
+    const mix_kernels* kernels = &generic_mix_kernels;
+
+    if (use_simd)
+    {
+        [[maybe_unused]] const cpu_features features = detect_cpu_features();
+#if defined(ENABLE_AVX2)
+        if (features.avx2)
+            kernels = &avx2_mix_kernels;
+#endif
+#if defined(ENABLE_AVX512)
+        if (features.avx512)
+            kernels = &avx512_mix_kernels;
+#endif
+    }
+
+    g_mix_kernels.store(kernels, std::memory_order_relaxed);
+    return kernels->name;
+}
+
+namespace
+{
+/// A light context whose dataset items are looked up in the item cache.
+struct cached_epoch_context : epoch_context
+{
+    cached_epoch_context(const epoch_context& context, item_cache& cache) noexcept
+      : epoch_context{context}, cache{cache}
+    {}
+
+    item_cache& cache;
+};
+
+hash2048 cached_item_lookup(const epoch_context& ctx, uint32_t index) noexcept
+{
+    const auto& cached = static_cast<const cached_epoch_context&>(ctx);
+    return lookup_cached_item(cached.cache, cached, index);
+}
+
+hash256 light_hash_mix(const epoch_context& context, int block_number, uint32_t* seed) noexcept
+{
+    if (const std::shared_ptr<item_cache> cache = get_item_cache())
+        return hash_mix(cached_epoch_context{context, *cache}, block_number, seed, cached_item_lookup);
+    return hash_mix(context, block_number, seed, calculate_dataset_item_2048);
+}
+}  // namespace
+
+result hash(const epoch_context& context, int block_number, const hash256& header_hash,
+    uint64_t nonce) noexcept
+{
+    if (const std::shared_ptr<item_cache> cache = get_item_cache())
+        return hash_with_lookup(cached_epoch_context{context, *cache}, block_number, header_hash, nonce, cached_item_lookup);
+    return hash_with_lookup(context, block_number, header_hash, nonce, calculate_dataset_item_2048);
+}
+
 result hash(const epoch_context_full& context, int block_number, const hash256& header_hash,
     uint64_t nonce) noexcept
 {
@@ -362,61 +495,138 @@ result hash(const epoch_context_full& context, int block_number, const hash256&
         return item;
     };
 
-    uint32_t hash_seed[2];  // KISS99 initiator
-
-    uint32_t state2[8];
+    return hash_with_lookup(context, block_number, header_hash, nonce, lazy_lookup);
+}
 
+result hash(const epoch_dataset& dataset, int block_number, const hash256& header_hash,
+    uint64_t nonce) noexcept
+{
+    static const auto dataset_lookup = [](const epoch_context& ctx, uint32_t index) noexcept
     {
-        // Absorb phase for initial round of keccak
-
-        uint32_t state[25] = {0x0};     // Keccak's state
-
-        // 1st fill with header data (8 words)
-        for (int i = 0; i < 8; i++)
-            state[i] = header_hash.word32s[i];
+        return lookup_dataset_item(static_cast<const epoch_dataset&>(ctx), index);
+    };
 
-        // 2nd fill with nonce (2 words)
-        state[8] = nonce;
-        state[9] = nonce >> 32;
+    return hash_with_lookup(dataset, block_number, header_hash, nonce, dataset_lookup);
+}
 
-        // 3rd apply ethash input constraints
-        for (int i = 10; i < 25; i++)
-            state[i] = ethash_constants[i-10];
+namespace
+{
+enum : uint8_t
+{
+    item_empty = 0,
+    item_filling = 1,
+    item_ready = 2,
+};
+}  // namespace
 
-        keccak_progpow_64(state);
+epoch_dataset::epoch_dataset(epoch_context_shared_ptr light, uint32_t cached_items,
+    hash2048* item_data, std::atomic<uint8_t>* states) noexcept
+  : ethash_epoch_context{light->epoch_number, light->light_cache_num_items, light->light_cache,
+        light->l1_cache, light->full_dataset_num_items},
+    light_context{std::move(light)},
+    num_items{cached_items},
+    items{item_data},
+    item_states{states}
+{}
+
+epoch_dataset::~epoch_dataset()
+{
+    free_large(items);
+    delete[] item_states;
+}
 
-        for (int i = 0; i < 8; i++)
-            state2[i] = state[i];
+epoch_dataset_ptr create_epoch_dataset(epoch_context_shared_ptr context, uint64_t max_bytes) noexcept
+{
+    if (!context)
+        return nullptr;
+
+    const uint64_t total_items = static_cast<uint32_t>(context->full_dataset_num_items / 2);
+    const uint64_t budget_items = max_bytes / (sizeof(hash2048) + sizeof(uint8_t));
+    const auto cached_items = static_cast<uint32_t>(std::min(total_items, budget_items));
+    if (cached_items == 0)
+        return nullptr;
+
+    // Zeroed pages are only backed by memory once an item is written.
+    auto* items = static_cast<hash2048*>(allocate_large(size_t{cached_items} * sizeof(hash2048), memory_use::dataset));
+    auto* states = new (std::nothrow) std::atomic<uint8_t>[cached_items]();
+    if (!items || !states)
+    {
+        free_large(items);
+        delete[] states;
+        return nullptr;
     }
+    return std::make_shared<const epoch_dataset>(std::move(context), cached_items, items, states);
+}
 
-    hash_seed[0] = state2[0];
-    hash_seed[1] = state2[1];
-
-    const hash256 hashMix = hash_mix(context, block_number, hash_seed, lazy_lookup);
-
-    // Absorb phase for last round of keccak (256 bits)
-
-    uint32_t state[25] = {0x0};     // Keccak's state
+hash2048 lookup_dataset_item(const epoch_dataset& dataset, uint32_t index) noexcept
+{
+    if (index >= dataset.num_items)
+        return calculate_dataset_item_2048(dataset, index);
+
+    std::atomic<uint8_t>& state = dataset.item_states[index];
+    if (state.load(std::memory_order_acquire) == item_ready)
+        return dataset.items[index];
+
+    // Compute without holding anything, then let exactly one thread publish it.
+    // Readers only look at the item after observing item_ready.
+    const hash2048 item = calculate_dataset_item_2048(dataset, index);
+    uint8_t expected = item_empty;
+    if (state.compare_exchange_strong(expected, item_filling, std::memory_order_relaxed))
+    {
+        dataset.items[index] = item;
+        state.store(item_ready, std::memory_order_release);
+        dataset.num_filled.fetch_add(1, std::memory_order_relaxed);
+    }
+    return item;
+}
 
-    // 1st initial 8 words of state are kept as carry-over from initial keccak
-    for (int i = 0; i < 8; i++)
-        state[i] = state2[i];
+void fill_epoch_dataset(const epoch_dataset& dataset, uint32_t begin, uint32_t end) noexcept
+{
+    end = std::min(end, dataset.num_items);
+    for (uint32_t i = begin; i < end; ++i)
+    {
+        if (dataset.item_states[i].load(std::memory_order_relaxed) == item_empty)
+            lookup_dataset_item(dataset, i);
+    }
+}
 
-    // 2nd subsequent 8 words are carried from digest/mix
-    for (int i = 8; i < 16; i++)
-        state[i] = hashMix.word32s[i-8];
+void hash_no_verify_batch(size_t count, const hash256 header_hashes[], const hash256 mixes[],
+    const uint64_t nonces[], hash256 out[]) noexcept
+{
+    static constexpr size_t batch_size = 8;
+    for (size_t first = 0; first < count; first += batch_size)
+    {
+        const size_t n = std::min(batch_size, count - first);
 
-    // 3rd apply ethash input constraints
-    for (int i = 16; i < 25; i++)
-        state[i] = ethash_constants[i - 16];
+        // The same two keccak_progpow rounds as in hash_no_verify(), for a
+        // batch of headers at once. Unused slots of the last batch stay zero.
+        uint32_t states[batch_size][25] = {};
+        for (size_t b = 0; b < n; ++b)
+        {
+            for (int i = 0; i < 8; i++)
+                states[b][i] = header_hashes[first + b].word32s[i];
+            states[b][8] = static_cast<uint32_t>(nonces[first + b]);
+            states[b][9] = static_cast<uint32_t>(nonces[first + b] >> 32);
+            for (int i = 10; i < 25; i++)
+                states[b][i] = ethash_constants[i - 10];
+        }
+        keccakf800_x8(states);
 
-    // Run keccak loop
-    keccak_progpow_256(state);
+        for (size_t b = 0; b < n; ++b)
+        {
+            for (int i = 8; i < 16; i++)
+                states[b][i] = mixes[first + b].word32s[i - 8];
+            for (int i = 16; i < 25; i++)
+                states[b][i] = ethash_constants[i - 16];
+        }
+        keccakf800_x8(states);
 
-    hash256 output;
-    for (int i = 0; i < 8; ++i)
-        output.word32s[i] = le::uint32(state[i]);
-    return {output, hashMix};
+        for (size_t b = 0; b < n; ++b)
+        {
+            for (int i = 0; i < 8; ++i)
+                out[first + b].word32s[i] = le::uint32(states[b][i]);
+        }
+    }
 }
 
 bool verify(const epoch_context& context, int block_number, const hash256& header_hash,
@@ -479,8 +689,7 @@ bool verify(const epoch_context& context, int block_number, const hash256& heade
         return false;
     }
 
-    const hash256 expected_hashMix =
-        hash_mix(context, block_number, hash_seed, calculate_dataset_item_2048);
+    const hash256 expected_hashMix = light_hash_mix(context, block_number, hash_seed);
 
     return is_equal(expected_hashMix, hashMix);
 }
@@ -569,4 +778,18 @@ search_result search(const epoch_context_full& context, int block_number,
     return {};
 }
 
+search_result search(const epoch_dataset& dataset, int block_number,
+    const hash256& header_hash, const hash256& boundary, uint64_t start_nonce,
+    size_t iterations) noexcept
+{
+    const uint64_t end_nonce = start_nonce + iterations;
+    for (uint64_t nonce = start_nonce; nonce < end_nonce; ++nonce)
+    {
+        result r = hash(dataset, block_number, header_hash, nonce);
+        if (is_less_or_equal(r.final_hash, boundary))
+            return {r, nonce};
+    }
+    return {};
+}
+
 }  // namespace progpow
@@ -0,0 +1,209 @@
+// Copyright (c) 2024 The Regus Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+// This is a translation to AVX2 intrinsics of the ProgPoW mix kernels in
+// progpow.cpp. Each register row of the 16 lanes is processed as two 8-lane
+// vectors.
+
+#ifdef ENABLE_AVX2
+
+#include <crypto/ethash/lib/ethash/progpow-internal.hpp>
+#include <crypto/ethash/lib/support/attributes.h>
+
+#include <immintrin.h>
+
+#include <utility>
+
+namespace progpow
+{
+namespace
+{
+constexpr uint32_t fnv_prime = 0x01000193;
+constexpr uint32_t fnv_offset_basis = 0x811c9dc5;
+
+static_assert((l1_cache_num_items & (l1_cache_num_items - 1)) == 0);
+
+inline __m256i K(uint32_t x) { return _mm256_set1_epi32(x); }
+
+inline __m256i Load(const uint32_t* in) { return _mm256_load_si256(reinterpret_cast<const __m256i*>(in)); }
+inline void Store(uint32_t* out, __m256i v) { _mm256_store_si256(reinterpret_cast<__m256i*>(out), v); }
+
+inline __m256i Add(__m256i x, __m256i y) { return _mm256_add_epi32(x, y); }
+inline __m256i Mul(__m256i x, __m256i y) { return _mm256_mullo_epi32(x, y); }
+inline __m256i Xor(__m256i x, __m256i y) { return _mm256_xor_si256(x, y); }
+inline __m256i Or(__m256i x, __m256i y) { return _mm256_or_si256(x, y); }
+inline __m256i And(__m256i x, __m256i y) { return _mm256_and_si256(x, y); }
+inline __m256i ShL(__m256i x, int n) { return _mm256_slli_epi32(x, n); }
+inline __m256i ShR(__m256i x, int n) { return _mm256_srli_epi32(x, n); }
+
+inline __m256i MulHi(__m256i x, __m256i y)
+{
+    const __m256i even = _mm256_srli_epi64(_mm256_mul_epu32(x, y), 32);
+    const __m256i odd = _mm256_mul_epu32(_mm256_srli_epi64(x, 32), _mm256_srli_epi64(y, 32));
+    return _mm256_blend_epi32(even, odd, 0xaa);
+}
+
+/** Rotate each lane of x by the low 5 bits of the same lane of n. */
+inline __m256i RotL(__m256i x, __m256i n)
+{
+    n = And(n, K(31));
+    return Or(_mm256_sllv_epi32(x, n), _mm256_srlv_epi32(x, _mm256_sub_epi32(K(32), n)));
+}
+inline __m256i RotR(__m256i x, __m256i n)
+{
+    n = And(n, K(31));
+    return Or(_mm256_srlv_epi32(x, n), _mm256_sllv_epi32(x, _mm256_sub_epi32(K(32), n)));
+}
+
+/** Rotate all lanes by the same amount, 0 < n < 32. */
+inline __m256i RotL(__m256i x, uint32_t n)
+{
+    return Or(_mm256_sll_epi32(x, _mm_cvtsi32_si128(n)), _mm256_srl_epi32(x, _mm_cvtsi32_si128(32 - n)));
+}
+inline __m256i RotR(__m256i x, uint32_t n)
+{
+    return Or(_mm256_srl_epi32(x, _mm_cvtsi32_si128(n)), _mm256_sll_epi32(x, _mm_cvtsi32_si128(32 - n)));
+}
+
+inline __m256i PopCount(__m256i x)
+{
+    const __m256i nibble_counts = _mm256_setr_epi8(0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4,
+        0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4);
+    const __m256i low_nibbles = _mm256_set1_epi8(0x0f);
+    const __m256i byte_counts = _mm256_add_epi8(_mm256_shuffle_epi8(nibble_counts, And(x, low_nibbles)),
+        _mm256_shuffle_epi8(nibble_counts, And(_mm256_srli_epi16(x, 4), low_nibbles)));
+    return _mm256_madd_epi16(_mm256_maddubs_epi16(byte_counts, _mm256_set1_epi8(1)), _mm256_set1_epi16(1));
+}
+
+inline __m256i Clz(__m256i x)
+{
+    // Set every bit below the highest set one; the leading zeros are the rest.
+    x = Or(x, ShR(x, 1));
+    x = Or(x, ShR(x, 2));
+    x = Or(x, ShR(x, 4));
+    x = Or(x, ShR(x, 8));
+    x = Or(x, ShR(x, 16));
+    return _mm256_sub_epi32(K(32), PopCount(x));
+}
+
+inline __m256i Fnv1a(__m256i u, __m256i v) { return Mul(Xor(u, v), K(fnv_prime)); }
+
+template <uint32_t Selector>
+inline __m256i Math(__m256i a, __m256i b)
+{
+    if constexpr (Selector == 0)
+        return Add(a, b);
+    else if constexpr (Selector == 1)
+        return Mul(a, b);
+    else if constexpr (Selector == 2)
+        return MulHi(a, b);
+    else if constexpr (Selector == 3)
+        return _mm256_min_epu32(a, b);
+    else if constexpr (Selector == 4)
+        return RotL(a, b);
+    else if constexpr (Selector == 5)
+        return RotR(a, b);
+    else if constexpr (Selector == 6)
+        return And(a, b);
+    else if constexpr (Selector == 7)
+        return Or(a, b);
+    else if constexpr (Selector == 8)
+        return Xor(a, b);
+    else if constexpr (Selector == 9)
+        return Add(Clz(a), Clz(b));
+    else
+        return Add(PopCount(a), PopCount(b));
+}
+
+template <uint32_t Selector>
+inline __m256i Merge(__m256i a, __m256i b, uint32_t x)
+{
+    if constexpr (Selector == 0)
+        return Add(Add(ShL(a, 5), a), b);
+    else if constexpr (Selector == 1)
+    {
+        const __m256i t = Xor(a, b);
+        return Add(ShL(t, 5), t);
+    }
+    else if constexpr (Selector == 2)
+        return Xor(RotL(a, x), b);
+    else
+        return Xor(RotR(a, x), b);
+}
+
+template <uint32_t Selector>
+void cache_kernel(mix_array& mix, const mix_instruction& op, const uint32_t* l1_cache) noexcept
+{
+    const auto* l1 = reinterpret_cast<const int*>(l1_cache);
+    for (size_t l = 0; l < num_lanes; l += 8)
+    {
+        const __m256i offsets = And(Load(&mix.regs[op.src1][l]), K(l1_cache_num_items - 1));
+        const __m256i data = _mm256_i32gather_epi32(l1, offsets, 4);
+        Store(&mix.regs[op.dst][l], Merge<Selector>(Load(&mix.regs[op.dst][l]), data, op.merge_shift));
+    }
+}
+
+template <uint32_t MathSelector, uint32_t MergeSelector>
+void math_kernel(mix_array& mix, const mix_instruction& op, const uint32_t*) noexcept
+{
+    for (size_t l = 0; l < num_lanes; l += 8)
+    {
+        const __m256i data = Math<MathSelector>(Load(&mix.regs[op.src1][l]), Load(&mix.regs[op.src2][l]));
+        Store(&mix.regs[op.dst][l], Merge<MergeSelector>(Load(&mix.regs[op.dst][l]), data, op.merge_shift));
+    }
+}
+
+template <uint32_t Selector>
+void dag_kernel(mix_array& mix, const dag_instruction& op, const hash2048& item, uint32_t r) noexcept
+{
+    const auto* words = reinterpret_cast<const int*>(item.word32s);
+    const __m256i lanes[2] = {_mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7), _mm256_setr_epi32(8, 9, 10, 11, 12, 13, 14, 15)};
+    for (size_t l = 0; l < num_lanes; l += 8)
+    {
+        // Word op.word of the ((l ^ r) % num_lanes)-th group of the item.
+        const __m256i offsets = Add(ShL(And(Xor(lanes[l / 8], K(r)), K(num_lanes - 1)), 2), K(op.word));
+        const __m256i data = _mm256_i32gather_epi32(words, offsets, 4);
+        Store(&mix.regs[op.dst][l], Merge<Selector>(Load(&mix.regs[op.dst][l]), data, op.merge_shift));
+    }
+}
+
+NO_SANITIZE("unsigned-integer-overflow")
+void init_mix(mix_array& mix, uint32_t seed_lo, uint32_t seed_hi) noexcept
+{
+    // The z and w components of KISS99 are seeded identically for all lanes,
+    // so they are computed once; jsr and jcong are seeded from the lane index.
+    const uint32_t z = (fnv_offset_basis ^ seed_lo) * fnv_prime;
+    const uint32_t w = (z ^ seed_hi) * fnv_prime;
+    for (size_t l = 0; l < num_lanes; l += 8)
+    {
+        const __m256i lane = Add(_mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7), K(l));
+        __m256i jsr = Fnv1a(K(w), lane);
+        __m256i jcong = Fnv1a(jsr, lane);
+        uint32_t zl = z;
+        uint32_t wl = w;
+        for (uint32_t i = 0; i < num_regs; ++i)
+        {
+            zl = 36969 * (zl & 0xffff) + (zl >> 16);
+            wl = 18000 * (wl & 0xffff) + (wl >> 16);
+            jcong = Add(Mul(jcong, K(69069)), K(1234567));
+            jsr = Xor(jsr, ShL(jsr, 17));
+            jsr = Xor(jsr, ShR(jsr, 13));
+            jsr = Xor(jsr, ShL(jsr, 5));
+            Store(&mix.regs[i][l], Add(Xor(K((zl << 16) + wl), jcong), jsr));
+        }
+    }
+}
+
+template <size_t... I>
+constexpr mix_kernels make_kernels(std::index_sequence<I...>) noexcept
+{
+    return {"avx2", &init_mix, {&cache_kernel<0>, &cache_kernel<1>, &cache_kernel<2>, &cache_kernel<3>},
+        {&math_kernel<I / 4, I % 4>...}, {&dag_kernel<0>, &dag_kernel<1>, &dag_kernel<2>, &dag_kernel<3>}};
+}
+}  // namespace
+
+extern const mix_kernels avx2_mix_kernels = make_kernels(std::make_index_sequence<11 * 4>{});
+}  // namespace progpow
+
+#endif
@@ -0,0 +1,160 @@
+// Copyright (c) 2024 The Regus Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+// This is a translation to AVX-512 (F, CD and BW) intrinsics of the ProgPoW
+// mix kernels in progpow.cpp. Each register row of the 16 lanes is exactly one
+// 512-bit vector.
+
+#ifdef ENABLE_AVX512
+
+#include <crypto/ethash/lib/ethash/progpow-internal.hpp>
+#include <crypto/ethash/lib/support/attributes.h>
+
+#include <immintrin.h>
+
+#include <utility>
+
+namespace progpow
+{
+namespace
+{
+constexpr uint32_t fnv_prime = 0x01000193;
+constexpr uint32_t fnv_offset_basis = 0x811c9dc5;
+
+static_assert(num_lanes == 16);
+static_assert((l1_cache_num_items & (l1_cache_num_items - 1)) == 0);
+
+inline __m512i K(uint32_t x) { return _mm512_set1_epi32(x); }
+
+inline __m512i Load(const uint32_t* in) { return _mm512_load_si512(in); }
+inline void Store(uint32_t* out, __m512i v) { _mm512_store_si512(out, v); }
+
+inline __m512i Add(__m512i x, __m512i y) { return _mm512_add_epi32(x, y); }
+inline __m512i Mul(__m512i x, __m512i y) { return _mm512_mullo_epi32(x, y); }
+inline __m512i Xor(__m512i x, __m512i y) { return _mm512_xor_si512(x, y); }
+inline __m512i Or(__m512i x, __m512i y) { return _mm512_or_si512(x, y); }
+inline __m512i And(__m512i x, __m512i y) { return _mm512_and_si512(x, y); }
+inline __m512i ShL(__m512i x, unsigned int n) { return _mm512_slli_epi32(x, n); }
+inline __m512i ShR(__m512i x, unsigned int n) { return _mm512_srli_epi32(x, n); }
+
+inline __m512i MulHi(__m512i x, __m512i y)
+{
+    const __m512i even = _mm512_srli_epi64(_mm512_mul_epu32(x, y), 32);
+    const __m512i odd = _mm512_mul_epu32(_mm512_srli_epi64(x, 32), _mm512_srli_epi64(y, 32));
+    return _mm512_mask_blend_epi32(0xaaaa, even, odd);
+}
+
+inline __m512i PopCount(__m512i x)
+{
+    const __m512i nibble_counts = _mm512_set4_epi32(0x04030302, 0x03020201, 0x03020201, 0x02010100);
+    const __m512i low_nibbles = _mm512_set1_epi8(0x0f);
+    const __m512i byte_counts = _mm512_add_epi8(_mm512_shuffle_epi8(nibble_counts, And(x, low_nibbles)),
+        _mm512_shuffle_epi8(nibble_counts, And(_mm512_srli_epi16(x, 4), low_nibbles)));
+    return _mm512_madd_epi16(_mm512_maddubs_epi16(byte_counts, _mm512_set1_epi8(1)), _mm512_set1_epi16(1));
+}
+
+inline __m512i Fnv1a(__m512i u, __m512i v) { return Mul(Xor(u, v), K(fnv_prime)); }
+
+template <uint32_t Selector>
+inline __m512i Math(__m512i a, __m512i b)
+{
+    if constexpr (Selector == 0)
+        return Add(a, b);
+    else if constexpr (Selector == 1)
+        return Mul(a, b);
+    else if constexpr (Selector == 2)
+        return MulHi(a, b);
+    else if constexpr (Selector == 3)
+        return _mm512_min_epu32(a, b);
+    else if constexpr (Selector == 4)
+        return _mm512_rolv_epi32(a, b);
+    else if constexpr (Selector == 5)
+        return _mm512_rorv_epi32(a, b);
+    else if constexpr (Selector == 6)
+        return And(a, b);
+    else if constexpr (Selector == 7)
+        return Or(a, b);
+    else if constexpr (Selector == 8)
+        return Xor(a, b);
+    else if constexpr (Selector == 9)
+        return Add(_mm512_lzcnt_epi32(a), _mm512_lzcnt_epi32(b));
+    else
+        return Add(PopCount(a), PopCount(b));
+}
+
+template <uint32_t Selector>
+inline __m512i Merge(__m512i a, __m512i b, uint32_t x)
+{
+    if constexpr (Selector == 0)
+        return Add(Add(ShL(a, 5), a), b);
+    else if constexpr (Selector == 1)
+    {
+        const __m512i t = Xor(a, b);
+        return Add(ShL(t, 5), t);
+    }
+    else if constexpr (Selector == 2)
+        return Xor(_mm512_rolv_epi32(a, K(x)), b);
+    else
+        return Xor(_mm512_rorv_epi32(a, K(x)), b);
+}
+
+template <uint32_t Selector>
+void cache_kernel(mix_array& mix, const mix_instruction& op, const uint32_t* l1_cache) noexcept
+{
+    const __m512i offsets = And(Load(mix.regs[op.src1]), K(l1_cache_num_items - 1));
+    const __m512i data = _mm512_i32gather_epi32(offsets, l1_cache, 4);
+    Store(mix.regs[op.dst], Merge<Selector>(Load(mix.regs[op.dst]), data, op.merge_shift));
+}
+
+template <uint32_t MathSelector, uint32_t MergeSelector>
+void math_kernel(mix_array& mix, const mix_instruction& op, const uint32_t*) noexcept
+{
+    const __m512i data = Math<MathSelector>(Load(mix.regs[op.src1]), Load(mix.regs[op.src2]));
+    Store(mix.regs[op.dst], Merge<MergeSelector>(Load(mix.regs[op.dst]), data, op.merge_shift));
+}
+
+template <uint32_t Selector>
+void dag_kernel(mix_array& mix, const dag_instruction& op, const hash2048& item, uint32_t r) noexcept
+{
+    // Word op.word of the ((l ^ r) % num_lanes)-th group of the item.
+    const __m512i lanes = _mm512_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15);
+    const __m512i offsets = Add(ShL(And(Xor(lanes, K(r)), K(num_lanes - 1)), 2), K(op.word));
+    const __m512i data = _mm512_i32gather_epi32(offsets, item.word32s, 4);
+    Store(mix.regs[op.dst], Merge<Selector>(Load(mix.regs[op.dst]), data, op.merge_shift));
+}
+
+NO_SANITIZE("unsigned-integer-overflow")
+void init_mix(mix_array& mix, uint32_t seed_lo, uint32_t seed_hi) noexcept
+{
+    // The z and w components of KISS99 are seeded identically for all lanes,
+    // so they are computed once; jsr and jcong are seeded from the lane index.
+    uint32_t z = (fnv_offset_basis ^ seed_lo) * fnv_prime;
+    uint32_t w = (z ^ seed_hi) * fnv_prime;
+    const __m512i lanes = _mm512_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15);
+    __m512i jsr = Fnv1a(K(w), lanes);
+    __m512i jcong = Fnv1a(jsr, lanes);
+    for (uint32_t i = 0; i < num_regs; ++i)
+    {
+        z = 36969 * (z & 0xffff) + (z >> 16);
+        w = 18000 * (w & 0xffff) + (w >> 16);
+        jcong = Add(Mul(jcong, K(69069)), K(1234567));
+        jsr = Xor(jsr, ShL(jsr, 17));
+        jsr = Xor(jsr, ShR(jsr, 13));
+        jsr = Xor(jsr, ShL(jsr, 5));
+        Store(mix.regs[i], Add(Xor(K((z << 16) + w), jcong), jsr));
+    }
+}
+
+template <size_t... I>
+constexpr mix_kernels make_kernels(std::index_sequence<I...>) noexcept
+{
+    return {"avx512", &init_mix, {&cache_kernel<0>, &cache_kernel<1>, &cache_kernel<2>, &cache_kernel<3>},
+        {&math_kernel<I / 4, I % 4>...}, {&dag_kernel<0>, &dag_kernel<1>, &dag_kernel<2>, &dag_kernel<3>}};
+}
+}  // namespace
+
+extern const mix_kernels avx512_mix_kernels = make_kernels(std::make_index_sequence<11 * 4>{});
+}  // namespace progpow
+
+#endif
@@ -0,0 +1,21 @@
+// Copyright (c) 2024 The Regus Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+/// @file
+/// Contains declarations of the instruction-set specific batched Keccak backends.
+
+#pragma once
+
+#include <cstdint>
+
+namespace ethash
+{
+#if defined(ENABLE_AVX2)
+namespace avx2
+{
+void keccakf1600_x4(uint64_t states[4][25]) noexcept;
+void keccakf800_x8(uint32_t states[8][25]) noexcept;
+}  // namespace avx2
+#endif
+}  // namespace ethash
@@ -0,0 +1,148 @@
+// Copyright (c) 2024 The Regus Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+// Keccak-f[1600] on four states and Keccak-f[800] on eight states at once,
+// with one state per 64-bit (respectively 32-bit) element of each AVX2 vector.
+
+#ifdef ENABLE_AVX2
+
+#include <crypto/ethash/lib/keccak/keccak-internal.hpp>
+
+#include <immintrin.h>
+
+namespace ethash
+{
+namespace avx2
+{
+namespace
+{
+/// Rotation offsets of the rho step, indexed by x + 5 * y.
+constexpr int rho_offsets[25] = {
+    0, 1, 62, 28, 27,
+    36, 44, 6, 55, 20,
+    3, 10, 43, 25, 39,
+    41, 45, 15, 21, 8,
+    18, 2, 61, 56, 14,
+};
+
+constexpr uint64_t round_constants[24] = {
+    0x0000000000000001, 0x0000000000008082, 0x800000000000808A, 0x8000000080008000,
+    0x000000000000808B, 0x0000000080000001, 0x8000000080008081, 0x8000000000008009,
+    0x000000000000008A, 0x0000000000000088, 0x0000000080008009, 0x000000008000000A,
+    0x000000008000808B, 0x800000000000008B, 0x8000000000008089, 0x8000000000008003,
+    0x8000000000008002, 0x8000000000000080, 0x000000000000800A, 0x800000008000000A,
+    0x8000000080008081, 0x8000000000008080, 0x0000000080000001, 0x8000000080008008,
+};
+
+/// 4 x 64-bit lanes.
+struct lanes64
+{
+    static __m256i rotl(__m256i x, int n)
+    {
+        return n == 0 ? x : _mm256_or_si256(_mm256_slli_epi64(x, n), _mm256_srli_epi64(x, 64 - n));
+    }
+    static __m256i constant(uint64_t c) { return _mm256_set1_epi64x(static_cast<long long>(c)); }
+    static constexpr int bits = 64;
+};
+
+/// 8 x 32-bit lanes.
+struct lanes32
+{
+    static __m256i rotl(__m256i x, int n)
+    {
+        return n == 0 ? x : _mm256_or_si256(_mm256_slli_epi32(x, n), _mm256_srli_epi32(x, 32 - n));
+    }
+    static __m256i constant(uint64_t c) { return _mm256_set1_epi32(static_cast<int>(static_cast<uint32_t>(c))); }
+    static constexpr int bits = 32;
+};
+
+// The loops over the state are fully unrolled, so that all indexes and
+// rotation offsets are constants and the state stays in registers.
+template <typename Lanes>
+void permute(__m256i a[25], int num_rounds)
+{
+    for (int round = 0; round < num_rounds; ++round)
+    {
+        // Theta.
+        __m256i c[5];
+#pragma GCC unroll 5
+        for (int x = 0; x < 5; ++x)
+            c[x] = _mm256_xor_si256(_mm256_xor_si256(_mm256_xor_si256(a[x], a[x + 5]), _mm256_xor_si256(a[x + 10], a[x + 15])), a[x + 20]);
+#pragma GCC unroll 5
+        for (int x = 0; x < 5; ++x)
+        {
+            const __m256i d = _mm256_xor_si256(c[(x + 4) % 5], Lanes::rotl(c[(x + 1) % 5], 1));
+#pragma GCC unroll 5
+            for (int y = 0; y < 25; y += 5)
+                a[x + y] = _mm256_xor_si256(a[x + y], d);
+        }
+
+        // Rho and pi: B[y, 2x + 3y] = rotl(A[x, y], r[x, y]).
+        __m256i b[25];
+#pragma GCC unroll 5
+        for (int y = 0; y < 5; ++y)
+        {
+#pragma GCC unroll 5
+            for (int x = 0; x < 5; ++x)
+                b[y + 5 * ((2 * x + 3 * y) % 5)] = Lanes::rotl(a[x + 5 * y], rho_offsets[x + 5 * y] % Lanes::bits);
+        }
+
+        // Chi.
+#pragma GCC unroll 5
+        for (int y = 0; y < 25; y += 5)
+        {
+#pragma GCC unroll 5
+            for (int x = 0; x < 5; ++x)
+                a[x + y] = _mm256_xor_si256(b[x + y], _mm256_andnot_si256(b[(x + 1) % 5 + y], b[(x + 2) % 5 + y]));
+        }
+
+        // Iota.
+        a[0] = _mm256_xor_si256(a[0], Lanes::constant(round_constants[round]));
+    }
+}
+}  // namespace
+
+void keccakf1600_x4(uint64_t states[4][25]) noexcept
+{
+    __m256i a[25];
+    for (int i = 0; i < 25; ++i)
+    {
+        a[i] = _mm256_setr_epi64x(static_cast<long long>(states[0][i]), static_cast<long long>(states[1][i]),
+            static_cast<long long>(states[2][i]), static_cast<long long>(states[3][i]));
+    }
+
+    permute<lanes64>(a, 24);
+
+    alignas(32) uint64_t out[4];
+    for (int i = 0; i < 25; ++i)
+    {
+        _mm256_store_si256(reinterpret_cast<__m256i*>(out), a[i]);
+        for (int s = 0; s < 4; ++s)
+            states[s][i] = out[s];
+    }
+}
+
+void keccakf800_x8(uint32_t states[8][25]) noexcept
+{
+    const __m256i state_offsets = _mm256_setr_epi32(0, 25, 50, 75, 100, 125, 150, 175);
+    const auto* words = reinterpret_cast<const int*>(states[0]);
+
+    __m256i a[25];
+    for (int i = 0; i < 25; ++i)
+        a[i] = _mm256_i32gather_epi32(words + i, state_offsets, 4);
+
+    permute<lanes32>(a, 22);
+
+    alignas(32) uint32_t out[8];
+    for (int i = 0; i < 25; ++i)
+    {
+        _mm256_store_si256(reinterpret_cast<__m256i*>(out), a[i]);
+        for (int s = 0; s < 8; ++s)
+            states[s][i] = out[s];
+    }
+}
+}  // namespace avx2
+}  // namespace ethash
+
+#endif
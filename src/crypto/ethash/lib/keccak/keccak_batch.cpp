@@ -0,0 +1,94 @@
+// Copyright (c) 2024 The Regus Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#if defined(HAVE_CONFIG_H)
+#include <config/regus-config.h>
+#endif
+
+#include <crypto/ethash/include/ethash/keccak.hpp>
+
+#include <crypto/ethash/lib/ethash/endianness.hpp>
+#include <crypto/ethash/lib/keccak/keccak-internal.hpp>
+#include <crypto/ethash/lib/support/cpu_features.hpp>
+
+#include <atomic>
+
+namespace ethash
+{
+namespace
+{
+void keccakf1600_x4_generic(uint64_t states[4][25]) noexcept
+{
+    for (int i = 0; i < 4; ++i)
+        ethash_keccakf1600(states[i]);
+}
+
+void keccakf800_x8_generic(uint32_t states[8][25]) noexcept
+{
+    for (int i = 0; i < 8; ++i)
+        ethash_keccakf800(states[i]);
+}
+
+using keccakf1600_x4_fn = void (*)(uint64_t states[4][25]) noexcept;
+using keccakf800_x8_fn = void (*)(uint32_t states[8][25]) noexcept;
+
+std::atomic<keccakf1600_x4_fn> g_keccakf1600_x4{keccakf1600_x4_generic};
+std::atomic<keccakf800_x8_fn> g_keccakf800_x8{keccakf800_x8_generic};
+}  // namespace
+
+const char* select_keccak_implementation(bool use_simd) noexcept
+{
+    keccakf1600_x4_fn f1600 = keccakf1600_x4_generic;
+    keccakf800_x8_fn f800 = keccakf800_x8_generic;
+    const char* name = "generic";
+
+    if (use_simd)
+    {
+        [[maybe_unused]] const cpu_features features = detect_cpu_features();
+#if defined(ENABLE_AVX2)
+        if (features.avx2)
+        {
+            f1600 = avx2::keccakf1600_x4;
+            f800 = avx2::keccakf800_x8;
+            name = "avx2(4way,8way)";
+        }
+#endif
+    }
+
+    g_keccakf1600_x4.store(f1600, std::memory_order_relaxed);
+    g_keccakf800_x8.store(f800, std::memory_order_relaxed);
+    return name;
+}
+
+void keccakf1600_x4(uint64_t states[4][25]) noexcept
+{
+    g_keccakf1600_x4.load(std::memory_order_relaxed)(states);
+}
+
+void keccakf800_x8(uint32_t states[8][25]) noexcept
+{
+    g_keccakf800_x8.load(std::memory_order_relaxed)(states);
+}
+
+void keccak512_x4(hash512 out[4], const hash512 in[4]) noexcept
+{
+    // A 64-byte message and its padding fit in the 72-byte block of Keccak-512.
+    static constexpr size_t num_words = sizeof(hash512) / sizeof(uint64_t);
+    uint64_t states[4][25] = {};
+    for (int i = 0; i < 4; ++i)
+    {
+        for (size_t j = 0; j < num_words; ++j)
+            states[i][j] = le::uint64(in[i].word64s[j]);
+        states[i][num_words] = 0x8000000000000001;
+    }
+
+    keccakf1600_x4(states);
+
+    for (int i = 0; i < 4; ++i)
+    {
+        for (size_t j = 0; j < num_words; ++j)
+            out[i].word64s[j] = le::uint64(states[i][j]);
+    }
+}
+}  // namespace ethash
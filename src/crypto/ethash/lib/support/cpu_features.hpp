@@ -0,0 +1,43 @@
+// Copyright (c) 2024 The Regus Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#pragma once
+
+#include <compat/cpuid.h>
+
+#include <cstdint>
+
+namespace ethash
+{
+/// The instruction set extensions the SIMD backends of ethash use.
+struct cpu_features
+{
+    bool avx2 = false;
+    /// AVX-512 F, CD and BW.
+    bool avx512 = false;
+};
+
+/// Queries CPUID and the registers the OS saves on context switches (XCR0).
+inline cpu_features detect_cpu_features() noexcept
+{
+    cpu_features features;
+#if defined(HAVE_GETCPUID)
+    uint32_t eax, ebx, ecx, edx;
+    GetCPUID(0, 0, eax, ebx, ecx, edx);
+    const uint32_t max_leaf = eax;
+    GetCPUID(1, 0, eax, ebx, ecx, edx);
+    const bool have_osxsave = (ecx >> 27) & 1;
+    const bool have_avx = (ecx >> 28) & 1;
+    if (max_leaf < 7 || !have_osxsave || !have_avx)
+        return features;
+
+    uint32_t xcr0, xcr0_hi;
+    __asm__("xgetbv" : "=a"(xcr0), "=d"(xcr0_hi) : "c"(0));
+    GetCPUID(7, 0, eax, ebx, ecx, edx);
+    features.avx2 = ((ebx >> 5) & 1) && (xcr0 & 0x06) == 0x06;
+    features.avx512 = ((ebx >> 16) & 1) && ((ebx >> 28) & 1) && ((ebx >> 30) & 1) && (xcr0 & 0xe6) == 0xe6;
+#endif
+    return features;
+}
+}  // namespace ethash
@@ -0,0 +1,404 @@
+// Copyright (c) 2024 The Regus Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef REGUS_FLATHASHMAP_H
+#define REGUS_FLATHASHMAP_H
+
+#include <algorithm>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <iterator>
+#include <new>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+/**
+ * Hash map that stores its entries in a single array instead of allocating a
+ * node per entry, in the style of SwissTable.
+ *
+ * Behind the slots is one control byte per slot, which holds 7 bits of the
+ * hash of the key in a full slot, or marks the slot as empty or deleted. A
+ * lookup compares the control bytes of a group of 16 slots at once (with SSE2
+ * where available) and only compares the keys whose 7 bits match, so that it
+ * usually touches one cache line of control bytes and a single slot. Groups
+ * are probed in triangular order starting at the group picked by the other
+ * bits of the hash, which must therefore be well mixed throughout. The map
+ * grows when 7/8 of its slots are in use.
+ *
+ * As with std::unordered_map, erase() returns an iterator to the next entry
+ * and does not invalidate other iterators, so that entries can be erased while
+ * iterating over the map. Unlike with it, an insertion may move all entries,
+ * invalidating all iterators and references.
+ */
+template <typename Key, typename T, typename Hash, typename KeyEqual = std::equal_to<Key>>
+class FlatHashMap
+{
+public:
+    using key_type = Key;
+    using mapped_type = T;
+    using value_type = std::pair<const Key, T>;
+    using size_type = size_t;
+    using difference_type = std::ptrdiff_t;
+    using hasher = Hash;
+    using key_equal = KeyEqual;
+
+private:
+    using ctrl_t = int8_t;
+    static constexpr ctrl_t CTRL_EMPTY{-128};
+    static constexpr ctrl_t CTRL_DELETED{-2};
+    //! Follows the last control byte, so that iterators stop there
+    static constexpr ctrl_t CTRL_SENTINEL{-1};
+    static constexpr size_t GROUP_WIDTH{16};
+
+    //! Control bytes of a map without slots
+    static constexpr ctrl_t EMPTY_CTRL[1]{CTRL_SENTINEL};
+
+    /** The control bytes of GROUP_WIDTH consecutive slots. Matches are returned as one bit per slot. */
+    class Group
+    {
+#if defined(__SSE2__)
+        __m128i m_ctrl;
+
+        uint32_t Mask(__m128i matches) const { return static_cast<uint32_t>(_mm_movemask_epi8(matches)); }
+
+    public:
+        explicit Group(const ctrl_t* ctrl) : m_ctrl{_mm_loadu_si128(reinterpret_cast<const __m128i*>(ctrl))} {}
+        uint32_t Match(ctrl_t h2) const { return Mask(_mm_cmpeq_epi8(_mm_set1_epi8(h2), m_ctrl)); }
+        uint32_t MatchEmpty() const { return Match(CTRL_EMPTY); }
+        uint32_t MatchEmptyOrDeleted() const { return Mask(_mm_cmpgt_epi8(_mm_set1_epi8(CTRL_SENTINEL), m_ctrl)); }
+#else
+        const ctrl_t* m_ctrl;
+
+        template <typename Pred>
+        uint32_t Mask(Pred pred) const
+        {
+            uint32_t mask{0};
+            for (size_t i{0}; i < GROUP_WIDTH; ++i) {
+                mask |= uint32_t{pred(m_ctrl[i])} << i;
+            }
+            return mask;
+        }
+
+    public:
+        explicit Group(const ctrl_t* ctrl) : m_ctrl{ctrl} {}
+        uint32_t Match(ctrl_t h2) const { return Mask([h2](ctrl_t c) { return c == h2; }); }
+        uint32_t MatchEmpty() const { return Match(CTRL_EMPTY); }
+        uint32_t MatchEmptyOrDeleted() const { return Mask([](ctrl_t c) { return c < CTRL_SENTINEL; }); }
+#endif
+    };
+
+    template <bool CONST>
+    class Iterator
+    {
+        friend class FlatHashMap;
+        friend class Iterator<!CONST>;
+
+        const ctrl_t* m_ctrl{nullptr};
+        std::pair<const Key, T>* m_slot{nullptr};
+
+        Iterator(const ctrl_t* ctrl, std::pair<const Key, T>* slot) : m_ctrl{ctrl}, m_slot{slot} {}
+
+        /** Move to the next full slot, or to the end. */
+        void SkipFree()
+        {
+            while (*m_ctrl < CTRL_SENTINEL) {
+                ++m_ctrl;
+                ++m_slot;
+            }
+        }
+
+    public:
+        using iterator_category = std::forward_iterator_tag;
+        using value_type = std::pair<const Key, T>;
+        using difference_type = std::ptrdiff_t;
+        using pointer = std::conditional_t<CONST, const value_type*, value_type*>;
+        using reference = std::conditional_t<CONST, const value_type&, value_type&>;
+
+        Iterator() = default;
+        template <bool OTHER, typename = std::enable_if_t<CONST && !OTHER>>
+        Iterator(const Iterator<OTHER>& other) : m_ctrl{other.m_ctrl}, m_slot{other.m_slot} {}
+
+        reference operator*() const { return *m_slot; }
+        pointer operator->() const { return m_slot; }
+
+        Iterator& operator++()
+        {
+            ++m_ctrl;
+            ++m_slot;
+            SkipFree();
+            return *this;
+        }
+        Iterator operator++(int)
+        {
+            Iterator copy{*this};
+            ++*this;
+            return copy;
+        }
+
+        friend bool operator==(const Iterator& a, const Iterator& b) { return a.m_ctrl == b.m_ctrl; }
+    };
+
+public:
+    using iterator = Iterator<false>;
+    using const_iterator = Iterator<true>;
+
+    explicit FlatHashMap(size_type capacity = 0, const Hash& hash = Hash{}, const KeyEqual& equal = KeyEqual{})
+        : m_hash{hash}, m_equal{equal}
+    {
+        reserve(capacity);
+    }
+
+    /** Takes the same arguments as a node-based map over a memory resource, which this map does not use. */
+    template <typename Resource>
+    FlatHashMap(size_type capacity, const Hash& hash, const KeyEqual& equal, Resource*)
+        : FlatHashMap{capacity, hash, equal} {}
+
+    FlatHashMap(const FlatHashMap& other) : FlatHashMap{other.size(), other.m_hash, other.m_equal}
+    {
+        for (const value_type& value : other) {
+            try_emplace(value.first, value.second);
+        }
+    }
+
+    FlatHashMap(FlatHashMap&& other) noexcept : m_hash{other.m_hash}, m_equal{other.m_equal}
+    {
+        swap(other);
+    }
+
+    FlatHashMap& operator=(FlatHashMap other) noexcept
+    {
+        swap(other);
+        return *this;
+    }
+
+    ~FlatHashMap() { Free(); }
+
+    void swap(FlatHashMap& other) noexcept
+    {
+        std::swap(m_slots, other.m_slots);
+        std::swap(m_ctrl, other.m_ctrl);
+        std::swap(m_capacity, other.m_capacity);
+        std::swap(m_size, other.m_size);
+        std::swap(m_growth_left, other.m_growth_left);
+        std::swap(m_hash, other.m_hash);
+        std::swap(m_equal, other.m_equal);
+    }
+
+    iterator begin()
+    {
+        iterator it{MakeIterator(0)};
+        it.SkipFree();
+        return it;
+    }
+    const_iterator begin() const { return const_cast<FlatHashMap&>(*this).begin(); }
+    iterator end() { return MakeIterator(m_capacity); }
+    const_iterator end() const { return const_cast<FlatHashMap&>(*this).end(); }
+
+    size_type size() const { return m_size; }
+    bool empty() const { return m_size == 0; }
+    //! Number of slots
+    size_type capacity() const { return m_capacity; }
+    //! Bytes allocated for the slots and control bytes
+    size_t allocated_memory() const { return m_capacity ? AllocationSize(m_capacity) : 0; }
+
+    iterator find(const Key& key) { return MakeIterator(Find(key, m_hash(key))); }
+    const_iterator find(const Key& key) const { return const_cast<FlatHashMap&>(*this).find(key); }
+    size_type count(const Key& key) const { return find(key) != end(); }
+
+    template <typename... Args>
+    std::pair<iterator, bool> try_emplace(const Key& key, Args&&... args)
+    {
+        const size_t hash{m_hash(key)};
+        size_t i{Find(key, hash)};
+        if (i != m_capacity) return {MakeIterator(i), false};
+        i = PrepareInsert(hash);
+        ::new (m_slots + i) value_type(std::piecewise_construct, std::forward_as_tuple(key), std::forward_as_tuple(std::forward<Args>(args)...));
+        m_ctrl[i] = H2(hash);
+        ++m_size;
+        return {MakeIterator(i), true};
+    }
+
+    template <typename V>
+    std::pair<iterator, bool> emplace(const Key& key, V&& value)
+    {
+        return try_emplace(key, std::forward<V>(value));
+    }
+
+    template <typename... KeyArgs, typename... Args>
+    std::pair<iterator, bool> emplace(std::piecewise_construct_t, std::tuple<KeyArgs...> key_args, std::tuple<Args...> args)
+    {
+        const Key key{std::make_from_tuple<Key>(std::move(key_args))};
+        return std::apply([&](auto&&... a) { return try_emplace(key, std::forward<decltype(a)>(a)...); }, std::move(args));
+    }
+
+    T& operator[](const Key& key) { return try_emplace(key).first->second; }
+
+    iterator erase(const_iterator pos)
+    {
+        const size_t i{static_cast<size_t>(pos.m_slot - m_slots)};
+        m_slots[i].~value_type();
+        --m_size;
+        // A group that still has an empty slot was never full, so no lookup
+        // went past it and the slot can become empty again. Otherwise it must
+        // stay marked, so that lookups of keys further along go on probing.
+        if (Group{m_ctrl + (i & ~(GROUP_WIDTH - 1))}.MatchEmpty()) {
+            m_ctrl[i] = CTRL_EMPTY;
+            ++m_growth_left;
+        } else {
+            m_ctrl[i] = CTRL_DELETED;
+        }
+        iterator next{MakeIterator(i)};
+        next.SkipFree();
+        return next;
+    }
+    iterator erase(iterator pos) { return erase(const_iterator{pos}); }
+
+    size_type erase(const Key& key)
+    {
+        const iterator it{find(key)};
+        if (it == end()) return 0;
+        erase(it);
+        return 1;
+    }
+
+    /** Remove all entries, keeping the slots. */
+    void clear()
+    {
+        if (m_capacity == 0) return;
+        DestroyAll();
+        std::memset(m_ctrl, CTRL_EMPTY, m_capacity);
+        m_size = 0;
+        m_growth_left = MaxLoad(m_capacity);
+    }
+
+    /** Make room for count entries without growing again. */
+    void reserve(size_type count)
+    {
+        if (count == 0) return;
+        size_t capacity{GROUP_WIDTH};
+        while (MaxLoad(capacity) < count) capacity *= 2;
+        if (capacity > m_capacity) Resize(capacity);
+    }
+
+private:
+    value_type* m_slots{nullptr};
+    //! Follows the slots in the same allocation
+    ctrl_t* m_ctrl{nullptr};
+    //! Number of slots: zero, or a power of two and at least GROUP_WIDTH
+    size_t m_capacity{0};
+    size_t m_size{0};
+    //! Insertions into empty slots left before the map must grow
+    size_t m_growth_left{0};
+    Hash m_hash;
+    KeyEqual m_equal;
+
+    static_assert(alignof(value_type) <= __STDCPP_DEFAULT_NEW_ALIGNMENT__);
+
+    static size_t H1(size_t hash) { return hash >> 7; }
+    static ctrl_t H2(size_t hash) { return static_cast<ctrl_t>(hash & 0x7f); }
+    static size_t MaxLoad(size_t capacity) { return capacity - capacity / 8; }
+    //! The slots, the control bytes and the sentinel
+    static size_t AllocationSize(size_t capacity) { return capacity * sizeof(value_type) + capacity + 1; }
+
+    iterator MakeIterator(size_t i)
+    {
+        if (m_capacity == 0) return {EMPTY_CTRL, nullptr};
+        return {m_ctrl + i, m_slots + i};
+    }
+
+    /** The slot holding key, or m_capacity. */
+    size_t Find(const Key& key, size_t hash) const
+    {
+        if (m_capacity == 0) return 0;
+        const size_t mask{m_capacity / GROUP_WIDTH - 1};
+        size_t group{H1(hash) & mask};
+        for (size_t step{1}; step <= mask + 1; ++step) {
+            const Group g{m_ctrl + group * GROUP_WIDTH};
+            for (uint32_t matches{g.Match(H2(hash))}; matches; matches &= matches - 1) {
+                const size_t i{group * GROUP_WIDTH + std::countr_zero(matches)};
+                if (m_equal(m_slots[i].first, key)) return i;
+            }
+            if (g.MatchEmpty()) break;
+            group = (group + step) & mask;
+        }
+        return m_capacity;
+    }
+
+    /** The first empty or deleted slot on the probe sequence of hash. */
+    size_t FindFree(size_t hash) const
+    {
+        const size_t mask{m_capacity / GROUP_WIDTH - 1};
+        size_t group{H1(hash) & mask};
+        for (size_t step{1};; ++step) {
+            if (const uint32_t free{Group{m_ctrl + group * GROUP_WIDTH}.MatchEmptyOrDeleted()}) {
+                return group * GROUP_WIDTH + std::countr_zero(free);
+            }
+            group = (group + step) & mask;
+        }
+    }
+
+    /** Pick the slot for a new entry, growing the map if needed. */
+    size_t PrepareInsert(size_t hash)
+    {
+        size_t i{m_capacity ? FindFree(hash) : 0};
+        if (m_growth_left == 0 && (m_capacity == 0 || m_ctrl[i] != CTRL_DELETED)) {
+            // Drop the deleted slots without growing if they take up most of the room.
+            Resize(m_capacity && m_size <= MaxLoad(m_capacity) / 2 ? m_capacity : std::max(GROUP_WIDTH, m_capacity * 2));
+            i = FindFree(hash);
+        }
+        if (m_ctrl[i] == CTRL_EMPTY) --m_growth_left;
+        return i;
+    }
+
+    void Resize(size_t capacity)
+    {
+        value_type* const old_slots{m_slots};
+        const ctrl_t* const old_ctrl{m_ctrl};
+        const size_t old_capacity{m_capacity};
+
+        m_slots = static_cast<value_type*>(::operator new(AllocationSize(capacity)));
+        m_ctrl = reinterpret_cast<ctrl_t*>(m_slots + capacity);
+        std::memset(m_ctrl, CTRL_EMPTY, capacity);
+        m_ctrl[capacity] = CTRL_SENTINEL;
+        m_capacity = capacity;
+        m_growth_left = MaxLoad(capacity) - m_size;
+
+        for (size_t i{0}; i < old_capacity; ++i) {
+            if (old_ctrl[i] < 0) continue;
+            const size_t hash{m_hash(old_slots[i].first)};
+            const size_t j{FindFree(hash)};
+            ::new (m_slots + j) value_type(std::move(old_slots[i]));
+            m_ctrl[j] = H2(hash);
+            old_slots[i].~value_type();
+        }
+        if (old_capacity) ::operator delete(old_slots);
+    }
+
+    void DestroyAll()
+    {
+        for (size_t i{0}; i < m_capacity; ++i) {
+            if (m_ctrl[i] >= 0) m_slots[i].~value_type();
+        }
+    }
+
+    void Free()
+    {
+        if (m_capacity == 0) return;
+        DestroyAll();
+        ::operator delete(m_slots);
+        m_slots = nullptr;
+        m_ctrl = nullptr;
+        m_capacity = m_size = m_growth_left = 0;
+    }
+};
+
+#endif // REGUS_FLATHASHMAP_H
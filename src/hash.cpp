@@ -10,8 +10,12 @@
 #include <crypto/ethash/include/ethash/progpow.hpp>
 
 #include <bit>
+#include <cassert>
 #include <string>
 
+/** Number of blocks before an epoch boundary at which the next epoch context is prebuilt. */
+static constexpr int EPOCH_PREBUILD_DISTANCE{250};
+
 unsigned int MurmurHash3(unsigned int nHashSeed, Span<const unsigned char> vDataToHash)
 {
     // The following is MurmurHash3 (x86_32), see https://github.com/aappleby/smhasher/blob/master/src/MurmurHash3.cpp
@@ -86,28 +90,55 @@ uint256 SHA256Uint256(const uint256& input)
 
 uint256 ETHash(const CBlockHeader& blockHeader)
 {
-    uint256 nHeaderHash = blockHeader.GetHeaderHash();
-    const auto header_hash = to_hash256(nHeaderHash.GetHex());
-    const auto result = progpow::hash_no_verify(blockHeader.nHeight, header_hash, to_hash256(blockHeader.hashMix.GetHex()), blockHeader.nNonce);
+    const auto header_hash = ToEthashHash256(blockHeader.GetHeaderHash());
+    const auto result = progpow::hash_no_verify(blockHeader.nHeight, header_hash, ToEthashHash256(blockHeader.hashMix), blockHeader.nNonce);
 
-    return uint256S(to_hex(result));
+    return FromEthashHash256(result);
 }
 
-uint256 ETHash(const CBlockHeader& blockHeader, uint256& hashMix)
+std::vector<uint256> ETHashBatch(Span<const CBlockHeader> headers)
 {
-    static ethash::epoch_context_ptr context{nullptr, nullptr};
+    std::vector<ethash::hash256> header_hashes(headers.size());
+    std::vector<ethash::hash256> mixes(headers.size());
+    std::vector<uint64_t> nonces(headers.size());
+    for (size_t i = 0; i < headers.size(); ++i) {
+        header_hashes[i] = ToEthashHash256(headers[i].GetHeaderHash());
+        mixes[i] = ToEthashHash256(headers[i].hashMix);
+        nonces[i] = headers[i].nNonce;
+    }
 
-    const auto epoch_number = ethash::get_epoch_number(blockHeader.nHeight);
+    std::vector<ethash::hash256> results(headers.size());
+    progpow::hash_no_verify_batch(headers.size(), header_hashes.data(), mixes.data(), nonces.data(), results.data());
 
-    if (!context || context->epoch_number != epoch_number)
-        context = ethash::create_epoch_context(epoch_number);
+    std::vector<uint256> hashes;
+    hashes.reserve(headers.size());
+    for (const auto& result : results) {
+        hashes.push_back(FromEthashHash256(result));
+    }
+    return hashes;
+}
 
-    uint256 nHeaderHash = blockHeader.GetHeaderHash();
-    const auto header_hash = to_hash256(nHeaderHash.GetHex());
-    const auto result = progpow::hash(*context, blockHeader.nHeight, header_hash, blockHeader.nNonce);
+uint256 ETHash(const CBlockHeader& blockHeader, uint256& hashMix)
+{
+    const auto epoch_number = ethash::get_epoch_number(blockHeader.nHeight);
+
+    // Build the next epoch's light cache in the background well before the
+    // chain gets there, so that no validation thread stalls on it.
+    if (ethash::epoch_length - blockHeader.nHeight % ethash::epoch_length <= EPOCH_PREBUILD_DISTANCE)
+        ethash::prebuild_epoch_context(epoch_number + 1);
+
+    const auto header_hash = ToEthashHash256(blockHeader.GetHeaderHash());
+    ethash::result result;
+    if (const progpow::epoch_dataset_ptr dataset = progpow::get_epoch_dataset(epoch_number)) {
+        result = progpow::hash(*dataset, blockHeader.nHeight, header_hash, blockHeader.nNonce);
+    } else {
+        const ethash::epoch_context_shared_ptr context = ethash::get_epoch_context(epoch_number);
+        assert(context);
+        result = progpow::hash(*context, blockHeader.nHeight, header_hash, blockHeader.nNonce);
+    }
 
-    hashMix = uint256S(to_hex(result.hashMix));
-    return uint256S(to_hex(result.final_hash));
+    hashMix = FromEthashHash256(result.hashMix);
+    return FromEthashHash256(result.final_hash);
 }
 
 HashWriter TaggedHash(const std::string& tag)
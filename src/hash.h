@@ -18,6 +18,8 @@
 #include <span.h>
 #include <uint256.h>
 
+#include <algorithm>
+#include <iterator>
 #include <string>
 #include <vector>
 
@@ -209,12 +211,32 @@ public:
 /** Single-SHA256 a 32-byte input (represented as uint256). */
 [[nodiscard]] uint256 SHA256Uint256(const uint256& input);
 
+/** Convert a uint256 to the ProgPoW byte order (most significant byte first,
+ * i.e. the same order GetHex() prints). No allocation, no hex round-trip. */
+inline ethash::hash256 ToEthashHash256(const uint256& hash)
+{
+    ethash::hash256 result;
+    std::reverse_copy(hash.begin(), hash.end(), result.bytes);
+    return result;
+}
+
+/** Inverse of ToEthashHash256(). */
+inline uint256 FromEthashHash256(const ethash::hash256& hash)
+{
+    uint256 result;
+    std::reverse_copy(std::begin(hash.bytes), std::end(hash.bytes), result.begin());
+    return result;
+}
+
 /** ETHash hashing function, returns only hash */
 uint256 ETHash(const CBlockHeader& blockHeader);
 
 /** ETHash hashing function, returns the hash and hashMix */
 uint256 ETHash(const CBlockHeader& blockHeader, uint256& hashMix);
 
+/** ETHash(blockHeader) of each header, with the Keccak permutations batched */
+std::vector<uint256> ETHashBatch(Span<const CBlockHeader> headers);
+
 unsigned int MurmurHash3(unsigned int nHashSeed, Span<const unsigned char> vDataToHash);
 
 void BIP32Hash(const ChainCode &chainCode, unsigned int nChild, unsigned char header, const unsigned char data[32], unsigned char output[64]);
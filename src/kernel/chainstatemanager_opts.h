@@ -23,6 +23,19 @@ class CChainParams;
 static constexpr bool DEFAULT_CHECKPOINTS_ENABLED{true};
 static constexpr auto DEFAULT_MAX_TIP_AGE{24h};
 
+/** How much of the ProgPoW mix of new headers that extend a known block is verified in parallel before they are accepted (-headersmixcheck) */
+enum class HeadersMixCheck {
+    NONE,   //!< Only the final hash. The mix is verified when a header is accepted.
+    SAMPLE, //!< Also the mix of a random sample of the headers in each batch.
+    ALL,    //!< Also the mix of every header.
+};
+static constexpr HeadersMixCheck DEFAULT_HEADERS_MIX_CHECK{HeadersMixCheck::SAMPLE};
+/** Number of ProgPoW epochs past the tip's whose light caches are built ahead of validation (-powepochlookahead) */
+static constexpr int DEFAULT_POW_EPOCH_LOOKAHEAD{2};
+static constexpr int MAX_POW_EPOCH_LOOKAHEAD{8};
+/** Whether the coins spent by blocks about to be connected are read ahead on the -par threads (-utxoprefetch) */
+static constexpr bool DEFAULT_UTXO_PREFETCH{true};
+
 namespace kernel {
 
 /**
@@ -47,6 +60,12 @@ struct ChainstateManagerOpts {
     Notifications& notifications;
     //! Number of script check worker threads. Zero means no parallel verification.
     int worker_threads_num{0};
+    //! How much of the mix of new headers ProcessNewBlockHeaders() verifies in parallel.
+    HeadersMixCheck headers_mix_check{DEFAULT_HEADERS_MIX_CHECK};
+    //! How many epochs ahead of the tip, up to the best header's, light caches are built in the background.
+    int pow_epoch_lookahead{DEFAULT_POW_EPOCH_LOOKAHEAD};
+    //! Whether the BlockPrevalidator also reads the coins spent by the blocks it prefetches.
+    bool utxo_prefetch{DEFAULT_UTXO_PREFETCH};
 };
 
 } // namespace kernel
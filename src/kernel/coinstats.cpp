@@ -191,4 +191,26 @@ static void FinalizeHash(MuHash3072& muhash, CCoinsStats& stats)
 }
 static void FinalizeHash(std::nullptr_t, CCoinsStats& stats) {}
 
+bool SerializedCoinsHasher::Add(const COutPoint& outpoint, const Coin& coin)
+{
+    if (m_txid && outpoint.hash != *m_txid) {
+        if (outpoint.hash < *m_txid) return false;
+        ApplyOutputs();
+    }
+    m_txid = outpoint.hash;
+    return m_outputs.try_emplace(outpoint.n, coin).second;
+}
+
+void SerializedCoinsHasher::ApplyOutputs()
+{
+    if (!m_outputs.empty()) ApplyHash(m_hasher, *m_txid, m_outputs);
+    m_outputs.clear();
+}
+
+uint256 SerializedCoinsHasher::Finalize()
+{
+    ApplyOutputs();
+    return m_hasher.GetHash();
+}
+
 } // namespace kernel
@@ -6,18 +6,20 @@
 #ifndef REGUS_KERNEL_COINSTATS_H
 #define REGUS_KERNEL_COINSTATS_H
 
+#include <coins.h>
 #include <consensus/amount.h>
 #include <crypto/muhash.h>
+#include <hash.h>
+#include <primitives/transaction.h>
 #include <streams.h>
 #include <uint256.h>
 
 #include <cstdint>
 #include <functional>
+#include <map>
 #include <optional>
 
 class CCoinsView;
-class Coin;
-class COutPoint;
 class CScript;
 namespace node {
 class BlockManager;
@@ -78,6 +80,31 @@ void ApplyCoinHash(MuHash3072& muhash, const COutPoint& outpoint, const Coin& co
 void RemoveCoinHash(MuHash3072& muhash, const COutPoint& outpoint, const Coin& coin);
 
 std::optional<CCoinsStats> ComputeUTXOStats(CoinStatsHashType hash_type, CCoinsView* view, node::BlockManager& blockman, const std::function<void()>& interruption_point = {});
+
+/**
+ * Computes the HASH_SERIALIZED commitment of a stream of coins, as
+ * ComputeUTXOStats() would for a coins database holding exactly those coins.
+ *
+ * This lets a UTXO snapshot be hashed while it is written or read instead of
+ * in a separate pass over the database. The coins must arrive in database
+ * order, i.e. grouped by ascending txid; Add() returns false for a coin that
+ * breaks that order or repeats an outpoint, after which the result no longer
+ * matches the database and the caller has to fall back to ComputeUTXOStats().
+ */
+class SerializedCoinsHasher
+{
+public:
+    [[nodiscard]] bool Add(const COutPoint& outpoint, const Coin& coin);
+    //! Return the commitment over all coins added so far. May only be called once.
+    uint256 Finalize();
+
+private:
+    void ApplyOutputs();
+
+    HashWriter m_hasher{};
+    std::optional<Txid> m_txid;
+    std::map<uint32_t, Coin> m_outputs;
+};
 } // namespace kernel
 
 #endif // REGUS_KERNEL_COINSTATS_H
@@ -5,6 +5,8 @@
 
 #include <kernel/context.h>
 
+#include <crypto/ethash/include/ethash/keccak.hpp>
+#include <crypto/ethash/include/ethash/progpow.hpp>
 #include <crypto/sha256.h>
 #include <key.h>
 #include <logging.h>
@@ -19,6 +21,8 @@ Context::Context()
 {
     std::string sha256_algo = SHA256AutoDetect();
     LogPrintf("Using the '%s' SHA256 implementation\n", sha256_algo);
+    LogPrintf("Using the '%s' ProgPoW mix implementation\n", progpow::select_mix_implementation());
+    LogPrintf("Using the '%s' Keccak implementation for ProgPoW\n", ethash::select_keccak_implementation());
     RandomInit();
     ECC_Start();
 }
@@ -6,6 +6,7 @@
 #ifndef REGUS_KERNEL_VALIDATION_CACHE_SIZES_H
 #define REGUS_KERNEL_VALIDATION_CACHE_SIZES_H
 
+#include <pow.h>
 #include <script/sigcache.h>
 
 #include <cstddef>
@@ -15,6 +16,7 @@ namespace kernel {
 struct ValidationCacheSizes {
     size_t signature_cache_bytes{DEFAULT_MAX_SIG_CACHE_BYTES / 2};
     size_t script_execution_cache_bytes{DEFAULT_MAX_SIG_CACHE_BYTES / 2};
+    size_t pow_cache_bytes{DEFAULT_MAX_POW_CACHE_BYTES};
 };
 }
 
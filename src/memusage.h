@@ -6,6 +6,7 @@
 #ifndef REGUS_MEMUSAGE_H
 #define REGUS_MEMUSAGE_H
 
+#include <flathashmap.h>
 #include <indirectmap.h>
 #include <prevector.h>
 #include <support/allocators/pool.h>
@@ -203,6 +204,12 @@ static inline size_t DynamicUsage(const std::unordered_map<Key,
     return usage_resource + usage_chunks + MallocUsage(sizeof(void*) * m.bucket_count());
 }
 
+template <typename Key, typename T, typename Hash, typename KeyEqual>
+static inline size_t DynamicUsage(const FlatHashMap<Key, T, Hash, KeyEqual>& m)
+{
+    return MallocUsage(m.allocated_memory());
+}
+
 } // namespace memusage
 
 #endif // REGUS_MEMUSAGE_H
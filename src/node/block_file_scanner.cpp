@@ -0,0 +1,260 @@
+// Copyright (c) 2024 The Regus Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <node/block_file_scanner.h>
+
+#include <consensus/consensus.h>
+#include <consensus/validation.h>
+#include <kernel/chainparams.h>
+#include <kernel/messagestartchars.h>
+#include <logging.h>
+#include <primitives/block.h>
+#include <serialize.h>
+#include <streams.h>
+#include <tinyformat.h>
+#include <util/threadnames.h>
+#include <validation.h>
+
+#include <exception>
+#include <stdexcept>
+
+namespace node {
+BlockFileScanner::BlockFileScanner(const CChainParams& params, std::vector<fs::path> files, int worker_threads_num)
+    : m_params{params}, m_files{std::move(files)}
+{
+    m_worker_threads.reserve(worker_threads_num);
+    for (int n = 0; n < worker_threads_num; ++n) {
+        m_worker_threads.emplace_back([this, n]() {
+            util::ThreadRename(strprintf("blkscan.%i", n));
+            ThreadScan();
+        });
+    }
+}
+
+BlockFileScanner::~BlockFileScanner()
+{
+    WITH_LOCK(m_mutex, m_stop = true);
+    m_cv.notify_all();
+    for (std::thread& t : m_worker_threads) {
+        t.join();
+    }
+}
+
+bool BlockFileScanner::CanStartScan() const
+{
+    // The file being imported is always scanned; files ahead of it only while
+    // there is room for their blocks.
+    return m_next_scan < m_files.size() && (m_next_scan <= m_importing || m_bytes < MAX_SCANNED_BLOCK_BYTES);
+}
+
+void BlockFileScanner::ThreadScan()
+{
+    WAIT_LOCK(m_mutex, lock);
+    while (!m_stop) {
+        // The importing thread waits for checks, so they come first, unless
+        // the file it waits for was not started yet.
+        if (!(m_next_scan == m_importing && CanStartScan()) && CheckBatch(lock)) continue;
+        if (!CanStartScan()) {
+            m_cv.wait(lock);
+            continue;
+        }
+        const size_t n{m_next_scan++};
+        m_scanning[n];
+        REVERSE_LOCK(lock);
+        ScanFile(n);
+    }
+}
+
+void BlockFileScanner::ScanFile(size_t n)
+{
+    AutoFile file_in{fsbridge::fopen(m_files[n], "rb")};
+    WITH_LOCK(m_mutex, m_scanning[n].opened = !file_in.IsNull());
+    m_cv.notify_all();
+
+    std::optional<std::string> error;
+    if (!file_in.IsNull()) {
+        // This follows the scan in ChainstateManager::LoadExternalBlockFile(),
+        // so that the same blocks are found, except that every block is read.
+        try {
+            // Large blocks are queued as soon as there is a megabyte of them.
+            static constexpr size_t MAX_BATCH_BYTES{1 << 20};
+            std::vector<std::shared_ptr<Entry>> batch;
+            size_t batch_bytes{0};
+            BufferedFile blkdat{file_in, 2 * MAX_BLOCK_SERIALIZED_SIZE, MAX_BLOCK_SERIALIZED_SIZE + 8};
+            uint64_t nRewind = blkdat.GetPos();
+            while (!blkdat.eof()) {
+                blkdat.SetPos(nRewind);
+                nRewind++; // start one byte further next time, in case of failure
+                blkdat.SetLimit(); // remove former limit
+                unsigned int nSize = 0;
+                try {
+                    // locate a header
+                    MessageStartChars buf;
+                    blkdat.FindByte(std::byte(m_params.MessageStart()[0]));
+                    nRewind = blkdat.GetPos() + 1;
+                    blkdat >> buf;
+                    if (buf != m_params.MessageStart()) {
+                        continue;
+                    }
+                    // read size
+                    blkdat >> nSize;
+                    if (nSize < 80 || nSize > MAX_BLOCK_SERIALIZED_SIZE)
+                        continue;
+                } catch (const std::exception&) {
+                    // no valid block header found; don't complain
+                    // (this happens at the end of every blk.dat file)
+                    break;
+                }
+                try {
+                    const uint64_t nBlockPos{blkdat.GetPos()};
+                    blkdat.SetLimit(nBlockPos + nSize);
+                    CBlockHeader header;
+                    blkdat >> header;
+                    nRewind = nBlockPos + nSize;
+                    blkdat.SetPos(nBlockPos);
+                    auto pblock{std::make_shared<CBlock>()};
+                    blkdat >> TX_WITH_WITNESS(*pblock);
+                    nRewind = blkdat.GetPos();
+                    batch.push_back(std::make_shared<Entry>(Entry{.block = std::move(pblock), .pos = static_cast<unsigned int>(nBlockPos), .size = nSize}));
+                    batch_bytes += nSize;
+                    if (batch.size() >= SCANNED_BLOCKS_BATCH || batch_bytes >= MAX_BATCH_BYTES) {
+                        if (!Push(n, batch)) break;
+                        batch_bytes = 0;
+                    }
+                } catch (const std::exception& e) {
+                    LogPrint(BCLog::REINDEX, "LoadExternalBlockFile: unexpected data at file offset 0x%x - %s. continuing\n", (nRewind - 1), e.what());
+                }
+            }
+            if (!batch.empty()) Push(n, batch);
+        } catch (const std::runtime_error& e) {
+            error = std::string("System error: ") + e.what();
+        }
+    }
+
+    {
+        LOCK(m_mutex);
+        File& file{m_scanning.at(n)};
+        if (file.abandoned) {
+            Drop(file);
+            m_scanning.erase(n);
+        } else {
+            file.scanned = true;
+            file.error = std::move(error);
+        }
+    }
+    m_cv.notify_all();
+}
+
+bool BlockFileScanner::Push(size_t n, std::vector<std::shared_ptr<Entry>>& batch)
+{
+    {
+        WAIT_LOCK(m_mutex, lock);
+        while (true) {
+            if (m_stop || m_scanning.at(n).abandoned) return false;
+            // The file being imported gets past a full budget when the
+            // importing thread is out of its blocks, so that it never waits
+            // for blocks of later files to be imported.
+            if (m_bytes < MAX_SCANNED_BLOCK_BYTES || (n <= m_importing && m_scanning.at(n).blocks.empty())) break;
+            if (!CheckBatch(lock)) m_cv.wait(lock);
+        }
+        File& file{m_scanning.at(n)};
+        for (auto& entry : batch) {
+            m_bytes += entry->size;
+            file.blocks.push_back(entry);
+            m_unchecked.push_back(std::move(entry));
+        }
+    }
+    batch.clear();
+    m_cv.notify_all();
+    return true;
+}
+
+bool BlockFileScanner::CheckBatch(UniqueLock<Mutex>& lock)
+{
+    std::vector<std::shared_ptr<Entry>> entries;
+    while (!m_unchecked.empty() && entries.size() < SCANNED_BLOCKS_BATCH) {
+        // Blocks dropped by Finish() are skipped.
+        if (m_unchecked.front()->block) entries.push_back(m_unchecked.front());
+        m_unchecked.pop_front();
+    }
+    if (entries.empty()) return false;
+    std::vector<std::shared_ptr<CBlock>> blocks;
+    blocks.reserve(entries.size());
+    for (const auto& entry : entries) blocks.push_back(entry->block);
+    {
+        REVERSE_LOCK(lock);
+        // A block that fails is left for AcceptBlock() to reject.
+        for (const auto& block : blocks) {
+            block->CacheHashes();
+            BlockValidationState state;
+            CheckBlock(*block, state, m_params.GetConsensus());
+        }
+    }
+    for (const auto& entry : entries) entry->checked = true;
+    m_cv.notify_all();
+    return true;
+}
+
+void BlockFileScanner::Drop(File& file)
+{
+    for (const auto& entry : file.blocks) {
+        m_bytes -= entry->size;
+        entry->block.reset();
+    }
+    file.blocks.clear();
+}
+
+bool BlockFileScanner::Open(size_t n)
+{
+    WAIT_LOCK(m_mutex, lock);
+    m_importing = n;
+    m_cv.notify_all();
+    m_cv.wait(lock, [&]() EXCLUSIVE_LOCKS_REQUIRED(m_mutex) {
+        const auto it{m_scanning.find(n)};
+        return it != m_scanning.end() && it->second.opened.has_value();
+    });
+    return *m_scanning.at(n).opened;
+}
+
+std::optional<BlockFileScanner::Block> BlockFileScanner::Next(size_t n)
+{
+    std::shared_ptr<Entry> entry;
+    bool notify;
+    {
+        WAIT_LOCK(m_mutex, lock);
+        File& file{m_scanning.at(n)};
+        while (true) {
+            if (!file.blocks.empty() && file.blocks.front()->checked) break;
+            if (file.blocks.empty() && file.scanned) return std::nullopt;
+            // Help with the checks rather than wait for them.
+            if (!CheckBatch(lock)) m_cv.wait(lock);
+        }
+        entry = std::move(file.blocks.front());
+        file.blocks.pop_front();
+        // Only wake the workers once there is room to scan again.
+        notify = file.blocks.empty() || (m_bytes >= MAX_SCANNED_BLOCK_BYTES && m_bytes - entry->size < MAX_SCANNED_BLOCK_BYTES);
+        m_bytes -= entry->size;
+    }
+    if (notify) m_cv.notify_all();
+    return Block{.block = std::move(entry->block), .pos = entry->pos, .size = entry->size};
+}
+
+std::optional<std::string> BlockFileScanner::Finish(size_t n)
+{
+    std::optional<std::string> error;
+    {
+        LOCK(m_mutex);
+        File& file{m_scanning.at(n)};
+        error = file.error;
+        Drop(file);
+        if (file.scanned) {
+            m_scanning.erase(n);
+        } else {
+            file.abandoned = true;
+        }
+    }
+    m_cv.notify_all();
+    return error;
+}
+} // namespace node
@@ -0,0 +1,131 @@
+// Copyright (c) 2024 The Regus Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef REGUS_NODE_BLOCK_FILE_SCANNER_H
+#define REGUS_NODE_BLOCK_FILE_SCANNER_H
+
+#include <sync.h>
+#include <threadsafety.h>
+#include <util/fs.h>
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <map>
+#include <memory>
+#include <optional>
+#include <string>
+#include <thread>
+#include <vector>
+
+class CBlock;
+class CChainParams;
+
+namespace node {
+/** Serialized size of the blocks a BlockFileScanner may hold ahead of the file being imported */
+static constexpr size_t MAX_SCANNED_BLOCK_BYTES{64 << 20};
+/** Number of blocks a BlockFileScanner worker queues or checks at once, to keep the locking off small blocks */
+static constexpr size_t SCANNED_BLOCKS_BATCH{32};
+
+/**
+ * Reads the blocks of a sequence of block files on worker threads, for
+ * ChainstateManager::LoadExternalBlockFiles() to accept them in file order.
+ *
+ * A worker scans a file the way LoadExternalBlockFile() does: it searches for
+ * the network magic and deserializes the block that follows it, skipping data
+ * that does not deserialize. Several files are scanned at once, each by one
+ * worker. Every block found is then hashed and run through the context-free
+ * checks of CheckBlock() by whichever worker (or the importing thread) is free,
+ * so that AcceptBlock() finds the hashes cached and CheckBlock() returns
+ * immediately for blocks that passed. Blocks that fail are handed out
+ * unchecked, and AcceptBlock() rejects them as before.
+ *
+ * Blocks are only read while fewer than MAX_SCANNED_BLOCK_BYTES are held,
+ * except for the file being imported once the importing thread ran out of its
+ * blocks. A worker that has to wait for room checks blocks in the meantime.
+ * Blocks are queued and checked SCANNED_BLOCKS_BATCH at a time.
+ */
+class BlockFileScanner
+{
+public:
+    //! A block found in a file
+    struct Block {
+        std::shared_ptr<CBlock> block;
+        //! Offset of the block's serialization in the file
+        unsigned int pos;
+        //! Size of the block's serialization
+        unsigned int size;
+    };
+
+    BlockFileScanner(const CChainParams& params, std::vector<fs::path> files, int worker_threads_num);
+    ~BlockFileScanner();
+
+    BlockFileScanner(const BlockFileScanner&) = delete;
+    BlockFileScanner& operator=(const BlockFileScanner&) = delete;
+
+    /** Wait until file n has been opened. Returns false if it could not be. */
+    bool Open(size_t n) EXCLUSIVE_LOCKS_REQUIRED(!m_mutex);
+
+    /**
+     * Wait for the next block of file n, in the order of the file, until it is
+     * checked. Returns nullopt once all blocks of the file have been returned.
+     * Files must be imported in order, starting with Open().
+     */
+    std::optional<Block> Next(size_t n) EXCLUSIVE_LOCKS_REQUIRED(!m_mutex);
+
+    /**
+     * Stop importing file n, dropping any blocks of it that were not returned
+     * yet. Returns the error that stopped the file from being scanned, if any.
+     */
+    std::optional<std::string> Finish(size_t n) EXCLUSIVE_LOCKS_REQUIRED(!m_mutex);
+
+private:
+    struct Entry {
+        std::shared_ptr<CBlock> block;
+        unsigned int pos;
+        unsigned int size;
+        bool checked{false};
+    };
+    struct File {
+        //! Unset until a worker tried to open the file
+        std::optional<bool> opened;
+        bool scanned{false};
+        //! Set by Finish() while the file is still being scanned
+        bool abandoned{false};
+        std::optional<std::string> error;
+        std::deque<std::shared_ptr<Entry>> blocks;
+    };
+
+    void ThreadScan() EXCLUSIVE_LOCKS_REQUIRED(!m_mutex);
+    void ScanFile(size_t n) EXCLUSIVE_LOCKS_REQUIRED(!m_mutex);
+    /** Queue blocks of file n once there is room. Returns false if the file is not to be scanned further. */
+    bool Push(size_t n, std::vector<std::shared_ptr<Entry>>& batch) EXCLUSIVE_LOCKS_REQUIRED(!m_mutex);
+    /** Check the oldest unchecked blocks, if there are any, releasing the lock meanwhile. */
+    bool CheckBatch(UniqueLock<Mutex>& lock) EXCLUSIVE_LOCKS_REQUIRED(m_mutex);
+    /** Drop the blocks of a file from the scanned bytes */
+    void Drop(File& file) EXCLUSIVE_LOCKS_REQUIRED(m_mutex);
+    bool CanStartScan() const EXCLUSIVE_LOCKS_REQUIRED(m_mutex);
+
+    const CChainParams& m_params;
+    const std::vector<fs::path> m_files;
+
+    Mutex m_mutex;
+    std::condition_variable m_cv;
+    std::vector<std::thread> m_worker_threads;
+    bool m_stop GUARDED_BY(m_mutex){false};
+    //! Files that are being scanned or imported
+    std::map<size_t, File> m_scanning GUARDED_BY(m_mutex);
+    //! The next file for a worker to scan
+    size_t m_next_scan GUARDED_BY(m_mutex){0};
+    //! The file being imported
+    size_t m_importing GUARDED_BY(m_mutex){0};
+    //! Serialized size of the blocks held
+    size_t m_bytes GUARDED_BY(m_mutex){0};
+    //! Blocks that were not picked up for checking yet, oldest first
+    std::deque<std::shared_ptr<Entry>> m_unchecked GUARDED_BY(m_mutex);
+};
+} // namespace node
+
+#endif // REGUS_NODE_BLOCK_FILE_SCANNER_H
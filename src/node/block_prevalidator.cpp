@@ -0,0 +1,171 @@
+// Copyright (c) 2024 The Regus Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <node/block_prevalidator.h>
+
+#include <consensus/validation.h>
+#include <node/blockstorage.h>
+#include <primitives/block.h>
+#include <tinyformat.h>
+#include <util/threadnames.h>
+#include <validation.h>
+
+namespace node {
+BlockPrevalidator::BlockPrevalidator(const BlockManager& blockman, const Consensus::Params& params, int worker_threads_num)
+    : m_blockman{blockman}, m_params{params}
+{
+    m_worker_threads.reserve(worker_threads_num);
+    for (int n = 0; n < worker_threads_num; ++n) {
+        m_worker_threads.emplace_back([this, n]() {
+            util::ThreadRename(strprintf("blkcheck.%i", n));
+            ThreadPrevalidate();
+        });
+    }
+}
+
+BlockPrevalidator::~BlockPrevalidator()
+{
+    WITH_LOCK(m_mutex, m_stop = true);
+    m_work_cv.notify_all();
+    for (std::thread& t : m_worker_threads) {
+        t.join();
+    }
+}
+
+void BlockPrevalidator::Prefetch(const uint256& hash, const FlatFilePos& pos, std::shared_ptr<CCoinsViewPrefetch::Stage> coins)
+{
+    if (m_worker_threads.empty()) return;
+    {
+        LOCK(m_mutex);
+        if (!m_entries.try_emplace(hash, Entry{.pos = pos, .coins = std::move(coins)}).second) return;
+        m_order.push_back(hash);
+        m_queue.push_back(hash);
+        Evict();
+    }
+    m_work_cv.notify_one();
+}
+
+void BlockPrevalidator::Add(std::shared_ptr<const CBlock> block)
+{
+    LOCK(m_mutex);
+    const uint256 hash{block->GetHash()};
+    const auto [it, inserted]{m_entries.try_emplace(hash, Entry{.done = true})};
+    if (!inserted) return;
+    SetBlock(it->second, std::move(block));
+    m_order.push_back(hash);
+    Evict();
+}
+
+std::shared_ptr<const CBlock> BlockPrevalidator::Take(const uint256& hash)
+{
+    WAIT_LOCK(m_mutex, lock);
+    auto it{m_entries.end()};
+    // Look the block up again after waiting, as it may have been evicted.
+    m_done_cv.wait(lock, [&]() EXCLUSIVE_LOCKS_REQUIRED(m_mutex) {
+        it = m_entries.find(hash);
+        return it == m_entries.end() || it->second.done;
+    });
+    if (it == m_entries.end()) {
+        ++m_stats.misses;
+        return nullptr;
+    }
+    std::shared_ptr<const CBlock> block{it->second.block};
+    SetBlock(it->second, nullptr);
+    m_entries.erase(it);
+    ++(block ? m_stats.hits : m_stats.misses);
+    return block;
+}
+
+BlockPrevalidator::Stats BlockPrevalidator::GetStats() const
+{
+    LOCK(m_mutex);
+    return m_stats;
+}
+
+void BlockPrevalidator::Evict()
+{
+    AssertLockHeld(m_mutex);
+    while (m_entries.size() > MAX_PREVALIDATED_BLOCKS && !m_order.empty()) {
+        auto it{m_entries.find(m_order.front())};
+        if (it != m_entries.end()) {
+            // Blocks still being checked are about to be taken.
+            if (!it->second.done) break;
+            SetBlock(it->second, nullptr);
+            m_entries.erase(it);
+        }
+        m_order.pop_front();
+    }
+    // Forget blocks that were taken already.
+    while (!m_order.empty() && !m_entries.count(m_order.front())) {
+        m_order.pop_front();
+    }
+}
+
+void BlockPrevalidator::ThreadPrevalidate()
+{
+    WAIT_LOCK(m_mutex, lock);
+    while (true) {
+        m_work_cv.wait(lock, [&]() EXCLUSIVE_LOCKS_REQUIRED(m_mutex) { return m_stop || !m_queue.empty(); });
+        if (m_stop) return;
+        const uint256 hash{m_queue.front()};
+        m_queue.pop_front();
+        const FlatFilePos pos{m_entries.at(hash).pos};
+
+        std::shared_ptr<CBlock> block;
+        {
+            REVERSE_LOCK(lock);
+            block = std::make_shared<CBlock>();
+            BlockValidationState state;
+            if (!m_blockman.ReadBlockFromDisk(*block, pos) || block->GetHash() != hash ||
+                !CheckBlock(*block, state, m_params)) {
+                block.reset();
+            }
+        }
+
+        Entry& entry{m_entries.at(hash)};
+        SetBlock(entry, block);
+        entry.done = true;
+        ++m_stats.prefetched;
+        m_done_cv.notify_all();
+
+        if (block && entry.coins) {
+            std::vector<COutPoint> prevouts{GetPrevouts(*block)};
+            const std::shared_ptr<CCoinsViewPrefetch::Stage> coins{entry.coins};
+            REVERSE_LOCK(lock);
+            coins->Fetch(std::move(prevouts));
+        }
+    }
+}
+
+void BlockPrevalidator::SetBlock(Entry& entry, std::shared_ptr<const CBlock> block)
+{
+    AssertLockHeld(m_mutex);
+    if (entry.block) {
+        for (const CTransactionRef& tx : entry.block->vtx) {
+            auto it{m_txids.find(tx->GetHash())};
+            if (--it->second == 0) m_txids.erase(it);
+        }
+    }
+    entry.block = std::move(block);
+    if (entry.block) {
+        for (const CTransactionRef& tx : entry.block->vtx) {
+            ++m_txids[tx->GetHash()];
+        }
+    }
+}
+
+std::vector<COutPoint> BlockPrevalidator::GetPrevouts(const CBlock& block) const
+{
+    AssertLockHeld(m_mutex);
+    std::vector<COutPoint> prevouts;
+    for (const CTransactionRef& tx : block.vtx) {
+        if (tx->IsCoinBase()) continue;
+        for (const CTxIn& txin : tx->vin) {
+            // Outputs of blocks in the pipeline are not in the database yet.
+            if (!m_txids.count(txin.prevout.hash)) prevouts.push_back(txin.prevout);
+        }
+    }
+    return prevouts;
+}
+} // namespace node
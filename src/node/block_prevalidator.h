@@ -0,0 +1,131 @@
+// Copyright (c) 2024 The Regus Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef REGUS_NODE_BLOCK_PREVALIDATOR_H
+#define REGUS_NODE_BLOCK_PREVALIDATOR_H
+
+#include <flatfile.h>
+#include <sync.h>
+#include <threadsafety.h>
+#include <txdb.h>
+#include <uint256.h>
+#include <util/hasher.h>
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <map>
+#include <memory>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+class CBlock;
+namespace Consensus {
+struct Params;
+} // namespace Consensus
+
+namespace node {
+class BlockManager;
+
+/** Maximum number of blocks held by the BlockPrevalidator */
+static constexpr size_t MAX_PREVALIDATED_BLOCKS{64};
+
+/**
+ * Runs the context-free checks of CheckBlock() (proof of work, merkle root
+ * and transaction sanity) ahead of ConnectBlock(), so that connecting a
+ * block under cs_main only does UTXO and script work.
+ *
+ * Blocks enter the pipeline in two ways:
+ * - Prefetch() reads a block that is stored on disk and checks it on a worker
+ *   thread. ActivateBestChainStep() prefetches the blocks it is about to
+ *   connect, which during IBD and -reindex-chainstate were written to disk
+ *   out of order or long before. The worker then also reads the coins the
+ *   block spends into the chainstate's CCoinsViewPrefetch, skipping those
+ *   created by blocks in the pipeline, so that ConnectBlock() finds them
+ *   without a database read even when the coins cache is cold.
+ * - Add() keeps a block that was already checked when it was received, in
+ *   case it cannot be connected right away.
+ *
+ * ConnectTip() then Take()s the block instead of reading it from disk. A
+ * checked block has CBlock::fChecked set, which makes CheckBlock() return
+ * immediately. Blocks that fail to load or check are not handed out, so
+ * ConnectTip() falls back to reading and checking them itself and reports
+ * the failure as before.
+ *
+ * At most MAX_PREVALIDATED_BLOCKS blocks are held; the oldest checked ones
+ * are dropped first.
+ */
+class BlockPrevalidator
+{
+public:
+    struct Stats {
+        //! Blocks handed to ConnectTip()
+        uint64_t hits{0};
+        //! Blocks ConnectTip() had to read from disk
+        uint64_t misses{0};
+        //! Blocks read and checked on the worker threads
+        uint64_t prefetched{0};
+    };
+
+    BlockPrevalidator(const BlockManager& blockman, const Consensus::Params& params, int worker_threads_num);
+    ~BlockPrevalidator();
+
+    BlockPrevalidator(const BlockPrevalidator&) = delete;
+    BlockPrevalidator& operator=(const BlockPrevalidator&) = delete;
+
+    /** Read the block at pos and check it on a worker thread, and then read
+     * the coins it spends into coins if set. A no-op without worker threads. */
+    void Prefetch(const uint256& hash, const FlatFilePos& pos,
+                  std::shared_ptr<CCoinsViewPrefetch::Stage> coins = nullptr) EXCLUSIVE_LOCKS_REQUIRED(!m_mutex);
+
+    /** Keep a block that CheckBlock() already accepted. */
+    void Add(std::shared_ptr<const CBlock> block) EXCLUSIVE_LOCKS_REQUIRED(!m_mutex);
+
+    /**
+     * Remove a block from the pipeline, waiting for its checks if they are
+     * still running. Returns null if the block is unknown or did not pass.
+     */
+    std::shared_ptr<const CBlock> Take(const uint256& hash) EXCLUSIVE_LOCKS_REQUIRED(!m_mutex);
+
+    Stats GetStats() const EXCLUSIVE_LOCKS_REQUIRED(!m_mutex);
+
+private:
+    struct Entry {
+        //! Null until the block is checked, and if it did not pass
+        std::shared_ptr<const CBlock> block{};
+        FlatFilePos pos{};
+        std::shared_ptr<CCoinsViewPrefetch::Stage> coins{};
+        bool done{false};
+    };
+
+    void ThreadPrevalidate() EXCLUSIVE_LOCKS_REQUIRED(!m_mutex);
+    void Evict() EXCLUSIVE_LOCKS_REQUIRED(m_mutex);
+    /** Set the block of an entry, or drop the entry's block, keeping m_txids in sync. */
+    void SetBlock(Entry& entry, std::shared_ptr<const CBlock> block) EXCLUSIVE_LOCKS_REQUIRED(m_mutex);
+    /** The coins the block spends that are not created by blocks in the pipeline */
+    std::vector<COutPoint> GetPrevouts(const CBlock& block) const EXCLUSIVE_LOCKS_REQUIRED(m_mutex);
+
+    const BlockManager& m_blockman;
+    const Consensus::Params& m_params;
+
+    mutable Mutex m_mutex;
+    //! Workers wait for blocks to prefetch
+    std::condition_variable m_work_cv;
+    //! Take() waits for a block being checked
+    std::condition_variable m_done_cv;
+    std::vector<std::thread> m_worker_threads;
+    bool m_stop GUARDED_BY(m_mutex){false};
+    std::map<uint256, Entry> m_entries GUARDED_BY(m_mutex);
+    //! Blocks in the order they entered the pipeline, for eviction
+    std::deque<uint256> m_order GUARDED_BY(m_mutex);
+    //! Prefetched blocks not yet picked up by a worker, oldest first
+    std::deque<uint256> m_queue GUARDED_BY(m_mutex);
+    //! Transactions of the blocks held, with the number of blocks holding each
+    std::unordered_map<uint256, int, SaltedTxidHasher> m_txids GUARDED_BY(m_mutex);
+    Stats m_stats GUARDED_BY(m_mutex);
+};
+} // namespace node
+
+#endif // REGUS_NODE_BLOCK_PREVALIDATOR_H
@@ -1042,6 +1042,10 @@ bool BlockManager::ReadBlockFromDisk(CBlock& block, const FlatFilePos& pos) cons
         return error("%s: Deserialize or I/O error - %s at %s", __func__, e.what(), pos.ToString());
     }
 
+    // Callers compare the hash to the index and hand the block on to
+    // validation; compute the ETHash only once.
+    block.CacheHashes();
+
     // Check the header
     if (!CheckProofOfWork(block.GetHash(), block.nBits, GetConsensus())) {
         return error("ReadBlockFromDisk: Errors in block header at %s", pos.ToString());
@@ -1151,26 +1155,18 @@ void ImportBlocks(ChainstateManager& chainman, std::vector<fs::path> vImportFile
 
         // -reindex
         if (fReindex) {
-            int nFile = 0;
-            // Map of disk positions for blocks with unknown parent (only used for reindex);
-            // parent hash -> child disk position, multiple children can have the same parent.
-            std::multimap<uint256, FlatFilePos> blocks_with_unknown_parent;
+            std::vector<fs::path> block_files;
             while (true) {
-                FlatFilePos pos(nFile, 0);
-                if (!fs::exists(chainman.m_blockman.GetBlockPosFilename(pos))) {
+                fs::path path{chainman.m_blockman.GetBlockPosFilename(FlatFilePos(block_files.size(), 0))};
+                if (!fs::exists(path)) {
                     break; // No block files left to reindex
                 }
-                AutoFile file{chainman.m_blockman.OpenBlockFile(pos, true)};
-                if (file.IsNull()) {
-                    break; // This error is logged in OpenBlockFile
-                }
-                LogPrintf("Reindexing block file blk%05u.dat...\n", (unsigned int)nFile);
-                chainman.LoadExternalBlockFile(file, &pos, &blocks_with_unknown_parent);
-                if (chainman.m_interrupt) {
-                    LogPrintf("Interrupt requested. Exit %s\n", __func__);
-                    return;
-                }
-                nFile++;
+                block_files.push_back(std::move(path));
+            }
+            chainman.LoadExternalBlockFiles(block_files, /*reindex=*/true);
+            if (chainman.m_interrupt) {
+                LogPrintf("Interrupt requested. Exit %s\n", __func__);
+                return;
             }
             WITH_LOCK(::cs_main, chainman.m_blockman.m_block_tree_db->WriteReindexing(false));
             fReindex = false;
@@ -1180,18 +1176,10 @@ void ImportBlocks(ChainstateManager& chainman, std::vector<fs::path> vImportFile
         }
 
         // -loadblock=
-        for (const fs::path& path : vImportFiles) {
-            AutoFile file{fsbridge::fopen(path, "rb")};
-            if (!file.IsNull()) {
-                LogPrintf("Importing blocks file %s...\n", fs::PathToString(path));
-                chainman.LoadExternalBlockFile(file);
-                if (chainman.m_interrupt) {
-                    LogPrintf("Interrupt requested. Exit %s\n", __func__);
-                    return;
-                }
-            } else {
-                LogPrintf("Warning: Could not open blocks file %s\n", fs::PathToString(path));
-            }
+        chainman.LoadExternalBlockFiles(vImportFiles, /*reindex=*/false);
+        if (chainman.m_interrupt) {
+            LogPrintf("Interrupt requested. Exit %s\n", __func__);
+            return;
         }
 
         // scan for better chains in the block chain database, that are not yet connected in the active best chain
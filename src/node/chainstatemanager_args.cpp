@@ -40,6 +40,24 @@ util::Result<void> ApplyArgsManOptions(const ArgsManager& args, ChainstateManage
 
     if (auto value{args.GetIntArg("-maxtipage")}) opts.max_tip_age = std::chrono::seconds{*value};
 
+    if (auto value{args.GetArg("-headersmixcheck")}) {
+        if (*value == "none") {
+            opts.headers_mix_check = HeadersMixCheck::NONE;
+        } else if (*value == "sample") {
+            opts.headers_mix_check = HeadersMixCheck::SAMPLE;
+        } else if (*value == "all") {
+            opts.headers_mix_check = HeadersMixCheck::ALL;
+        } else {
+            return util::Error{strprintf(_("Invalid value for -headersmixcheck: '%s' (must be none, sample or all)"), *value)};
+        }
+    }
+
+    if (auto value{args.GetIntArg("-powepochlookahead")}) {
+        opts.pow_epoch_lookahead = std::clamp<int64_t>(*value, 0, MAX_POW_EPOCH_LOOKAHEAD);
+    }
+
+    if (auto value{args.GetBoolArg("-utxoprefetch")}) opts.utxo_prefetch = *value;
+
     ReadDatabaseArgs(args, opts.block_tree_db);
     ReadDatabaseArgs(args, opts.coins_db);
     ReadCoinsViewArgs(args, opts.coins_view);
@@ -13,5 +13,6 @@ void ReadCoinsViewArgs(const ArgsManager& args, CoinsViewOptions& options)
 {
     if (auto value = args.GetIntArg("-dbbatchsize")) options.batch_write_bytes = *value;
     if (auto value = args.GetIntArg("-dbcrashratio")) options.simulate_crash_ratio = *value;
+    if (auto value = args.GetBoolArg("-backgroundflush")) options.background_flush = *value;
 }
 } // namespace node
@@ -13,6 +13,7 @@
 #include <net_processing.h>
 #include <netgroup.h>
 #include <node/kernel_notifications.h>
+#include <node/template_builder.h>
 #include <policy/fees.h>
 #include <scheduler.h>
 #include <txmempool.h>
@@ -34,6 +34,7 @@ class WalletLoader;
 } // namespace interfaces
 
 namespace node {
+class BlockTemplateBuilder;
 class KernelNotifications;
 
 //! NodeContext struct containing references to chain state and connection
@@ -72,6 +73,7 @@ struct NodeContext {
     std::unique_ptr<CScheduler> scheduler;
     std::function<void()> rpc_interruption_point = [] {};
     std::unique_ptr<KernelNotifications> notifications;
+    std::unique_ptr<BlockTemplateBuilder> template_builder;
     std::atomic<int> exit_status{EXIT_SUCCESS};
 
     //! Declare default constructor and destructor that are not inline, so code
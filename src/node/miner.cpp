@@ -6,6 +6,7 @@
 
 #include <node/miner.h>
 
+#include <arith_uint256.h>
 #include <chain.h>
 #include <chainparams.h>
 #include <coins.h>
@@ -15,18 +16,25 @@
 #include <consensus/merkle.h>
 #include <consensus/tx_verify.h>
 #include <consensus/validation.h>
+#include <crypto/ethash/include/ethash/progpow.hpp>
 #include <deploymentstatus.h>
+#include <hash.h>
 #include <logging.h>
 #include <policy/feerate.h>
 #include <policy/policy.h>
 #include <pow.h>
 #include <primitives/transaction.h>
 #include <util/moneystr.h>
+#include <util/signalinterrupt.h>
 #include <util/time.h>
 #include <validation.h>
 
 #include <algorithm>
+#include <atomic>
+#include <limits>
+#include <thread>
 #include <utility>
+#include <vector>
 
 namespace node {
 int64_t UpdateTime(CBlockHeader* pblock, const Consensus::Params& consensusParams, const CBlockIndex* pindexPrev)
@@ -430,4 +438,86 @@ void BlockAssembler::addPackageTxs(const CTxMemPool& mempool, int& nPackagesSele
         nDescendantsUpdated += UpdatePackagesForAdded(mempool, ancestors, mapModifiedTx);
     }
 }
+
+bool SearchProofOfWork(CBlockHeader& header, const Consensus::Params& params, uint64_t& max_tries, int num_threads, const util::SignalInterrupt& interrupt)
+{
+    // Like the serial loop this replaces, the largest nonce itself is never tried.
+    const uint64_t limit{std::min(max_tries, std::numeric_limits<uint64_t>::max() - header.nNonce)};
+
+    bool negative, overflow;
+    arith_uint256 target;
+    target.SetCompact(header.nBits, &negative, &overflow);
+    if (negative || target == 0 || overflow || target > UintToArith256(params.powLimit)) {
+        // No hash can satisfy CheckProofOfWork().
+        header.nNonce += limit;
+        max_tries -= limit;
+        return false;
+    }
+
+    const ethash::hash256 boundary{ToEthashHash256(ArithToUint256(target))};
+    const ethash::hash256 header_hash{ToEthashHash256(header.GetHeaderHash())};
+    const int epoch_number{ethash::get_epoch_number(header.nHeight)};
+    const progpow::epoch_dataset_ptr dataset{progpow::get_epoch_dataset(epoch_number)};
+    const ethash::epoch_context_shared_ptr context{dataset ? nullptr : ethash::get_epoch_context(epoch_number)};
+    assert(dataset || context);
+
+    // Small chunks keep the threads busy until the end and let them notice
+    // interrupts and solutions found by others quickly, even in light mode.
+    static constexpr uint64_t NONCES_PER_CHUNK{4};
+    const uint64_t start_nonce{header.nNonce};
+    std::atomic<uint64_t> next_offset{0};
+    std::atomic<bool> found{false};
+
+    struct Worker {
+        uint64_t tried{0};
+        ethash::search_result solution;
+    };
+    std::vector<Worker> workers(std::max(num_threads, 1));
+    const auto search{[&](Worker& worker) {
+        while (!found.load(std::memory_order_relaxed) && !interrupt) {
+            const uint64_t offset{next_offset.fetch_add(NONCES_PER_CHUNK, std::memory_order_relaxed)};
+            if (offset >= limit) break;
+            const uint64_t count{std::min(NONCES_PER_CHUNK, limit - offset)};
+            const uint64_t nonce{start_nonce + offset};
+            const ethash::search_result result{dataset ?
+                progpow::search(*dataset, header.nHeight, header_hash, boundary, nonce, count) :
+                progpow::search_light(*context, header.nHeight, header_hash, boundary, nonce, count)};
+            if (result.solution_found) {
+                worker.tried += result.nonce - nonce + 1;
+                worker.solution = result;
+                found = true;
+                break;
+            }
+            worker.tried += count;
+        }
+    }};
+
+    std::vector<std::thread> threads;
+    for (size_t i = 1; i < workers.size(); ++i) {
+        threads.emplace_back(search, std::ref(workers[i]));
+    }
+    search(workers[0]);
+    for (auto& thread : threads) thread.join();
+
+    uint64_t tried{0};
+    const ethash::search_result* solution{nullptr};
+    for (const Worker& worker : workers) {
+        tried += worker.tried;
+        if (worker.solution.solution_found && (!solution || worker.solution.nonce < solution->nonce)) {
+            solution = &worker.solution;
+        }
+    }
+    if (!solution) {
+        header.nNonce = start_nonce + tried;
+        max_tries -= tried;
+        return false;
+    }
+    header.nNonce = solution->nonce;
+    header.hashMix = FromEthashHash256(solution->hashMix);
+    // Every chunk handed out is searched to its end or first solution, so all
+    // nonces below the lowest solution were tried. Nonces other threads tried
+    // past it are not counted, as a serial search would not have reached them.
+    max_tries -= solution->nonce - start_nonce;
+    return true;
+}
 } // namespace node
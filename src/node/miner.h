@@ -29,9 +29,16 @@ class Chainstate;
 class ChainstateManager;
 
 namespace Consensus { struct Params; };
+namespace util {
+class SignalInterrupt;
+} // namespace util
 
 namespace node {
 static const bool DEFAULT_PRINTPRIORITY = false;
+/** Default for -minerthreads */
+static const int DEFAULT_MINER_THREADS = 1;
+/** Maximum number of nonce search threads */
+static const int MAX_MINER_THREADS = 256;
 
 struct CBlockTemplate
 {
@@ -200,13 +207,27 @@ private:
     void SortForBlock(const CTxMemPool::setEntries& package, std::vector<CTxMemPool::txiter>& sortedEntries);
 };
 
-int64_t UpdateTime(CBlockHeader* pblock, const Consensus::Params& consensusParams, const CBlockIndex* pindexPrev);
+int64_t UpdateTime(CBlockHeader* pblock, const Consensus::Params& consensusParams, const CBlockIndex* pindexPrev) EXCLUSIVE_LOCKS_REQUIRED(::cs_main);
 
 /** Update an old GenerateCoinbaseCommitment from CreateNewBlock after the block txs have changed */
 void RegenerateCommitments(CBlock& block, ChainstateManager& chainman);
 
 /** Apply -blockmintxfee and -blockmaxweight options from ArgsManager to BlockAssembler options. */
 void ApplyArgsManOptions(const ArgsManager& gArgs, BlockAssembler::Options& options);
+
+/**
+ * Search the nonces of a header for a ProgPoW solution meeting its nBits,
+ * starting at its nNonce, on num_threads threads. The header hash is computed
+ * once and the nonce space is handed out to the threads in small chunks.
+ *
+ * At most max_tries nonces are tried, and none past the largest nonce.
+ * max_tries is reduced by the number of unsuccessful nonces. On success the
+ * lowest solution found is stored in nNonce and hashMix; otherwise nNonce is
+ * left after the last nonce tried.
+ *
+ * @returns whether a solution was found.
+ */
+bool SearchProofOfWork(CBlockHeader& header, const Consensus::Params& params, uint64_t& max_tries, int num_threads, const util::SignalInterrupt& interrupt);
 } // namespace node
 
 #endif // REGUS_NODE_MINER_H
@@ -0,0 +1,323 @@
+// Copyright (c) 2024 The Regus Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <node/progpow_cache.h>
+
+#include <common/args.h>
+#include <crypto/ethash/include/ethash/progpow.hpp>
+#include <crypto/sha256.h>
+#include <logging.h>
+#include <random.h>
+#include <sync.h>
+#include <tinyformat.h>
+#include <util/fs_helpers.h>
+#include <util/strencodings.h>
+#include <util/time.h>
+
+#include <algorithm>
+#include <cstring>
+#include <memory>
+#include <optional>
+#include <utility>
+#include <vector>
+
+#ifndef WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace node {
+namespace {
+constexpr uint8_t EPOCH_FILE_MAGIC[8]{'R', 'G', 'S', 'E', 'P', 'O', 'C', 'H'};
+constexpr uint32_t EPOCH_FILE_VERSION{1};
+
+/** Header of an epoch file. The light cache and the L1 cache follow it
+ * directly, in native byte order; the version field doubles as an endianness
+ * check. */
+struct EpochFileHeader {
+    uint8_t magic[8];
+    uint32_t version;
+    int32_t epoch_number;
+    int32_t light_cache_num_items;
+    uint32_t l1_cache_size;
+    uint8_t checksum[CSHA256::OUTPUT_SIZE]; //!< SHA256 of everything after the header
+    uint8_t reserved[8];
+};
+static_assert(sizeof(EpochFileHeader) == 64, "keeps the light cache 64-byte aligned");
+
+size_t EpochPayloadSize(int light_cache_num_items)
+{
+    return ethash::get_light_cache_size(light_cache_num_items) + progpow::l1_cache_size;
+}
+
+fs::path EpochFilePath(const fs::path& dir, int epoch_number)
+{
+    return dir / fs::u8path(strprintf("epoch-%d.bin", epoch_number));
+}
+
+/** Read-only view of an epoch file, memory mapped where supported. */
+class EpochFileData
+{
+    const unsigned char* m_data{nullptr};
+    size_t m_size{0};
+#ifdef WIN32
+    std::unique_ptr<uint64_t[]> m_buffer;
+#endif
+
+public:
+    explicit EpochFileData(const fs::path& path)
+    {
+#ifndef WIN32
+        const int fd{open(path.c_str(), O_RDONLY | O_CLOEXEC)};
+        if (fd < 0) return;
+        struct stat st;
+        if (fstat(fd, &st) == 0 && st.st_size > 0) {
+            void* base{mmap(nullptr, st.st_size, PROT_READ, MAP_SHARED, fd, 0)};
+            if (base != MAP_FAILED) {
+                m_data = static_cast<const unsigned char*>(base);
+                m_size = st.st_size;
+            }
+        }
+        close(fd);
+#else
+        FILE* file{fsbridge::fopen(path, "rb")};
+        if (!file) return;
+        std::error_code ec;
+        const auto size{fs::file_size(path, ec)};
+        if (!ec && size > 0) {
+            m_buffer.reset(new uint64_t[(size + 7) / 8]);
+            if (std::fread(m_buffer.get(), 1, size, file) == size) {
+                m_data = reinterpret_cast<const unsigned char*>(m_buffer.get());
+                m_size = size;
+            }
+        }
+        std::fclose(file);
+#endif
+    }
+
+    ~EpochFileData()
+    {
+#ifndef WIN32
+        if (m_data) munmap(const_cast<unsigned char*>(m_data), m_size);
+#endif
+    }
+
+    EpochFileData(const EpochFileData&) = delete;
+    EpochFileData& operator=(const EpochFileData&) = delete;
+
+    const unsigned char* data() const { return m_data; }
+    size_t size() const { return m_size; }
+};
+
+/** An epoch context whose caches live in a loaded epoch file. The file must
+ * have been checked to hold the caches of the epoch. */
+struct FileEpochContext {
+    const std::unique_ptr<const EpochFileData> file;
+    const ethash::epoch_context context;
+
+    FileEpochContext(std::unique_ptr<const EpochFileData> file_in, int epoch_number, int light_cache_num_items, int full_dataset_num_items)
+        : file{std::move(file_in)},
+          context{epoch_number, light_cache_num_items,
+                  reinterpret_cast<const ethash::hash512*>(file->data() + sizeof(EpochFileHeader)),
+                  reinterpret_cast<const uint32_t*>(file->data() + sizeof(EpochFileHeader) +
+                                                    ethash::get_light_cache_size(light_cache_num_items)),
+                  full_dataset_num_items} {}
+};
+
+Mutex g_epoch_cache_mutex;
+std::optional<fs::path> g_epoch_cache_dir GUARDED_BY(g_epoch_cache_mutex);
+uint64_t g_epoch_cache_max_bytes GUARDED_BY(g_epoch_cache_mutex){0};
+/** Serializes writes and evictions within this process. */
+Mutex g_epoch_file_write_mutex;
+
+/** Remove the lowest epochs until the files fit within max_bytes. The file
+ * for keep_epoch is never removed. */
+void EvictEpochFiles(const fs::path& dir, uint64_t max_bytes, int keep_epoch) EXCLUSIVE_LOCKS_REQUIRED(g_epoch_file_write_mutex)
+{
+    std::vector<std::pair<int, fs::path>> files;
+    uint64_t total_bytes{0};
+    for (const auto& entry : fs::directory_iterator(dir)) {
+        const std::string name{fs::PathToString(entry.path().filename())};
+        if (name.size() <= 10 || name.rfind("epoch-", 0) != 0 || name.substr(name.size() - 4) != ".bin") continue;
+        const auto epoch{ToIntegral<int>(name.substr(6, name.size() - 10))};
+        if (!epoch) continue;
+        total_bytes += entry.file_size();
+        files.emplace_back(*epoch, entry.path());
+    }
+    std::sort(files.begin(), files.end());
+    for (const auto& [epoch, path] : files) {
+        if (total_bytes <= max_bytes) break;
+        if (epoch == keep_epoch) continue;
+        total_bytes -= fs::file_size(path);
+        fs::remove(path);
+        LogPrint(BCLog::VALIDATION, "Removed ProgPoW epoch %d from the cache directory\n", epoch);
+    }
+}
+
+ethash::epoch_context_shared_ptr LoadOrBuildEpochContext(int epoch_number)
+{
+    std::optional<fs::path> dir;
+    uint64_t max_bytes{0};
+    {
+        LOCK(g_epoch_cache_mutex);
+        dir = g_epoch_cache_dir;
+        max_bytes = g_epoch_cache_max_bytes;
+    }
+
+    if (dir) {
+        try {
+            if (auto context{ReadProgPowEpochFile(*dir, epoch_number)}) return context;
+        } catch (const fs::filesystem_error& e) {
+            LogPrintf("Unable to read ProgPoW epoch cache: %s\n", fsbridge::get_filesystem_error_message(e));
+        }
+    }
+
+    const auto start{SteadyClock::now()};
+    ethash::epoch_context_shared_ptr context{ethash::create_epoch_context(epoch_number)};
+    if (!context) return context;
+    LogPrintf("Built ProgPoW epoch %d light cache in %dms\n", epoch_number, Ticks<std::chrono::milliseconds>(SteadyClock::now() - start));
+
+    if (dir && EpochPayloadSize(context->light_cache_num_items) + sizeof(EpochFileHeader) <= max_bytes) {
+        try {
+            LOCK(g_epoch_file_write_mutex);
+            if (WriteProgPowEpochFile(*dir, *context)) EvictEpochFiles(*dir, max_bytes, epoch_number);
+        } catch (const fs::filesystem_error& e) {
+            LogPrintf("Unable to update ProgPoW epoch cache: %s\n", fsbridge::get_filesystem_error_message(e));
+        }
+    }
+    return context;
+}
+} // namespace
+
+ethash::epoch_context_shared_ptr ReadProgPowEpochFile(const fs::path& dir, int epoch_number)
+{
+    const fs::path path{EpochFilePath(dir, epoch_number)};
+    if (!fs::exists(path)) return nullptr;
+
+    const int light_cache_num_items{ethash::calculate_light_cache_num_items(epoch_number)};
+    const int full_dataset_num_items{ethash::calculate_full_dataset_num_items(epoch_number)};
+    const size_t payload_size{EpochPayloadSize(light_cache_num_items)};
+
+    auto file{std::make_unique<const EpochFileData>(path)};
+    const bool valid{[&] {
+        if (!file->data() || file->size() != sizeof(EpochFileHeader) + payload_size) return false;
+        EpochFileHeader header;
+        std::memcpy(&header, file->data(), sizeof(header));
+        if (std::memcmp(header.magic, EPOCH_FILE_MAGIC, sizeof(EPOCH_FILE_MAGIC)) != 0) return false;
+        if (header.version != EPOCH_FILE_VERSION || header.epoch_number != epoch_number) return false;
+        if (header.light_cache_num_items != light_cache_num_items || header.l1_cache_size != progpow::l1_cache_size) return false;
+        uint8_t checksum[CSHA256::OUTPUT_SIZE];
+        CSHA256().Write(file->data() + sizeof(header), payload_size).Finalize(checksum);
+        return std::memcmp(checksum, header.checksum, sizeof(checksum)) == 0;
+    }()};
+    if (!valid) {
+        LogPrintf("Ignoring invalid ProgPoW epoch cache file %s\n", fs::PathToString(path));
+        file.reset();
+        std::error_code ec;
+        fs::remove(path, ec);
+        return nullptr;
+    }
+
+    auto holder{std::make_shared<FileEpochContext>(std::move(file), epoch_number, light_cache_num_items, full_dataset_num_items)};
+    LogPrint(BCLog::VALIDATION, "Loaded ProgPoW epoch %d from %s\n", epoch_number, fs::PathToString(path));
+    return ethash::epoch_context_shared_ptr{holder, &holder->context};
+}
+
+bool WriteProgPowEpochFile(const fs::path& dir, const ethash::epoch_context& context)
+{
+    const size_t light_cache_size{ethash::get_light_cache_size(context.light_cache_num_items)};
+    const auto* light_cache{reinterpret_cast<const unsigned char*>(context.light_cache)};
+    const auto* l1_cache{reinterpret_cast<const unsigned char*>(context.l1_cache)};
+
+    EpochFileHeader header{};
+    std::memcpy(header.magic, EPOCH_FILE_MAGIC, sizeof(EPOCH_FILE_MAGIC));
+    header.version = EPOCH_FILE_VERSION;
+    header.epoch_number = context.epoch_number;
+    header.light_cache_num_items = context.light_cache_num_items;
+    header.l1_cache_size = progpow::l1_cache_size;
+    CSHA256().Write(light_cache, light_cache_size).Write(l1_cache, progpow::l1_cache_size).Finalize(header.checksum);
+
+    // Write to a uniquely named temporary file first, so that concurrent
+    // writers and readers never observe a partially written epoch file.
+    fs::create_directories(dir);
+    const fs::path path{EpochFilePath(dir, context.epoch_number)};
+    const fs::path tmp_path{dir / fs::u8path(strprintf("epoch-%d.bin.%08x.tmp", context.epoch_number, FastRandomContext().rand32()))};
+    FILE* file{fsbridge::fopen(tmp_path, "wb")};
+    if (!file) {
+        LogPrintf("Unable to create ProgPoW epoch cache file %s\n", fs::PathToString(tmp_path));
+        return false;
+    }
+    bool ok{std::fwrite(&header, sizeof(header), 1, file) == 1 &&
+            std::fwrite(light_cache, 1, light_cache_size, file) == light_cache_size &&
+            std::fwrite(l1_cache, 1, progpow::l1_cache_size, file) == progpow::l1_cache_size};
+    ok = FileCommit(file) && ok;
+    ok = std::fclose(file) == 0 && ok;
+    if (!ok || !RenameOver(tmp_path, path)) {
+        LogPrintf("Unable to write ProgPoW epoch cache file %s\n", fs::PathToString(path));
+        std::error_code ec;
+        fs::remove(tmp_path, ec);
+        return false;
+    }
+    LogPrint(BCLog::VALIDATION, "Wrote ProgPoW epoch %d to %s\n", context.epoch_number, fs::PathToString(path));
+    return true;
+}
+
+void StartProgPowEpochCache(const fs::path& dir, uint64_t max_bytes)
+{
+    {
+        LOCK(g_epoch_cache_mutex);
+        g_epoch_cache_dir = dir;
+        g_epoch_cache_max_bytes = max_bytes;
+    }
+    ethash::set_epoch_context_builder(LoadOrBuildEpochContext);
+}
+
+void StopProgPowEpochCache()
+{
+    LOCK(g_epoch_cache_mutex);
+    g_epoch_cache_dir.reset();
+}
+
+void ApplyProgPowArgs(const ArgsManager& args)
+{
+    ethash::set_huge_pages(args.GetBoolArg("-powhugepages", DEFAULT_POW_HUGE_PAGES));
+
+    const int64_t max_mb{args.GetIntArg("-powepochcache", DEFAULT_POW_EPOCH_CACHE_MB)};
+    if (max_mb > 0) {
+        const fs::path dir{args.GetDataDirNet() / "progpow"};
+        LogPrintf("Using up to %d MiB in %s for ProgPoW epoch caches\n", max_mb, fs::PathToString(dir));
+        StartProgPowEpochCache(dir, uint64_t(max_mb) << 20);
+    } else {
+        StopProgPowEpochCache();
+    }
+    // Go through LoadOrBuildEpochContext() either way, to log the build times.
+    ethash::set_epoch_context_builder(LoadOrBuildEpochContext);
+
+    const int64_t dag_mb{std::max<int64_t>(args.GetIntArg("-powdag", DEFAULT_POW_DAG_MB), 0)};
+    const bool dag_prefill{args.GetBoolArg("-powdagprefill", DEFAULT_POW_DAG_PREFILL)};
+    if (dag_mb > 0) {
+        LogPrintf("Using up to %d MiB for the ProgPoW dataset of the current epoch%s\n", dag_mb, dag_prefill ? ", generated in the background" : "");
+    }
+    progpow::set_dataset_options(uint64_t(dag_mb) << 20, dag_prefill);
+
+    const int64_t item_cache_mb{std::max<int64_t>(args.GetIntArg("-powitemcache", DEFAULT_POW_ITEM_CACHE_MB), 0)};
+    progpow::set_item_cache_size(uint64_t(item_cache_mb) << 20);
+    if (item_cache_mb > 0) {
+        if (progpow::get_item_cache_stats().size > 0) {
+            LogPrintf("Using up to %d MiB to cache ProgPoW dataset items\n", item_cache_mb);
+        } else {
+            LogPrintf("Unable to allocate %d MiB for the ProgPoW item cache\n", item_cache_mb);
+        }
+    }
+}
+
+void StopProgPow()
+{
+    StopProgPowEpochCache();
+    progpow::set_dataset_options(0, false);
+    progpow::set_item_cache_size(0);
+}
+} // namespace node
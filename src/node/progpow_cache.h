@@ -0,0 +1,57 @@
+// Copyright (c) 2024 The Regus Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef REGUS_NODE_PROGPOW_CACHE_H
+#define REGUS_NODE_PROGPOW_CACHE_H
+
+#include <crypto/ethash/include/ethash/ethash.hpp>
+#include <util/fs.h>
+
+#include <cstdint>
+
+class ArgsManager;
+
+namespace node {
+/** Default disk budget for persisted ProgPoW light caches, in MiB. */
+static constexpr int64_t DEFAULT_POW_EPOCH_CACHE_MB{256};
+/** Default memory budget for the ProgPoW dataset of the current epoch, in MiB (0 = light verification only). */
+static constexpr int64_t DEFAULT_POW_DAG_MB{0};
+/** Whether the dataset is generated in the background ahead of use by default. */
+static constexpr bool DEFAULT_POW_DAG_PREFILL{true};
+/** Whether light caches and datasets may use huge pages by default. */
+static constexpr bool DEFAULT_POW_HUGE_PAGES{true};
+/** Default memory budget for dataset items computed by light verification, in MiB (0 = disabled). */
+static constexpr int64_t DEFAULT_POW_ITEM_CACHE_MB{0};
+
+/**
+ * Persist ProgPoW light caches (and the L1 cache derived from them) as
+ * epoch-<n>.bin files in a directory, so that a restart or reindex maps them
+ * read-only instead of rebuilding them. Files are shared between processes
+ * through the page cache and protected by a checksum.
+ *
+ * Once started, every epoch context built through ethash::get_epoch_context()
+ * is loaded from or written to the cache directory. The oldest epochs are
+ * removed whenever the files exceed the size budget.
+ */
+void StartProgPowEpochCache(const fs::path& dir, uint64_t max_bytes);
+
+/** Stop using the on-disk cache. Contexts already loaded stay valid. */
+void StopProgPowEpochCache();
+
+/** Apply -powepochcache (starting the cache in <datadir>/progpow if enabled),
+ * -powdag, -powdagprefill, -powhugepages and -powitemcache. */
+void ApplyProgPowArgs(const ArgsManager& args);
+
+/** Stop the epoch cache and release the dataset, waiting for its background fill. */
+void StopProgPow();
+
+/** Load the context for an epoch from the cache directory, or return null if
+ * there is no valid file for it. */
+ethash::epoch_context_shared_ptr ReadProgPowEpochFile(const fs::path& dir, int epoch_number);
+
+/** Write the context to the cache directory. */
+bool WriteProgPowEpochFile(const fs::path& dir, const ethash::epoch_context& context);
+} // namespace node
+
+#endif // REGUS_NODE_PROGPOW_CACHE_H
@@ -0,0 +1,127 @@
+// Copyright (c) 2024 The Regus Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <node/template_builder.h>
+
+#include <chain.h>
+#include <logging.h>
+#include <node/miner.h>
+#include <txmempool.h>
+#include <util/thread.h>
+#include <util/time.h>
+#include <validation.h>
+
+#include <exception>
+
+namespace node {
+BlockTemplateBuilder::BlockTemplateBuilder(ChainstateManager& chainman, const CTxMemPool& mempool)
+    : m_chainman{chainman}, m_mempool{mempool} {}
+
+BlockTemplateBuilder::~BlockTemplateBuilder()
+{
+    Stop();
+}
+
+void BlockTemplateBuilder::Start()
+{
+    m_thread = std::thread(&util::TraceThread, "tmplbuild", [this] { ThreadBuild(); });
+}
+
+void BlockTemplateBuilder::Stop()
+{
+    {
+        LOCK(m_mutex);
+        m_stop = true;
+    }
+    m_cv.notify_all();
+    if (m_thread.joinable()) m_thread.join();
+}
+
+std::pair<std::shared_ptr<const CBlockTemplate>, unsigned int> BlockTemplateBuilder::GetTemplate(const CBlockIndex* tip)
+{
+    LOCK(m_mutex);
+    if (!m_active) {
+        m_active = true;
+        m_tip_changed = true;
+        m_cv.notify_one();
+    }
+    if (!m_template || m_template_prev != tip) return {nullptr, 0};
+    return {m_template, m_template_transactions_updated};
+}
+
+BlockTemplateBuilder::Stats BlockTemplateBuilder::GetStats() const
+{
+    LOCK(m_mutex);
+    return m_stats;
+}
+
+void BlockTemplateBuilder::UpdatedBlockTip(const CBlockIndex* pindexNew, const CBlockIndex* pindexFork, bool fInitialDownload)
+{
+    MarkStale(/*tip_changed=*/true);
+}
+
+void BlockTemplateBuilder::TransactionAddedToMempool(const NewMempoolTransactionInfo& tx, uint64_t mempool_sequence)
+{
+    MarkStale(/*tip_changed=*/false);
+}
+
+void BlockTemplateBuilder::TransactionRemovedFromMempool(const CTransactionRef& tx, MemPoolRemovalReason reason, uint64_t mempool_sequence)
+{
+    MarkStale(/*tip_changed=*/false);
+}
+
+void BlockTemplateBuilder::MarkStale(bool tip_changed)
+{
+    LOCK(m_mutex);
+    if (!m_active) return;
+    (tip_changed ? m_tip_changed : m_mempool_changed) = true;
+    m_cv.notify_one();
+}
+
+void BlockTemplateBuilder::ThreadBuild()
+{
+    WAIT_LOCK(m_mutex, lock);
+    while (!m_stop) {
+        if (!m_tip_changed && !m_mempool_changed) {
+            m_cv.wait(lock);
+            continue;
+        }
+        // Batch mempool changes, but never delay a template for a new tip.
+        if (!m_tip_changed && m_stats.built_time) {
+            const auto next{*m_stats.built_time + TEMPLATE_REBUILD_INTERVAL};
+            if (SteadyClock::now() < next) {
+                m_cv.wait_until(lock, next);
+                continue;
+            }
+        }
+        m_tip_changed = m_mempool_changed = false;
+
+        const auto start{SteadyClock::now()};
+        std::unique_ptr<CBlockTemplate> block_template;
+        const CBlockIndex* prev;
+        unsigned int transactions_updated;
+        {
+            REVERSE_LOCK(lock);
+            LOCK(cs_main);
+            prev = m_chainman.ActiveChain().Tip();
+            transactions_updated = m_mempool.GetTransactionsUpdated();
+            try {
+                block_template = BlockAssembler{m_chainman.ActiveChainstate(), &m_mempool}.CreateNewBlock(m_coinbase_script);
+            } catch (const std::exception& e) {
+                LogPrintf("%s: failed to build block template: %s\n", __func__, e.what());
+            }
+        }
+        if (!block_template) continue;
+
+        const auto end{SteadyClock::now()};
+        m_template = std::move(block_template);
+        m_template_prev = prev;
+        m_template_transactions_updated = transactions_updated;
+        ++m_stats.rebuilds;
+        m_stats.built_time = end;
+        m_stats.build_duration = std::chrono::duration_cast<std::chrono::microseconds>(end - start);
+        LogPrint(BCLog::BENCH, "Built block template at height %d in %.2fms\n", prev->nHeight + 1, Ticks<MillisecondsDouble>(end - start));
+    }
+}
+} // namespace node
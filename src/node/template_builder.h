@@ -0,0 +1,101 @@
+// Copyright (c) 2024 The Regus Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef REGUS_NODE_TEMPLATE_BUILDER_H
+#define REGUS_NODE_TEMPLATE_BUILDER_H
+
+#include <script/script.h>
+#include <sync.h>
+#include <threadsafety.h>
+#include <validationinterface.h>
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <thread>
+
+class CBlockIndex;
+class CTxMemPool;
+class ChainstateManager;
+
+namespace node {
+struct CBlockTemplate;
+
+/** Default for -blocktemplatebuilder */
+static constexpr bool DEFAULT_BLOCK_TEMPLATE_BUILDER{true};
+/** Minimum time between rebuilds caused by mempool changes alone */
+static constexpr std::chrono::seconds TEMPLATE_REBUILD_INTERVAL{1};
+
+/**
+ * Keeps a block template for the current tip up to date on a background
+ * thread, so that getblocktemplate does not have to assemble a block from
+ * the whole mempool and test its validity while the miner waits.
+ *
+ * A tip change rebuilds the template right away. Mempool changes rebuild it
+ * at most once per TEMPLATE_REBUILD_INTERVAL. Nothing is built until the
+ * first template is requested, so nodes that do not mine pay nothing.
+ */
+class BlockTemplateBuilder final : public CValidationInterface
+{
+public:
+    struct Stats {
+        //! Number of templates built
+        uint64_t rebuilds{0};
+        //! When the current template was built, if there is one
+        std::optional<std::chrono::steady_clock::time_point> built_time;
+        //! How long building the current template took
+        std::chrono::microseconds build_duration{0};
+    };
+
+    BlockTemplateBuilder(ChainstateManager& chainman, const CTxMemPool& mempool);
+    ~BlockTemplateBuilder();
+
+    /** Start the background thread. */
+    void Start();
+    /** Stop the background thread. Call after unregistering from validation interface events. */
+    void Stop();
+
+    /**
+     * Returns the current template if it builds on tip, null otherwise. The
+     * second element is the mempool's GetTransactionsUpdated() at the time it
+     * was built.
+     */
+    std::pair<std::shared_ptr<const CBlockTemplate>, unsigned int> GetTemplate(const CBlockIndex* tip) EXCLUSIVE_LOCKS_REQUIRED(!m_mutex);
+
+    Stats GetStats() const EXCLUSIVE_LOCKS_REQUIRED(!m_mutex);
+
+protected:
+    void UpdatedBlockTip(const CBlockIndex* pindexNew, const CBlockIndex* pindexFork, bool fInitialDownload) override EXCLUSIVE_LOCKS_REQUIRED(!m_mutex);
+    void TransactionAddedToMempool(const NewMempoolTransactionInfo& tx, uint64_t mempool_sequence) override EXCLUSIVE_LOCKS_REQUIRED(!m_mutex);
+    void TransactionRemovedFromMempool(const CTransactionRef& tx, MemPoolRemovalReason reason, uint64_t mempool_sequence) override EXCLUSIVE_LOCKS_REQUIRED(!m_mutex);
+
+private:
+    void MarkStale(bool tip_changed) EXCLUSIVE_LOCKS_REQUIRED(!m_mutex);
+    void ThreadBuild() EXCLUSIVE_LOCKS_REQUIRED(!m_mutex);
+
+    ChainstateManager& m_chainman;
+    const CTxMemPool& m_mempool;
+    //! Coinbase placeholder, replaced by the miner (same as getblocktemplate uses)
+    const CScript m_coinbase_script{CScript() << OP_TRUE};
+
+    mutable Mutex m_mutex;
+    std::condition_variable m_cv;
+    std::thread m_thread;
+    bool m_stop GUARDED_BY(m_mutex){false};
+    //! Whether a template was ever requested
+    bool m_active GUARDED_BY(m_mutex){false};
+    //! Whether the template no longer reflects the tip
+    bool m_tip_changed GUARDED_BY(m_mutex){false};
+    //! Whether the template no longer reflects the mempool
+    bool m_mempool_changed GUARDED_BY(m_mutex){false};
+    std::shared_ptr<const CBlockTemplate> m_template GUARDED_BY(m_mutex);
+    const CBlockIndex* m_template_prev GUARDED_BY(m_mutex){nullptr};
+    unsigned int m_template_transactions_updated GUARDED_BY(m_mutex){0};
+    Stats m_stats GUARDED_BY(m_mutex);
+};
+} // namespace node
+
+#endif // REGUS_NODE_TEMPLATE_BUILDER_H
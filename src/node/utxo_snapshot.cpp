@@ -5,6 +5,9 @@
 
 #include <node/utxo_snapshot.h>
 
+#include <chain.h>
+#include <consensus/amount.h>
+#include <kernel/coinstats.h>
 #include <logging.h>
 #include <streams.h>
 #include <sync.h>
@@ -12,10 +15,15 @@
 #include <txdb.h>
 #include <uint256.h>
 #include <util/fs.h>
+#include <util/threadnames.h>
 #include <validation.h>
 
+#include <algorithm>
 #include <cassert>
 #include <cstdio>
+#include <ios>
+#include <limits>
+#include <memory>
 #include <optional>
 #include <string>
 
@@ -93,4 +101,244 @@ std::optional<fs::path> FindSnapshotChainstateDir(const fs::path& data_dir)
     return std::nullopt;
 }
 
+std::optional<SnapshotInfo> WriteUTXOSnapshot(
+    Chainstate& chainstate,
+    AutoFile& afile,
+    const std::function<void()>& interruption_point)
+{
+    std::unique_ptr<CCoinsViewCursor> pcursor;
+    const CBlockIndex* tip;
+
+    {
+        // We need to lock cs_main to ensure that the coinsdb isn't written to
+        // between flushing the coins cache to disk and constructing a cursor
+        // to the coinsdb.
+        //
+        // Cursors returned by leveldb iterate over snapshots, so the contents
+        // of the pcursor will not be affected by simultaneous writes during
+        // use below this block.
+        LOCK(::cs_main);
+
+        chainstate.ForceFlushStateToDisk();
+
+        pcursor = chainstate.CoinsDB().Cursor();
+        tip = chainstate.m_blockman.LookupBlockIndex(pcursor->GetBestBlock());
+    }
+    if (!tip) {
+        LogPrintf("[snapshot] coins database best block %s not found\n", pcursor->GetBestBlock().ToString());
+        return std::nullopt;
+    }
+
+    // The coins count is only known once the coins are written, so the
+    // metadata is written again after them.
+    SnapshotMetadata metadata{tip->GetBlockHash(), 0};
+    afile << metadata;
+
+    kernel::SerializedCoinsHasher hasher;
+    COutPoint key;
+    Coin coin;
+
+    while (pcursor->Valid()) {
+        if (interruption_point && metadata.m_coins_count % 5000 == 0) interruption_point();
+        if (!pcursor->GetKey(key) || !pcursor->GetValue(coin)) {
+            LogPrintf("[snapshot] unable to read coins database\n");
+            return std::nullopt;
+        }
+        afile << key;
+        afile << coin;
+        if (!hasher.Add(key, coin)) {
+            LogPrintf("[snapshot] coins database yielded coin %s out of order\n", key.ToString());
+            return std::nullopt;
+        }
+        ++metadata.m_coins_count;
+
+        pcursor->Next();
+    }
+
+    if (std::fseek(afile.Get(), 0, SEEK_SET) != 0) {
+        LogPrintf("[snapshot] unable to rewind snapshot file\n");
+        return std::nullopt;
+    }
+    afile << metadata;
+    if (afile.fclose() != 0) {
+        LogPrintf("[snapshot] failed to close snapshot file after writing\n");
+        return std::nullopt;
+    }
+
+    return SnapshotInfo{
+        .base_blockhash = tip->GetBlockHash(),
+        .base_height = tip->nHeight,
+        .coins_count = metadata.m_coins_count,
+        .hash_serialized = hasher.Finalize(),
+        .nchaintx = tip->nChainTx,
+    };
+}
+
+//! Number of coins handed from one SnapshotCoinsReader stage to the next at a time.
+static constexpr size_t SNAPSHOT_BATCH_COINS{4096};
+//! Number of batches a SnapshotCoinsReader stage may get ahead of the next one.
+static constexpr size_t SNAPSHOT_MAX_QUEUED_BATCHES{8};
+
+SnapshotCoinsReader::SnapshotCoinsReader(AutoFile& coins_file, uint64_t coins_count, int base_height)
+    : m_coins_file{coins_file}, m_coins_count{coins_count}, m_base_height{base_height}
+{
+    m_read_thread = std::thread([this]() {
+        util::ThreadRename("snapshotread");
+        ThreadRead();
+    });
+    m_hash_thread = std::thread([this]() {
+        util::ThreadRename("snapshothash");
+        ThreadHash();
+    });
+}
+
+SnapshotCoinsReader::~SnapshotCoinsReader()
+{
+    WITH_LOCK(m_mutex, m_stop = true);
+    m_cv.notify_all();
+    m_read_thread.join();
+    m_hash_thread.join();
+}
+
+bool SnapshotCoinsReader::Push(bool hashed, Batch&& batch)
+{
+    {
+        WAIT_LOCK(m_mutex, lock);
+        std::deque<Batch>& queue{hashed ? m_hashed : m_read};
+        m_cv.wait(lock, [&]() EXCLUSIVE_LOCKS_REQUIRED(m_mutex) { return m_stop || queue.size() < SNAPSHOT_MAX_QUEUED_BATCHES; });
+        if (m_stop) return false;
+        queue.push_back(std::move(batch));
+    }
+    m_cv.notify_all();
+    return true;
+}
+
+void SnapshotCoinsReader::ThreadRead()
+{
+    const auto finish{[&](bool complete) {
+        {
+            LOCK(m_mutex);
+            m_read_done = true;
+            m_complete = complete;
+        }
+        m_cv.notify_all();
+    }};
+
+    uint64_t coins_read{0};
+    while (coins_read < m_coins_count) {
+        const size_t batch_size{static_cast<size_t>(std::min<uint64_t>(SNAPSHOT_BATCH_COINS, m_coins_count - coins_read))};
+        Batch batch;
+        batch.reserve(batch_size);
+        for (size_t i{0}; i < batch_size; ++i, ++coins_read) {
+            COutPoint outpoint;
+            Coin coin;
+            try {
+                m_coins_file >> outpoint;
+                m_coins_file >> coin;
+            } catch (const std::ios_base::failure&) {
+                LogPrintf("[snapshot] bad snapshot format or truncated snapshot after deserializing %d coins\n",
+                          coins_read);
+                return finish(false);
+            }
+            if (coin.nHeight > m_base_height ||
+                outpoint.n >= std::numeric_limits<decltype(outpoint.n)>::max() // Avoid integer wrap-around in coinstats.cpp:ApplyHash
+            ) {
+                LogPrintf("[snapshot] bad snapshot data after deserializing %d coins\n",
+                          coins_read);
+                return finish(false);
+            }
+            if (!MoneyRange(coin.out.nValue)) {
+                LogPrintf("[snapshot] bad snapshot data after deserializing %d coins - bad tx out value\n",
+                          coins_read);
+                return finish(false);
+            }
+            batch.emplace_back(std::move(outpoint), std::move(coin));
+        }
+        if (!Push(/*hashed=*/false, std::move(batch))) return finish(false);
+    }
+
+    bool out_of_coins{false};
+    try {
+        COutPoint outpoint;
+        m_coins_file >> outpoint;
+    } catch (const std::ios_base::failure&) {
+        // We expect an exception since we should be out of coins.
+        out_of_coins = true;
+    }
+    if (!out_of_coins) {
+        LogPrintf("[snapshot] bad snapshot - coins left over after deserializing %d coins\n",
+            m_coins_count);
+        return finish(false);
+    }
+    finish(true);
+}
+
+void SnapshotCoinsReader::ThreadHash()
+{
+    kernel::SerializedCoinsHasher hasher;
+    bool ordered{true};
+    bool hashed_all{false};
+
+    while (true) {
+        Batch batch;
+        {
+            WAIT_LOCK(m_mutex, lock);
+            m_cv.wait(lock, [&]() EXCLUSIVE_LOCKS_REQUIRED(m_mutex) { return m_stop || m_read_done || !m_read.empty(); });
+            if (m_stop || (m_read_done && !m_complete)) break;
+            if (m_read.empty()) {
+                hashed_all = true;
+                break;
+            }
+            batch = std::move(m_read.front());
+            m_read.pop_front();
+        }
+        m_cv.notify_all();
+
+        for (const auto& [outpoint, coin] : batch) {
+            if (ordered && !hasher.Add(outpoint, coin)) {
+                LogPrintf("[snapshot] coins are not in coins database order from %s on, hashing them once loaded\n",
+                          outpoint.ToString());
+                ordered = false;
+            }
+        }
+        if (!Push(/*hashed=*/true, std::move(batch))) break;
+    }
+
+    std::optional<uint256> commitment;
+    if (hashed_all && ordered) commitment = hasher.Finalize();
+    {
+        LOCK(m_mutex);
+        m_commitment = commitment;
+        m_hash_done = true;
+    }
+    m_cv.notify_all();
+}
+
+std::optional<SnapshotCoinsReader::Batch> SnapshotCoinsReader::Next()
+{
+    std::optional<Batch> batch;
+    {
+        WAIT_LOCK(m_mutex, lock);
+        const auto failed{[&]() EXCLUSIVE_LOCKS_REQUIRED(m_mutex) { return m_read_done && !m_complete; }};
+        m_cv.wait(lock, [&]() EXCLUSIVE_LOCKS_REQUIRED(m_mutex) { return failed() || m_hash_done || !m_hashed.empty(); });
+        if (failed() || m_hashed.empty()) return std::nullopt;
+        batch = std::move(m_hashed.front());
+        m_hashed.pop_front();
+    }
+    m_cv.notify_all();
+    return batch;
+}
+
+bool SnapshotCoinsReader::Complete() const
+{
+    LOCK(m_mutex);
+    return m_complete && m_hash_done;
+}
+
+std::optional<uint256> SnapshotCoinsReader::Commitment() const
+{
+    LOCK(m_mutex);
+    return m_commitment;
+}
+
 } // namespace node
@@ -7,16 +7,25 @@
 #ifndef REGUS_NODE_UTXO_SNAPSHOT_H
 #define REGUS_NODE_UTXO_SNAPSHOT_H
 
+#include <coins.h>
 #include <kernel/cs_main.h>
+#include <primitives/transaction.h>
 #include <serialize.h>
 #include <sync.h>
 #include <uint256.h>
 #include <util/fs.h>
 
+#include <condition_variable>
 #include <cstdint>
+#include <deque>
+#include <functional>
 #include <optional>
 #include <string_view>
+#include <thread>
+#include <utility>
+#include <vector>
 
+class AutoFile;
 class Chainstate;
 
 namespace node {
@@ -69,6 +78,86 @@ constexpr std::string_view SNAPSHOT_CHAINSTATE_SUFFIX = "_snapshot";
 //! Return a path to the snapshot-based chainstate dir, if one exists.
 std::optional<fs::path> FindSnapshotChainstateDir(const fs::path& data_dir);
 
+//! Describes a UTXO snapshot written by WriteUTXOSnapshot(). Apart from the
+//! coins count, these are the values of its CChainParams::m_assumeutxo_data entry.
+struct SnapshotInfo {
+    uint256 base_blockhash;
+    int base_height{0};
+    uint64_t coins_count{0};
+    uint256 hash_serialized;
+    unsigned int nchaintx{0};
+};
+
+//! Flush the chainstate and write its UTXO set to afile as a snapshot.
+//!
+//! The coins are written in coins database order, so two nodes at the same tip
+//! produce identical files, and they are hashed as they are written, so the
+//! database is only read once. Returns nullopt if the database can't be read.
+std::optional<SnapshotInfo> WriteUTXOSnapshot(
+    Chainstate& chainstate,
+    AutoFile& afile,
+    const std::function<void()>& interruption_point = {})
+    LOCKS_EXCLUDED(::cs_main);
+
+/**
+ * Reads the coins of a UTXO snapshot on background threads while the caller
+ * inserts them into its coins cache.
+ *
+ * One thread deserializes the coins and checks them against the snapshot base
+ * height; a second thread hashes them into the HASH_SERIALIZED commitment, so
+ * that the snapshot doesn't need to be hashed again from the database once it
+ * is loaded. Coins are handed over in batches, and only a few batches are kept
+ * in flight, so memory use doesn't depend on the snapshot size.
+ */
+class SnapshotCoinsReader
+{
+public:
+    using Batch = std::vector<std::pair<COutPoint, Coin>>;
+
+    //! coins_file must be positioned after the SnapshotMetadata, and must
+    //! outlive the reader.
+    SnapshotCoinsReader(AutoFile& coins_file, uint64_t coins_count, int base_height);
+    ~SnapshotCoinsReader();
+
+    //! Wait for the next batch of checked and hashed coins. Returns nullopt
+    //! once all coins have been returned, or once reading them failed.
+    std::optional<Batch> Next();
+
+    //! Whether all coins were read, and the file held no more coins after
+    //! them. Only valid once Next() returned nullopt.
+    bool Complete() const;
+
+    //! The HASH_SERIALIZED commitment of the coins, or nullopt if they were
+    //! not in coins database order. Only valid once Complete() returned true.
+    std::optional<uint256> Commitment() const;
+
+private:
+    void ThreadRead();
+    void ThreadHash();
+    //! Queue a batch for the next stage, once there is room. Returns false if
+    //! the reader is being destroyed.
+    bool Push(bool hashed, Batch&& batch);
+
+    AutoFile& m_coins_file;
+    const uint64_t m_coins_count;
+    const int m_base_height;
+
+    mutable Mutex m_mutex;
+    std::condition_variable m_cv;
+    //! Batches that have been read, but not hashed yet.
+    std::deque<Batch> m_read GUARDED_BY(m_mutex);
+    //! Batches that have been hashed, but not returned by Next() yet.
+    std::deque<Batch> m_hashed GUARDED_BY(m_mutex);
+    bool m_read_done GUARDED_BY(m_mutex){false};
+    bool m_hash_done GUARDED_BY(m_mutex){false};
+    bool m_complete GUARDED_BY(m_mutex){false};
+    bool m_stop GUARDED_BY(m_mutex){false};
+    std::optional<uint256> m_commitment GUARDED_BY(m_mutex);
+
+    std::thread m_read_thread;
+    std::thread m_hash_thread;
+};
+
 } // namespace node
 
 #endif // REGUS_NODE_UTXO_SNAPSHOT_H
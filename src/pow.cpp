@@ -8,8 +8,18 @@
 
 #include <arith_uint256.h>
 #include <chain.h>
+#include <crypto/common.h>
+#include <crypto/sha256.h>
+#include <cuckoocache.h>
+#include <logging.h>
 #include <primitives/block.h>
+#include <random.h>
 #include <uint256.h>
+#include <util/hasher.h>
+
+#include <mutex>
+#include <optional>
+#include <shared_mutex>
 
 unsigned int GetNextWorkRequired(const CBlockIndex* pindexLast, const CBlockHeader *pblock, const Consensus::Params& params)
 {
@@ -39,6 +49,18 @@ unsigned int GetNextWorkRequired(const CBlockIndex* pindexLast, const CBlockHead
 }
 
 unsigned int CalculateNextWorkRequired(const CBlockIndex* pindexLast, const Consensus::Params& params)
+{
+    // The result only depends on the window of ancestors, which never changes,
+    // so it is computed once per block index.
+    if (pindexLast && pindexLast->nNextWorkRequired != 0) {
+        return pindexLast->nNextWorkRequired;
+    }
+    const unsigned int nBits = CalculateNextWorkRequiredUncached(pindexLast, params);
+    if (pindexLast) pindexLast->nNextWorkRequired = nBits;
+    return nBits;
+}
+
+unsigned int CalculateNextWorkRequiredUncached(const CBlockIndex* pindexLast, const Consensus::Params& params)
 {
     const arith_uint256 bnPowLimit = UintToArith256(params.powLimit);
     int64_t nPastBlocks = params.nPowTargetWindow;
@@ -121,3 +143,88 @@ bool CheckProofOfWork(uint256 hash, unsigned int nBits, const Consensus::Params&
 
     return true;
 }
+
+bool CheckProofOfWorkFinalHash(const CBlockHeader& block, const Consensus::Params& params)
+{
+    return CheckProofOfWork(block.GetHash(), block.nBits, params);
+}
+
+namespace {
+/**
+ * Cache of headers whose claimed hashMix has been verified, so that a header
+ * seen during headers sync, block download, AcceptBlock and reconnection after
+ * a reorg or restart pays for the ProgPoW mix only once. Only successful
+ * checks are stored.
+ */
+class CPowCache
+{
+private:
+    //! Entries are SHA256(nonce || 'P' || 31 zero bytes || header hash || nNonce || hashMix):
+    CSHA256 m_salted_hasher;
+    CuckooCache::cache<uint256, SignatureCacheHasher> m_valid;
+    std::shared_mutex m_mutex;
+
+public:
+    CPowCache()
+    {
+        uint256 nonce = GetRandHash();
+        static constexpr unsigned char PADDING_POW[32] = {'P'};
+        m_salted_hasher.Write(nonce.begin(), 32);
+        m_salted_hasher.Write(PADDING_POW, 32);
+    }
+
+    uint256 ComputeEntry(const CBlockHeader& block) const
+    {
+        uint256 entry;
+        const uint256 header_hash{block.GetHeaderHash()};
+        unsigned char nonce[8];
+        WriteLE64(nonce, block.nNonce);
+        CSHA256 hasher = m_salted_hasher;
+        hasher.Write(header_hash.begin(), 32).Write(nonce, sizeof(nonce)).Write(block.hashMix.begin(), 32).Finalize(entry.begin());
+        return entry;
+    }
+
+    bool Get(const uint256& entry)
+    {
+        std::shared_lock<std::shared_mutex> lock(m_mutex);
+        return m_valid.contains(entry, /*erase=*/false);
+    }
+
+    void Set(const uint256& entry)
+    {
+        std::unique_lock<std::shared_mutex> lock(m_mutex);
+        m_valid.insert(entry);
+    }
+
+    std::optional<std::pair<uint32_t, size_t>> setup_bytes(size_t n)
+    {
+        return m_valid.setup_bytes(n);
+    }
+};
+
+CPowCache g_pow_cache;
+} // namespace
+
+bool InitPowCache(size_t max_size_bytes)
+{
+    auto setup_results = g_pow_cache.setup_bytes(max_size_bytes);
+    if (!setup_results) return false;
+
+    const auto [num_elems, approx_size_bytes] = *setup_results;
+    LogPrintf("Using %zu MiB out of %zu MiB requested for proof-of-work cache, able to store %zu elements\n",
+              approx_size_bytes >> 20, max_size_bytes >> 20, num_elems);
+    return true;
+}
+
+bool CheckProofOfWorkMix(const CBlockHeader& block)
+{
+    const uint256 entry{g_pow_cache.ComputeEntry(block)};
+    if (g_pow_cache.Get(entry)) return true;
+
+    uint256 hashMix;
+    block.GetHash(hashMix);
+    if (hashMix != block.hashMix) return false;
+
+    g_pow_cache.Set(entry);
+    return true;
+}
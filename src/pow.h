@@ -8,19 +8,51 @@
 #define REGUS_POW_H
 
 #include <consensus/params.h>
+#include <kernel/cs_main.h>
+#include <sync.h>
 
+#include <cstddef>
 #include <stdint.h>
 
 class CBlockHeader;
 class CBlockIndex;
 class uint256;
 
-unsigned int GetNextWorkRequired(const CBlockIndex* pindexLast, const CBlockHeader *pblock, const Consensus::Params&);
-unsigned int CalculateNextWorkRequired(const CBlockIndex* pindexLast, const Consensus::Params& params);
+/** Default size of the cache of verified ProgPoW mixes, in bytes. */
+static constexpr size_t DEFAULT_MAX_POW_CACHE_BYTES{1 << 20};
+
+unsigned int GetNextWorkRequired(const CBlockIndex* pindexLast, const CBlockHeader *pblock, const Consensus::Params&) EXCLUSIVE_LOCKS_REQUIRED(::cs_main);
+/** nBits required of a child of pindexLast. Cached in pindexLast after the first call. */
+unsigned int CalculateNextWorkRequired(const CBlockIndex* pindexLast, const Consensus::Params& params) EXCLUSIVE_LOCKS_REQUIRED(::cs_main);
+/** CalculateNextWorkRequired() without the cache. */
+unsigned int CalculateNextWorkRequiredUncached(const CBlockIndex* pindexLast, const Consensus::Params& params);
 
 /** Check whether a block hash satisfies the proof-of-work requirement specified by nBits */
 bool CheckProofOfWork(uint256 hash, unsigned int nBits, const Consensus::Params&);
 
+/**
+ * First stage of ProgPoW verification: check the final hash derived from the
+ * header's claimed hashMix against nBits. This costs two keccak-f800
+ * permutations, so it should run before CheckProofOfWorkMix() to reject
+ * headers that do not even claim enough work.
+ */
+bool CheckProofOfWorkFinalHash(const CBlockHeader& block, const Consensus::Params&);
+
+/**
+ * Second stage of ProgPoW verification: recompute the mix from the epoch
+ * context and check that it equals the claimed hashMix. Together with
+ * CheckProofOfWorkFinalHash() this is equivalent to checking the full
+ * ProgPoW hash against nBits.
+ *
+ * Successful checks are remembered in a salted cache shared by all validation
+ * paths, so the same header is only recomputed once.
+ */
+bool CheckProofOfWorkMix(const CBlockHeader& block);
+
+/** Size the cache used by CheckProofOfWorkMix(). To be called once in
+ * AppInitMain/BasicTestingSetup. */
+[[nodiscard]] bool InitPowCache(size_t max_size_bytes);
+
 /**
  * Return false if the proof-of-work requirement specified by new_nbits at a
  * given height is not possible, given the proof-of-work on the prior block as
@@ -11,6 +11,7 @@
 
 uint256 CBlockHeader::GetHash() const
 {
+    if (m_hash_cache.hashes) return m_hash_cache.hashes->first;
     return ETHash(*this);
 }
 
@@ -21,10 +22,20 @@ uint256 CBlockHeader::GetHash(uint256& hashMix) const
 
 uint256 CBlockHeader::GetHeaderHash() const
 {
+    if (m_hash_cache.hashes) return m_hash_cache.hashes->second;
     CHashInput input{*this};
     return (HashWriter{} << input).GetHash();
 }
 
+void CBlockHeader::CacheHashes()
+{
+    m_hash_cache.hashes.reset();
+    const uint256 header_hash{GetHeaderHash()};
+    m_hash_cache.hashes.emplace(uint256{}, header_hash);
+    // ETHash() picks up the header hash from the cache.
+    m_hash_cache.hashes->first = ETHash(*this);
+}
+
 std::string CBlockHeader::ToString() const
 {
     std::stringstream s;
@@ -12,6 +12,9 @@
 #include <uint256.h>
 #include <util/time.h>
 
+#include <optional>
+#include <utility>
+
 /** Nodes collect new transactions into a block, hash them into a hash tree,
  * and scan through nonce values to make the block's hash satisfy proof-of-work
  * requirements.  When they solve the proof-of-work, they broadcast the block
@@ -21,6 +24,19 @@
  */
 class CBlockHeader
 {
+private:
+    /** Hashes memoized by CacheHashes(). A copy starts without them, so that it can be modified; a move keeps them. */
+    struct HashCache {
+        std::optional<std::pair<uint256, uint256>> hashes; //!< GetHash(), GetHeaderHash()
+
+        HashCache() = default;
+        HashCache(const HashCache&) {}
+        HashCache& operator=(const HashCache&) { hashes.reset(); return *this; }
+        HashCache(HashCache&&) = default;
+        HashCache& operator=(HashCache&&) = default;
+    };
+    HashCache m_hash_cache;
+
 public:
     // header
     int nHeight;
@@ -37,10 +53,15 @@ public:
         SetNull();
     }
 
-    SERIALIZE_METHODS(CBlockHeader, obj) { READWRITE(obj.nVersion, obj.hashPrevBlock, obj.hashMerkleRoot, obj.nTime, obj.nBits, obj.nHeight, obj.nNonce, obj.hashMix); }
+    SERIALIZE_METHODS(CBlockHeader, obj)
+    {
+        READWRITE(obj.nVersion, obj.hashPrevBlock, obj.hashMerkleRoot, obj.nTime, obj.nBits, obj.nHeight, obj.nNonce, obj.hashMix);
+        SER_READ(obj, obj.m_hash_cache.hashes.reset());
+    }
 
     void SetNull()
     {
+        m_hash_cache.hashes.reset();
         nHeight = 0;
         nVersion = 0;
         hashMix.SetNull();
@@ -60,6 +81,16 @@ public:
     uint256 GetHash(uint256& hashMix) const;
     uint256 GetHeaderHash() const;
 
+    /**
+     * Compute GetHash() and GetHeaderHash() now and return the results from
+     * then on. Opt-in for headers and blocks that are not modified afterwards,
+     * such as blocks received from peers or read from disk, before they are
+     * shared as std::shared_ptr<const CBlock>. Not thread-safe: call it before
+     * the object is shared. SetNull() and deserialization forget the hashes.
+     */
+    void CacheHashes();
+    bool HasCachedHashes() const { return m_hash_cache.hashes.has_value(); }
+
     NodeSeconds Time() const
     {
         return NodeSeconds{std::chrono::seconds{nTime}};
@@ -84,6 +115,7 @@ public:
     mutable bool fChecked;                            // CheckBlock()
     mutable bool m_checked_witness_commitment{false}; // CheckWitnessCommitment()
     mutable bool m_checked_merkle_root{false};        // CheckMerkleRoot()
+    mutable bool m_checked_pow{false};                // CheckBlockHeader()
 
     CBlock()
     {
@@ -108,6 +140,7 @@ public:
         fChecked = false;
         m_checked_witness_commitment = false;
         m_checked_merkle_root = false;
+        m_checked_pow = false;
     }
 
     CBlockHeader GetBlockHeader() const
@@ -23,9 +23,12 @@
 #include <node/blockstorage.h>
 #include <node/caches.h>
 #include <node/chainstate.h>
+#include <node/utxo_snapshot.h>
+#include <pow.h>
 #include <random.h>
 #include <scheduler.h>
 #include <script/sigcache.h>
+#include <streams.h>
 #include <util/chaintype.h>
 #include <util/fs.h>
 #include <util/thread.h>
@@ -37,15 +40,25 @@
 #include <functional>
 #include <iosfwd>
 #include <memory>
+#include <optional>
 #include <string>
 
 int main(int argc, char* argv[])
 {
     // SETUP: Argument parsing and handling
-    if (argc != 2) {
+    std::optional<ChainType> chain_type{ChainType::MAIN};
+    std::optional<fs::path> snapshot_path;
+    if (argc == 5 && std::string{argv[2]} == "dumptxoutset") {
+        chain_type = ChainTypeFromString(argv[3]);
+        snapshot_path = fs::absolute(fs::PathFromString(argv[4]));
+    }
+    if ((argc != 2 && !snapshot_path) || !chain_type) {
         std::cerr
             << "Usage: " << argv[0] << " DATADIR" << std::endl
+            << "       " << argv[0] << " DATADIR dumptxoutset CHAIN PATH" << std::endl
             << "Display DATADIR information, and process hex-encoded blocks on standard input." << std::endl
+            << "With dumptxoutset, write the UTXO set of the CHAIN (main, test or regtest) tip" << std::endl
+            << "in DATADIR to a snapshot at PATH instead, and print its assumeutxo parameters." << std::endl
             << std::endl
             << "IMPORTANT: THIS EXECUTABLE IS EXPERIMENTAL, FOR TESTING ONLY, AND EXPECTED TO" << std::endl
             << "           BREAK IN FUTURE VERSIONS. DO NOT USE ON YOUR ACTUAL DATADIR." << std::endl;
@@ -68,6 +81,7 @@ int main(int argc, char* argv[])
     kernel::ValidationCacheSizes validation_cache_sizes{};
     Assert(InitSignatureCache(validation_cache_sizes.signature_cache_bytes));
     Assert(InitScriptExecutionCache(validation_cache_sizes.script_execution_cache_bytes));
+    Assert(InitPowCache(validation_cache_sizes.pow_cache_bytes));
 
 
     // SETUP: Scheduling and Background Signals
@@ -114,7 +128,14 @@ int main(int argc, char* argv[])
 
 
     // SETUP: Chainstate
-    auto chainparams = CChainParams::Main();
+    auto chainparams = [&] {
+        switch (*chain_type) {
+        case ChainType::MAIN: return CChainParams::Main();
+        case ChainType::TESTNET: return CChainParams::TestNet();
+        case ChainType::REGTEST: return CChainParams::RegTest();
+        } // no default case, so the compiler can warn about missing cases
+        assert(false);
+    }();
     const ChainstateManager::Options chainman_opts{
         .chainparams = *chainparams,
         .datadir = abs_datadir,
@@ -171,6 +192,33 @@ int main(int argc, char* argv[])
         }
     }
 
+    if (snapshot_path) {
+        if (fs::exists(*snapshot_path)) {
+            std::cerr << fs::PathToString(*snapshot_path) << " already exists." << std::endl;
+            goto epilogue;
+        }
+        AutoFile afile{fsbridge::fopen(*snapshot_path, "wb")};
+        if (afile.IsNull()) {
+            std::cerr << "Couldn't open " << fs::PathToString(*snapshot_path) << " for writing." << std::endl;
+            goto epilogue;
+        }
+        const auto info{node::WriteUTXOSnapshot(chainman.ActiveChainstate(), afile)};
+        if (!info) {
+            std::cerr << "Failed to write the UTXO snapshot." << std::endl;
+            goto epilogue;
+        }
+        std::cout
+            << "Wrote " << info->coins_count << " coins to " << fs::PathToString(*snapshot_path) << std::endl
+            << "m_assumeutxo_data entry:" << std::endl
+            << "            {" << std::endl
+            << "                .height = " << info->base_height << "," << std::endl
+            << "                .hash_serialized = AssumeutxoHash{uint256S(\"0x" << info->hash_serialized.ToString() << "\")}," << std::endl
+            << "                .nChainTx = " << info->nchaintx << "," << std::endl
+            << "                .blockhash = uint256S(\"0x" << info->base_blockhash.ToString() << "\")" << std::endl
+            << "            }," << std::endl;
+        goto epilogue;
+    }
+
     for (std::string line; std::getline(std::cin, line);) {
         if (line.empty()) {
             std::cerr << "Empty line found" << std::endl;
@@ -2632,68 +2632,21 @@ UniValue CreateUTXOSnapshot(
     const fs::path& path,
     const fs::path& temppath)
 {
-    std::unique_ptr<CCoinsViewCursor> pcursor;
-    std::optional<CCoinsStats> maybe_stats;
-    const CBlockIndex* tip;
-
-    {
-        // We need to lock cs_main to ensure that the coinsdb isn't written to
-        // between (i) flushing coins cache to disk (coinsdb), (ii) getting stats
-        // based upon the coinsdb, and (iii) constructing a cursor to the
-        // coinsdb for use below this block.
-        //
-        // Cursors returned by leveldb iterate over snapshots, so the contents
-        // of the pcursor will not be affected by simultaneous writes during
-        // use below this block.
-        //
-        // See discussion here:
-        //   https://github.com/RegusCrypto/Regus/pull/15606#discussion_r274479369
-        //
-        LOCK(::cs_main);
-
-        chainstate.ForceFlushStateToDisk();
-
-        maybe_stats = GetUTXOStats(&chainstate.CoinsDB(), chainstate.m_blockman, CoinStatsHashType::HASH_SERIALIZED, node.rpc_interruption_point);
-        if (!maybe_stats) {
-            throw JSONRPCError(RPC_INTERNAL_ERROR, "Unable to read UTXO set");
-        }
-
-        pcursor = chainstate.CoinsDB().Cursor();
-        tip = CHECK_NONFATAL(chainstate.m_blockman.LookupBlockIndex(maybe_stats->hashBlock));
-    }
-
-    LOG_TIME_SECONDS(strprintf("writing UTXO snapshot at height %s (%s) to file %s (via %s)",
-        tip->nHeight, tip->GetBlockHash().ToString(),
+    LOG_TIME_SECONDS(strprintf("writing UTXO snapshot to file %s (via %s)",
         fs::PathToString(path), fs::PathToString(temppath)));
 
-    SnapshotMetadata metadata{tip->GetBlockHash(), maybe_stats->coins_count};
-
-    afile << metadata;
-
-    COutPoint key;
-    Coin coin;
-    unsigned int iter{0};
-
-    while (pcursor->Valid()) {
-        if (iter % 5000 == 0) node.rpc_interruption_point();
-        ++iter;
-        if (pcursor->GetKey(key) && pcursor->GetValue(coin)) {
-            afile << key;
-            afile << coin;
-        }
-
-        pcursor->Next();
+    const std::optional<node::SnapshotInfo> info{node::WriteUTXOSnapshot(chainstate, afile, node.rpc_interruption_point)};
+    if (!info) {
+        throw JSONRPCError(RPC_INTERNAL_ERROR, "Unable to read UTXO set");
     }
 
-    afile.fclose();
-
     UniValue result(UniValue::VOBJ);
-    result.pushKV("coins_written", maybe_stats->coins_count);
-    result.pushKV("base_hash", tip->GetBlockHash().ToString());
-    result.pushKV("base_height", tip->nHeight);
+    result.pushKV("coins_written", info->coins_count);
+    result.pushKV("base_hash", info->base_blockhash.ToString());
+    result.pushKV("base_height", info->base_height);
     result.pushKV("path", path.utf8string());
-    result.pushKV("txoutset_hash", maybe_stats->hashSerialized.ToString());
-    result.pushKV("nchaintx", tip->nChainTx);
+    result.pushKV("txoutset_hash", info->hash_serialized.ToString());
+    result.pushKV("nchaintx", info->nchaintx);
     return result;
 }
 
@@ -2786,6 +2739,14 @@ const std::vector<RPCResult> RPCHelpForChainstate{
     {RPCResult::Type::STR_HEX, "snapshot_blockhash", /*optional=*/true, "the base block of the snapshot this chainstate is based on, if any"},
     {RPCResult::Type::NUM, "coins_db_cache_bytes", "size of the coinsdb cache"},
     {RPCResult::Type::NUM, "coins_tip_cache_bytes", "size of the coinstip cache"},
+    {RPCResult::Type::OBJ, "coins_flush", "writes of the coinstip cache to the coinsdb", {
+        {RPCResult::Type::NUM, "count", "number of writes"},
+        {RPCResult::Type::NUM, "coins", "number of changed coins written"},
+        {RPCResult::Type::NUM, "duration_ms", "total time spent writing"},
+        {RPCResult::Type::NUM, "last_duration_ms", "time spent on the last write"},
+        {RPCResult::Type::NUM, "stall_ms", "total time block processing waited for writes"},
+        {RPCResult::Type::BOOL, "pending", "whether a write is in progress in the background"},
+    }},
     {RPCResult::Type::BOOL, "validated", "whether the chainstate is fully validated. True if all blocks in the chainstate were validated, false if the chain is based on a snapshot and the snapshot has not yet been validated."},
 };
 
@@ -2827,6 +2788,15 @@ return RPCHelpMan{
         data.pushKV("verificationprogress",  GuessVerificationProgress(Params().TxData(), tip));
         data.pushKV("coins_db_cache_bytes",  cs.m_coinsdb_cache_size_bytes);
         data.pushKV("coins_tip_cache_bytes", cs.m_coinstip_cache_size_bytes);
+        const auto flush_stats{cs.GetCoinsFlushStats()};
+        UniValue coins_flush(UniValue::VOBJ);
+        coins_flush.pushKV("count", flush_stats.flushes);
+        coins_flush.pushKV("coins", flush_stats.coins);
+        coins_flush.pushKV("duration_ms", Ticks<std::chrono::milliseconds>(flush_stats.duration));
+        coins_flush.pushKV("last_duration_ms", Ticks<std::chrono::milliseconds>(flush_stats.last_duration));
+        coins_flush.pushKV("stall_ms", Ticks<std::chrono::milliseconds>(flush_stats.stall));
+        coins_flush.pushKV("pending", flush_stats.pending);
+        data.pushKV("coins_flush", std::move(coins_flush));
         if (cs.m_from_snapshot_blockhash) {
             data.pushKV("snapshot_blockhash", cs.m_from_snapshot_blockhash->ToString());
         }
@@ -8,8 +8,10 @@
 #include <config/regus-config.h>
 #endif
 
+#include <arith_uint256.h>
 #include <chain.h>
 #include <chainparams.h>
+#include <common/args.h>
 #include <common/system.h>
 #include <consensus/amount.h>
 #include <consensus/consensus.h>
@@ -17,12 +19,15 @@
 #include <consensus/params.h>
 #include <consensus/validation.h>
 #include <core_io.h>
+#include <crypto/ethash/include/ethash/progpow.hpp>
 #include <deploymentinfo.h>
 #include <deploymentstatus.h>
+#include <hash.h>
 #include <key_io.h>
 #include <net.h>
 #include <node/context.h>
 #include <node/miner.h>
+#include <node/template_builder.h>
 #include <pow.h>
 #include <rpc/blockchain.h>
 #include <rpc/mining.h>
@@ -32,6 +37,7 @@
 #include <script/descriptor.h>
 #include <script/script.h>
 #include <script/signingprovider.h>
+#include <sync.h>
 #include <txmempool.h>
 #include <univalue.h>
 #include <util/strencodings.h>
@@ -42,13 +48,19 @@
 #include <validationinterface.h>
 #include <warnings.h>
 
+#include <algorithm>
+#include <deque>
+#include <map>
 #include <memory>
 #include <stdint.h>
 
 using node::BlockAssembler;
 using node::CBlockTemplate;
+using node::DEFAULT_MINER_THREADS;
+using node::MAX_MINER_THREADS;
 using node::NodeContext;
 using node::RegenerateCommitments;
+using node::SearchProofOfWork;
 using node::UpdateTime;
 
 /**
@@ -128,24 +140,25 @@ static RPCHelpMan getnetworkhashps()
     };
 }
 
-static bool GenerateBlock(ChainstateManager& chainman, CBlock& block, uint64_t& max_tries, std::shared_ptr<const CBlock>& block_out, bool process_new_block)
+/** Number of threads the generate RPCs search nonces with, from -minerthreads. */
+static int GetMinerThreads(const NodeContext& node)
+{
+    const int64_t threads{node.args ? node.args->GetIntArg("-minerthreads", DEFAULT_MINER_THREADS) : DEFAULT_MINER_THREADS};
+    if (threads <= 0) return std::max(GetNumCores(), 1);
+    return std::min<int64_t>(threads, MAX_MINER_THREADS);
+}
+
+static bool GenerateBlock(ChainstateManager& chainman, CBlock& block, uint64_t& max_tries, int num_threads, std::shared_ptr<const CBlock>& block_out, bool process_new_block)
 {
     block_out.reset();
     block.hashMerkleRoot = BlockMerkleRoot(block);
 
-    uint256 hashMix;
-    while (max_tries > 0 && block.nNonce < std::numeric_limits<uint64_t>::max() && !CheckProofOfWork(block.GetHash(hashMix), block.nBits, chainman.GetConsensus()) && !chainman.m_interrupt) {
-        ++block.nNonce;
-        --max_tries;
-    }
-    if (max_tries == 0 || chainman.m_interrupt) {
-        return false;
-    }
-    if (block.nNonce == std::numeric_limits<uint64_t>::max()) {
-        return true;
+    if (!SearchProofOfWork(block, chainman.GetConsensus(), max_tries, num_threads, chainman.m_interrupt)) {
+        // Out of tries, interrupted, or out of nonces: in the last case the
+        // caller retries with a new template.
+        return max_tries > 0 && !chainman.m_interrupt;
     }
 
-    block.hashMix = hashMix;
     block_out = std::make_shared<const CBlock>(block);
 
     if (!process_new_block) return true;
@@ -157,7 +170,7 @@ static bool GenerateBlock(ChainstateManager& chainman, CBlock& block, uint64_t&
     return true;
 }
 
-static UniValue generateBlocks(ChainstateManager& chainman, const CTxMemPool& mempool, const CScript& coinbase_script, int nGenerate, uint64_t nMaxTries)
+static UniValue generateBlocks(ChainstateManager& chainman, const CTxMemPool& mempool, const CScript& coinbase_script, int nGenerate, uint64_t nMaxTries, int num_threads)
 {
     UniValue blockHashes(UniValue::VARR);
     while (nGenerate > 0 && !chainman.m_interrupt) {
@@ -166,7 +179,7 @@ static UniValue generateBlocks(ChainstateManager& chainman, const CTxMemPool& me
             throw JSONRPCError(RPC_INTERNAL_ERROR, "Couldn't create new block");
 
         std::shared_ptr<const CBlock> block_out;
-        if (!GenerateBlock(chainman, pblocktemplate->block, nMaxTries, block_out, /*process_new_block=*/true)) {
+        if (!GenerateBlock(chainman, pblocktemplate->block, nMaxTries, num_threads, block_out, /*process_new_block=*/true)) {
             break;
         }
 
@@ -245,7 +258,7 @@ static RPCHelpMan generatetodescriptor()
     const CTxMemPool& mempool = EnsureMemPool(node);
     ChainstateManager& chainman = EnsureChainman(node);
 
-    return generateBlocks(chainman, mempool, coinbase_script, num_blocks, max_tries);
+    return generateBlocks(chainman, mempool, coinbase_script, num_blocks, max_tries, GetMinerThreads(node));
 },
     };
 }
@@ -293,7 +306,7 @@ static RPCHelpMan generatetoaddress()
 
     CScript coinbase_script = GetScriptForDestination(destination);
 
-    return generateBlocks(chainman, mempool, coinbase_script, num_blocks, max_tries);
+    return generateBlocks(chainman, mempool, coinbase_script, num_blocks, max_tries, GetMinerThreads(node));
 },
     };
 }
@@ -398,7 +411,7 @@ static RPCHelpMan generateblock()
     std::shared_ptr<const CBlock> block_out;
     uint64_t max_tries{DEFAULT_MAX_TRIES};
 
-    if (!GenerateBlock(chainman, block, max_tries, block_out, process_new_block) || !block_out) {
+    if (!GenerateBlock(chainman, block, max_tries, GetMinerThreads(node), block_out, process_new_block) || !block_out) {
         throw JSONRPCError(RPC_MISC_ERROR, "Failed to make block.");
     }
 
@@ -428,6 +441,29 @@ static RPCHelpMan getmininginfo()
                         {RPCResult::Type::NUM, "difficulty", "The current difficulty"},
                         {RPCResult::Type::NUM, "networkhashps", "The network hashes per second"},
                         {RPCResult::Type::NUM, "pooledtx", "The size of the mempool"},
+                        {RPCResult::Type::NUM, "templaterebuilds", /*optional=*/true, "The number of block templates built in the background (only present if -blocktemplatebuilder is enabled)"},
+                        {RPCResult::Type::NUM, "templateage", /*optional=*/true, "Seconds since the current background block template was built (only present if there is one)"},
+                        {RPCResult::Type::NUM, "templatebuildtime", /*optional=*/true, "Milliseconds it took to build the current background block template (only present if there is one)"},
+                        {RPCResult::Type::OBJ, "powmemory", "How the ProgPoW memory allocated most recently is backed",
+                        {
+                            {RPCResult::Type::OBJ, "epochcontext", "Light cache and L1 cache",
+                            {
+                                {RPCResult::Type::STR, "mode", "none (nothing allocated yet), heap, pages, transparent_huge_pages or huge_pages"},
+                                {RPCResult::Type::NUM, "numanode", /*optional=*/true, "The NUMA node the memory is bound to (only present if it is bound)"},
+                            }},
+                            {RPCResult::Type::OBJ, "dataset", "Dataset of the current epoch (see -powdag)",
+                            {
+                                {RPCResult::Type::STR, "mode", "Same as above"},
+                                {RPCResult::Type::NUM, "numanode", /*optional=*/true, "Same as above"},
+                            }},
+                        }},
+                        {RPCResult::Type::OBJ, "powitemcache", /*optional=*/true, "Dataset items kept for proof-of-work verification (only present if -powitemcache is enabled)",
+                        {
+                            {RPCResult::Type::NUM, "size", "The maximum size of the cached items in bytes"},
+                            {RPCResult::Type::NUM, "hits", "Items found in the cache"},
+                            {RPCResult::Type::NUM, "misses", "Items computed from the light cache"},
+                            {RPCResult::Type::NUM, "hitrate", "hits / (hits + misses), 0 before the first lookup"},
+                        }},
                         {RPCResult::Type::STR, "chain", "current network name (main, test, regtest)"},
                         {RPCResult::Type::STR, "warnings", "any network and blockchain warnings"},
                     }},
@@ -450,6 +486,31 @@ static RPCHelpMan getmininginfo()
     obj.pushKV("difficulty", GetDifficulty(*CHECK_NONFATAL(active_chain.Tip())));
     obj.pushKV("networkhashps",    getnetworkhashps().HandleRequest(request));
     obj.pushKV("pooledtx",         (uint64_t)mempool.size());
+    if (node.template_builder) {
+        const auto stats{node.template_builder->GetStats()};
+        obj.pushKV("templaterebuilds", stats.rebuilds);
+        if (stats.built_time) {
+            obj.pushKV("templateage", Ticks<SecondsDouble>(SteadyClock::now() - *stats.built_time));
+            obj.pushKV("templatebuildtime", Ticks<MillisecondsDouble>(stats.build_duration));
+        }
+    }
+    UniValue pow_memory(UniValue::VOBJ);
+    for (const auto& [name, use] : {std::pair{"epochcontext", ethash::memory_use::epoch_context}, std::pair{"dataset", ethash::memory_use::dataset}}) {
+        const ethash::memory_info info{ethash::get_memory_info(use)};
+        UniValue entry(UniValue::VOBJ);
+        entry.pushKV("mode", ethash::memory_mode_name(info.mode));
+        if (info.numa_node >= 0) entry.pushKV("numanode", info.numa_node);
+        pow_memory.pushKV(name, entry);
+    }
+    obj.pushKV("powmemory", pow_memory);
+    if (const progpow::item_cache_stats item_cache{progpow::get_item_cache_stats()}; item_cache.size > 0) {
+        UniValue entry(UniValue::VOBJ);
+        entry.pushKV("size", item_cache.size);
+        entry.pushKV("hits", item_cache.hits);
+        entry.pushKV("misses", item_cache.misses);
+        entry.pushKV("hitrate", item_cache.hits + item_cache.misses > 0 ? double(item_cache.hits) / (item_cache.hits + item_cache.misses) : 0.0);
+        obj.pushKV("powitemcache", entry);
+    }
     obj.pushKV("chain", chainman.GetParams().GetChainTypeString());
     obj.pushKV("warnings",         GetWarnings(false).original);
     return obj;
@@ -791,8 +852,21 @@ static RPCHelpMan getblocktemplate()
     static CBlockIndex* pindexPrev;
     static int64_t time_start;
     static std::unique_ptr<CBlockTemplate> pblocktemplate;
+    static std::shared_ptr<const CBlockTemplate> built_template;
+    if (node.template_builder) {
+        // Use the background template if it is newer than ours; it is at most
+        // TEMPLATE_REBUILD_INTERVAL behind the mempool.
+        auto [block_template, transactions_updated] = node.template_builder->GetTemplate(active_chain.Tip());
+        if (block_template && block_template != built_template) {
+            built_template = std::move(block_template);
+            pblocktemplate = std::make_unique<CBlockTemplate>(*built_template);
+            pindexPrev = active_chain.Tip();
+            nTransactionsUpdatedLast = transactions_updated;
+            time_start = GetTime();
+        }
+    }
     if (pindexPrev != active_chain.Tip() ||
-        (mempool.GetTransactionsUpdated() != nTransactionsUpdatedLast && GetTime() - time_start > 5))
+        (!node.template_builder && mempool.GetTransactionsUpdated() != nTransactionsUpdatedLast && GetTime() - time_start > 5))
     {
         // Clear pindexPrev so future calls make a new block, despite any failures from here on
         pindexPrev = nullptr;
@@ -1000,6 +1074,7 @@ static RPCHelpMan submitblock()
     if (!DecodeHexBlk(block, request.params[0].get_str())) {
         throw JSONRPCError(RPC_DESERIALIZATION_ERROR, "Block decode failed");
     }
+    block.CacheHashes();
 
     if (block.vtx.empty() || !block.vtx[0]->IsCoinBase()) {
         throw JSONRPCError(RPC_DESERIALIZATION_ERROR, "Block does not start with a coinbase");
@@ -1083,6 +1158,187 @@ static RPCHelpMan submitheader()
     };
 }
 
+namespace {
+/** Maximum number of blocks getprogpowwork keeps for submitprogpowwork. */
+constexpr size_t MAX_PROGPOW_WORK{64};
+
+/**
+ * Blocks handed out by getprogpowwork, by header hash, so that a solution can
+ * be submitted without sending the block back. All of them build on the same
+ * tip; they are dropped when it changes.
+ */
+struct ProgPowWork {
+    Mutex m_mutex;
+    const CBlockIndex* m_prev GUARDED_BY(m_mutex){nullptr};
+    CScript m_coinbase_script GUARDED_BY(m_mutex);
+    unsigned int m_transactions_updated GUARDED_BY(m_mutex){0};
+    int64_t m_time_start GUARDED_BY(m_mutex){0};
+    std::unique_ptr<CBlockTemplate> m_template GUARDED_BY(m_mutex);
+    std::map<uint256, std::shared_ptr<const CBlock>> m_blocks GUARDED_BY(m_mutex);
+    std::deque<uint256> m_order GUARDED_BY(m_mutex);
+};
+ProgPowWork g_progpow_work;
+} // namespace
+
+static RPCHelpMan getprogpowwork()
+{
+    return RPCHelpMan{"getprogpowwork",
+        "\nReturns the ProgPoW work for a new block paying to an address: the values a miner needs,\n"
+        "without the block itself. The block is kept by the node; submit a solution for it with\n"
+        "submitprogpowwork. Work is valid until the chain tip changes.\n",
+        {
+            {"address", RPCArg::Type::STR, RPCArg::Optional::NO, "The address to send the newly generated coins to."},
+        },
+        RPCResult{
+            RPCResult::Type::OBJ, "", "",
+            {
+                {RPCResult::Type::STR_HEX, "header_hash", "The hash of the header without nonce and mix, the ProgPoW input"},
+                {RPCResult::Type::STR_HEX, "seed_hash", "The seed hash of the ProgPoW epoch"},
+                {RPCResult::Type::STR_HEX, "target", "The hash target"},
+                {RPCResult::Type::STR_HEX, "bits", "The compressed target of the block"},
+                {RPCResult::Type::NUM, "height", "The height of the block"},
+            }},
+        RPCExamples{
+            HelpExampleCli("getprogpowwork", "\"myaddress\"")
+            + HelpExampleRpc("getprogpowwork", "\"myaddress\"")
+        },
+        [&](const RPCHelpMan& self, const JSONRPCRequest& request) -> UniValue
+{
+    const CTxDestination destination = DecodeDestination(request.params[0].get_str());
+    if (!IsValidDestination(destination)) {
+        throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Error: Invalid address");
+    }
+    const CScript coinbase_script = GetScriptForDestination(destination);
+
+    NodeContext& node = EnsureAnyNodeContext(request.context);
+    ChainstateManager& chainman = EnsureChainman(node);
+    const CTxMemPool& mempool = EnsureMemPool(node);
+
+    if (!chainman.GetParams().IsTestChain()) {
+        const CConnman& connman = EnsureConnman(node);
+        if (connman.GetNodeCount(ConnectionDirection::Both) == 0) {
+            throw JSONRPCError(RPC_CLIENT_NOT_CONNECTED, PACKAGE_NAME " is not connected!");
+        }
+
+        if (chainman.IsInitialBlockDownload()) {
+            throw JSONRPCError(RPC_CLIENT_IN_INITIAL_DOWNLOAD, PACKAGE_NAME " is in initial sync and waiting for blocks...");
+        }
+    }
+
+    LOCK2(cs_main, g_progpow_work.m_mutex);
+    const CBlockIndex* tip{chainman.ActiveChain().Tip()};
+    if (g_progpow_work.m_prev != tip) {
+        g_progpow_work.m_blocks.clear();
+        g_progpow_work.m_order.clear();
+    }
+    // Same refresh policy as getblocktemplate.
+    if (g_progpow_work.m_prev != tip || g_progpow_work.m_coinbase_script != coinbase_script ||
+        (mempool.GetTransactionsUpdated() != g_progpow_work.m_transactions_updated && GetTime() - g_progpow_work.m_time_start > 5)) {
+        g_progpow_work.m_prev = nullptr;
+        g_progpow_work.m_transactions_updated = mempool.GetTransactionsUpdated();
+        g_progpow_work.m_time_start = GetTime();
+        g_progpow_work.m_template = BlockAssembler{chainman.ActiveChainstate(), &mempool}.CreateNewBlock(coinbase_script);
+        if (!g_progpow_work.m_template) {
+            throw JSONRPCError(RPC_OUT_OF_MEMORY, "Out of memory");
+        }
+        g_progpow_work.m_coinbase_script = coinbase_script;
+        g_progpow_work.m_prev = tip;
+    }
+
+    auto block{std::make_shared<CBlock>(g_progpow_work.m_template->block)};
+    UpdateTime(block.get(), chainman.GetConsensus(), tip);
+    block->hashMerkleRoot = BlockMerkleRoot(*block);
+    block->nNonce = 0;
+    block->hashMix.SetNull();
+    const uint256 header_hash{block->GetHeaderHash()};
+    if (g_progpow_work.m_blocks.emplace(header_hash, block).second) {
+        g_progpow_work.m_order.push_back(header_hash);
+        if (g_progpow_work.m_order.size() > MAX_PROGPOW_WORK) {
+            g_progpow_work.m_blocks.erase(g_progpow_work.m_order.front());
+            g_progpow_work.m_order.pop_front();
+        }
+    }
+
+    const ethash::hash256 seed{ethash::calculate_epoch_seed(ethash::get_epoch_number(block->nHeight))};
+    UniValue result(UniValue::VOBJ);
+    result.pushKV("header_hash", header_hash.GetHex());
+    result.pushKV("seed_hash", HexStr(seed.bytes));
+    result.pushKV("target", ArithToUint256(arith_uint256().SetCompact(block->nBits)).GetHex());
+    result.pushKV("bits", strprintf("%08x", block->nBits));
+    result.pushKV("height", block->nHeight);
+    return result;
+},
+    };
+}
+
+static RPCHelpMan submitprogpowwork()
+{
+    return RPCHelpMan{"submitprogpowwork",
+        "\nSubmits a ProgPoW solution for work returned by getprogpowwork.\n"
+        "The final hash is checked against the target before the block is assembled and processed.\n",
+        {
+            {"header_hash", RPCArg::Type::STR_HEX, RPCArg::Optional::NO, "The header_hash returned by getprogpowwork"},
+            {"nonce", RPCArg::Type::STR_HEX, RPCArg::Optional::NO, "The nonce, as 16 hex digits"},
+            {"mix_hash", RPCArg::Type::STR_HEX, RPCArg::Optional::NO, "The mix hash"},
+        },
+        {
+            RPCResult{"If the block was accepted", RPCResult::Type::NONE, "", ""},
+            RPCResult{"Otherwise", RPCResult::Type::STR, "", "According to BIP22"},
+        },
+        RPCExamples{
+            HelpExampleCli("submitprogpowwork", "\"headerhash\" \"0123456789abcdef\" \"mixhash\"")
+            + HelpExampleRpc("submitprogpowwork", "\"headerhash\", \"0123456789abcdef\", \"mixhash\"")
+        },
+        [&](const RPCHelpMan& self, const JSONRPCRequest& request) -> UniValue
+{
+    const uint256 header_hash{ParseHashV(request.params[0], "header_hash")};
+    const std::string& nonce_hex{request.params[1].get_str()};
+    if (nonce_hex.size() != 16 || !IsHex(nonce_hex)) {
+        throw JSONRPCError(RPC_INVALID_PARAMETER, "nonce must be 16 hex digits");
+    }
+    uint64_t nonce{0};
+    for (const uint8_t byte : ParseHex(nonce_hex)) nonce = (nonce << 8) | byte;
+    const uint256 mix{ParseHashV(request.params[2], "mix_hash")};
+
+    ChainstateManager& chainman = EnsureAnyChainman(request.context);
+    std::shared_ptr<const CBlock> work;
+    {
+        LOCK2(cs_main, g_progpow_work.m_mutex);
+        const auto it{g_progpow_work.m_blocks.find(header_hash)};
+        // The kept blocks are only dropped by the next getprogpowwork call.
+        if (it == g_progpow_work.m_blocks.end() || g_progpow_work.m_prev != chainman.ActiveChain().Tip()) {
+            throw JSONRPCError(RPC_INVALID_PARAMETER, "Unknown or stale header_hash");
+        }
+        work = it->second;
+    }
+
+    // The final hash costs two Keccak permutations; the mix is only
+    // recomputed by ProcessNewBlock() for solutions meeting the target.
+    const ethash::hash256 final_hash{progpow::hash_no_verify(work->nHeight, ToEthashHash256(header_hash), ToEthashHash256(mix), nonce)};
+    if (!CheckProofOfWork(FromEthashHash256(final_hash), work->nBits, chainman.GetConsensus())) {
+        return "high-hash";
+    }
+
+    auto blockptr{std::make_shared<CBlock>(*work)};
+    blockptr->nNonce = nonce;
+    blockptr->hashMix = mix;
+
+    bool new_block;
+    auto sc = std::make_shared<submitblock_StateCatcher>(blockptr->GetHash());
+    RegisterSharedValidationInterface(sc);
+    bool accepted = chainman.ProcessNewBlock(blockptr, /*force_processing=*/true, /*min_pow_checked=*/true, /*new_block=*/&new_block);
+    UnregisterSharedValidationInterface(sc);
+    if (!new_block && accepted) {
+        return "duplicate";
+    }
+    if (!sc->found) {
+        return "inconclusive";
+    }
+    return BIP22ValidationResult(sc->state);
+},
+    };
+}
+
 void RegisterMiningRPCCommands(CRPCTable& t)
 {
     static const CRPCCommand commands[]{
@@ -1093,6 +1349,8 @@ void RegisterMiningRPCCommands(CRPCTable& t)
         {"mining", &getblocktemplate},
         {"mining", &submitblock},
         {"mining", &submitheader},
+        {"mining", &getprogpowwork},
+        {"mining", &submitprogpowwork},
 
         {"hidden", &generatetoaddress},
         {"hidden", &generatetodescriptor},
@@ -364,6 +364,22 @@ BOOST_AUTO_TEST_CASE( divide )
     BOOST_CHECK_THROW(R2L / ZeroL, uint_error);
 }
 
+BOOST_AUTO_TEST_CASE(divide_single_limb)
+{
+    // Single-limb divisors take a separate path; check it against the
+    // definition of division.
+    for (const arith_uint256& num : {R1L, R2L, MaxL, HalfL, OneL, ZeroL}) {
+        for (const uint32_t d : {1U, 2U, 3U, 7U, 20U, 21U, 0x10000U, 0xfffffffbU, 0xffffffffU}) {
+            const arith_uint256 div{d};
+            const arith_uint256 quot{num / div};
+            const arith_uint256 rem{num - quot * div};
+            BOOST_CHECK(rem < div);
+            BOOST_CHECK(quot * div + rem == num);
+        }
+    }
+    BOOST_CHECK((R1L / arith_uint256{20}).ToString() == "06417eb22615aabddc1a0c0295e2200e8a8a82ab1180e8755a80ddf0caf6ea87");
+}
+
 
 static bool almostEqual(double d1, double d2)
 {
@@ -15,6 +15,7 @@
 #include <undo.h>
 #include <util/strencodings.h>
 
+#include <future>
 #include <map>
 #include <vector>
 
@@ -1085,6 +1086,127 @@ BOOST_AUTO_TEST_CASE(ccoins_flush_behavior)
     }
 }
 
+BOOST_AUTO_TEST_CASE(ccoins_prefetch)
+{
+    CCoinsViewTest base;
+    CCoinsViewPrefetch prefetch{&base};
+    const auto& stage{prefetch.GetStage()};
+    const COutPoint a{Txid::FromUint256(InsecureRand256()), 0};
+    const COutPoint b{Txid::FromUint256(InsecureRand256()), 1};
+    const COutPoint c{Txid::FromUint256(InsecureRand256()), 2};
+    {
+        CCoinsViewCacheTest cache{&base};
+        cache.AddCoin(a, Coin{CTxOut{1000, CScript{} << OP_TRUE}, 1, false}, false);
+        cache.AddCoin(c, Coin{CTxOut{2000, CScript{} << OP_TRUE}, 1, false}, false);
+        cache.Flush();
+    }
+
+    // Only coins in the view below are kept, and each one is handed out once.
+    stage->Fetch({a, b});
+    BOOST_CHECK_EQUAL(stage->GetStats().fetched, 1U);
+    {
+        CCoinsViewCacheTest cache{&prefetch};
+        BOOST_CHECK(cache.HaveCoin(a));
+        BOOST_CHECK(!cache.HaveCoin(b));
+        BOOST_CHECK_EQUAL(stage->GetStats().used, 1U);
+
+        // A coin read before the cache writes back may be stale, so it is dropped.
+        stage->Fetch({a});
+        BOOST_CHECK_EQUAL(stage->GetStats().fetched, 2U);
+        BOOST_CHECK(cache.SpendCoin(a));
+        cache.Flush();
+    }
+    {
+        CCoinsViewCacheTest cache{&prefetch};
+        BOOST_CHECK(!cache.HaveCoin(a));
+        BOOST_CHECK_EQUAL(stage->GetStats().used, 1U);
+    }
+
+    // Nothing is read while paused.
+    prefetch.PauseFetching();
+    stage->Fetch({c});
+    BOOST_CHECK_EQUAL(stage->GetStats().fetched, 2U);
+    prefetch.ResumeFetching();
+    stage->Fetch({c});
+    BOOST_CHECK_EQUAL(stage->GetStats().fetched, 3U);
+}
+
+BOOST_AUTO_TEST_CASE(ccoins_background_flush)
+{
+    //! Holds writes until released
+    class BlockingCoinsView : public CCoinsViewTest
+    {
+    public:
+        std::promise<void> release;
+        std::shared_future<void> released{release.get_future().share()};
+        bool fail{false};
+
+        bool BatchWrite(CCoinsMap& mapCoins, const uint256& hashBlock, bool erase) override
+        {
+            released.wait();
+            return !fail && CCoinsViewTest::BatchWrite(mapCoins, hashBlock, erase);
+        }
+    };
+
+    const COutPoint a{Txid::FromUint256(InsecureRand256()), 0};
+    const COutPoint b{Txid::FromUint256(InsecureRand256()), 1};
+    const uint256 block1{InsecureRand256()};
+    const uint256 block2{InsecureRand256()};
+    BlockingCoinsView base;
+    CCoinsViewBackgroundFlush flush{&base, /*background=*/true};
+    {
+        CCoinsViewCacheTest cache{&flush};
+        cache.AddCoin(a, Coin{CTxOut{1000, CScript{} << OP_TRUE}, 1, false}, false);
+        cache.AddCoin(b, Coin{CTxOut{2000, CScript{} << OP_TRUE}, 1, false}, false);
+        cache.SetBestBlock(block1);
+        flush.AllowBackgroundWrite();
+        BOOST_CHECK(cache.Flush());
+        BOOST_CHECK_EQUAL(cache.GetCacheSize(), 0U);
+
+        // The coins are read from the pending write until it is done.
+        BOOST_CHECK(flush.GetStats().pending);
+        BOOST_CHECK(flush.GetBestBlock() == block1);
+        BOOST_CHECK(base.GetBestBlock().IsNull());
+        BOOST_CHECK(cache.HaveCoin(a));
+        BOOST_CHECK(cache.SpendCoin(b));
+        cache.SetBestBlock(block2);
+
+        base.release.set_value();
+        BOOST_CHECK(flush.WaitForFlush());
+        BOOST_CHECK(!flush.GetStats().pending);
+        BOOST_CHECK(base.GetBestBlock() == block1);
+        CCoinsViewCacheTest base_cache{&base};
+        BOOST_CHECK(base_cache.HaveCoin(a));
+        BOOST_CHECK(base_cache.HaveCoin(b));
+
+        // Writes that were not allowed to happen in the background are done on return.
+        BOOST_CHECK(cache.Flush());
+        BOOST_CHECK(base.GetBestBlock() == block2);
+        BOOST_CHECK(!CCoinsViewCacheTest{&base}.HaveCoin(b));
+    }
+    auto stats{flush.GetStats()};
+    BOOST_CHECK_EQUAL(stats.flushes, 2U);
+    BOOST_CHECK_EQUAL(stats.coins, 3U);
+    BOOST_CHECK(!stats.pending);
+
+    // After a failed write the coins are still read from it, but nothing more is written.
+    base.fail = true;
+    {
+        CCoinsViewCacheTest cache{&flush};
+        cache.AddCoin(b, Coin{CTxOut{3000, CScript{} << OP_TRUE}, 2, false}, false);
+        cache.SetBestBlock(block1);
+        flush.AllowBackgroundWrite();
+        BOOST_CHECK(cache.Flush());
+        BOOST_CHECK(!flush.WaitForFlush());
+        BOOST_CHECK(flush.GetStats().pending);
+        BOOST_CHECK_EQUAL(cache.AccessCoin(b).out.nValue, 3000);
+        cache.SetBestBlock(block2);
+        BOOST_CHECK(cache.SpendCoin(b));
+        BOOST_CHECK(!cache.Flush());
+    }
+}
+
+#ifndef USE_FLAT_COINS_MAP
 BOOST_AUTO_TEST_CASE(coins_resource_is_used)
 {
     CCoinsMapMemoryResource resource;
@@ -1109,5 +1231,6 @@ BOOST_AUTO_TEST_CASE(coins_resource_is_used)
 
     PoolResourceTester::CheckAllDataAccountedFor(resource);
 }
+#endif // USE_FLAT_COINS_MAP
 
 BOOST_AUTO_TEST_SUITE_END()
@@ -5,13 +5,24 @@
 #include <boost/test/unit_test.hpp>
 #include <test/util/setup_common.h>
 
+#include <arith_uint256.h>
+#include <hash.h>
+#include <node/progpow_cache.h>
+#include <primitives/block.h>
+#include <uint256.h>
+
 #include <crypto/ethash/lib/ethash/endianness.hpp>
+#include <crypto/ethash/include/ethash/keccak.hpp>
 #include <crypto/ethash/include/ethash/progpow.hpp>
 
 #include <crypto/ethash/helpers.hpp>
 #include <crypto/ethash/ethash_test_vectors.hpp>
 
 #include <array>
+#include <cstdio>
+#include <cstring>
+#include <thread>
+#include <vector>
 
 BOOST_FIXTURE_TEST_SUITE(ethash_tests, TestingSetup)
 
@@ -53,6 +64,82 @@ BOOST_AUTO_TEST_CASE(ethash_hash_empty)
     BOOST_CHECK_EQUAL(to_hex(result.final_hash), final_hex);
 }
 
+BOOST_AUTO_TEST_CASE(progpow_program_cache)
+{
+    auto& context = get_ethash_epoch_context_0();
+
+    // Hashing in a different period in between must not leave a stale program
+    // behind, and hashing the same period twice must not change the result.
+    const auto expected = progpow::hash(context, 30, {}, 5);
+    const auto other = progpow::hash(context, 33, {}, 5);
+    BOOST_CHECK(to_hex(expected.hashMix) != to_hex(other.hashMix));
+    const auto result = progpow::hash(context, 31, {}, 5);
+    BOOST_CHECK_EQUAL(to_hex(result.hashMix), to_hex(expected.hashMix));
+    BOOST_CHECK_EQUAL(to_hex(result.final_hash), to_hex(expected.final_hash));
+    BOOST_CHECK_EQUAL(to_hex(progpow::hash(context, 34, {}, 5).hashMix), to_hex(other.hashMix));
+}
+
+BOOST_AUTO_TEST_CASE(progpow_mix_implementations)
+{
+    auto& context = get_ethash_epoch_context_0();
+
+    std::vector<ethash::result> expected;
+    for (const bool use_simd : {false, true}) {
+        BOOST_TEST_MESSAGE("Using the " << progpow::select_mix_implementation(use_simd) << " mix implementation");
+        for (auto& t : ethash_hash_test_cases) {
+            if (ethash::get_epoch_number(t.blockNumber) != 0) continue;
+            const auto result = progpow::hash(context, t.blockNumber, to_hash256(t.headerHash), std::stoull(t.nonce, nullptr, 16));
+            BOOST_CHECK_EQUAL(to_hex(result.hashMix), t.hashMix);
+            BOOST_CHECK_EQUAL(to_hex(result.final_hash), t.finalHash);
+        }
+
+        // Every math and merge selector occurs within a few periods.
+        ethash::hash256 header{};
+        for (int block_number = 0; block_number < 3 * 16; block_number += 3) {
+            header.word32s[0] = block_number;
+            const auto result = progpow::hash(context, block_number, header, 0x5eed0000 + block_number);
+            if (!use_simd) {
+                expected.push_back(result);
+            } else {
+                BOOST_CHECK_EQUAL(to_hex(result.hashMix), to_hex(expected[block_number / 3].hashMix));
+                BOOST_CHECK_EQUAL(to_hex(result.final_hash), to_hex(expected[block_number / 3].final_hash));
+            }
+        }
+    }
+}
+
+BOOST_AUTO_TEST_CASE(ethash_keccak_batch)
+{
+    ethash::hash512 inputs[4];
+    for (int i = 0; i < 4; ++i) {
+        for (int j = 0; j < 64; ++j) inputs[i].bytes[j] = i * 64 + j;
+    }
+    std::vector<CBlockHeader> headers(13);
+    for (size_t i = 0; i < headers.size(); ++i) {
+        headers[i].nHeight = i;
+        headers[i].nTime = 1000 * i;
+        headers[i].nNonce = 0x0123456789abcdefULL * i;
+        headers[i].hashMix = ArithToUint256(arith_uint256(i * 7919));
+    }
+
+    for (const bool use_simd : {false, true}) {
+        BOOST_TEST_MESSAGE("Using the " << ethash::select_keccak_implementation(use_simd) << " Keccak implementation");
+
+        ethash::hash512 outputs[4];
+        ethash::keccak512_x4(outputs, inputs);
+        for (int i = 0; i < 4; ++i) {
+            BOOST_CHECK_EQUAL(to_hex(outputs[i]), to_hex(ethash::keccak512(inputs[i])));
+        }
+
+        // More than one batch, the last one partial.
+        const std::vector<uint256> hashes{ETHashBatch(headers)};
+        BOOST_REQUIRE_EQUAL(hashes.size(), headers.size());
+        for (size_t i = 0; i < headers.size(); ++i) {
+            BOOST_CHECK_EQUAL(hashes[i], ETHash(headers[i]));
+        }
+    }
+}
+
 BOOST_AUTO_TEST_CASE(ethash_hash_30000)
 {
     const int blockNumber = 30000;
@@ -104,6 +191,202 @@ BOOST_AUTO_TEST_CASE(ethash_hash_and_verify)
     }
 }
 
+BOOST_AUTO_TEST_CASE(ethash_uint256_bridge)
+{
+    for (const auto& t : ethash_hash_test_cases)
+    {
+        // The binary bridge must agree with the GetHex()/to_hash256() round-trip.
+        const uint256 header = uint256S(t.headerHash);
+        const auto header_hash = ToEthashHash256(header);
+        BOOST_CHECK(header_hash == to_hash256(header.GetHex()));
+        BOOST_CHECK_EQUAL(to_hex(header_hash), t.headerHash);
+        BOOST_CHECK(FromEthashHash256(header_hash) == header);
+        BOOST_CHECK(FromEthashHash256(to_hash256(t.finalHash)) == uint256S(t.finalHash));
+    }
+}
+
+BOOST_AUTO_TEST_CASE(ethash_shared_epoch_context)
+{
+    // Concurrent callers share a single context per epoch.
+    std::vector<ethash::epoch_context_shared_ptr> contexts(4);
+    std::vector<std::thread> threads;
+    for (auto& context : contexts) {
+        threads.emplace_back([&context] { context = ethash::get_epoch_context(1); });
+    }
+    for (auto& thread : threads) thread.join();
+    for (const auto& context : contexts) {
+        BOOST_REQUIRE(context);
+        BOOST_CHECK_EQUAL(context->epoch_number, 1);
+        BOOST_CHECK_EQUAL(context.get(), contexts.front().get());
+    }
+
+    // A prebuilt context is handed out once ready and hashes like a fresh one.
+    ethash::prebuild_epoch_context(2);
+    const auto prebuilt = ethash::get_epoch_context(2);
+    BOOST_REQUIRE(prebuilt);
+    BOOST_CHECK_EQUAL(prebuilt->epoch_number, 2);
+    BOOST_CHECK_EQUAL(prebuilt.get(), ethash::get_epoch_context(2).get());
+
+    const int block_number = 2 * ethash::epoch_length + 17;
+    const auto fresh = ethash::create_epoch_context(2);
+    const auto expected = progpow::hash(*fresh, block_number, {}, 42);
+    const auto result = progpow::hash(*prebuilt, block_number, {}, 42);
+    BOOST_CHECK(result.final_hash == expected.final_hash);
+    BOOST_CHECK(result.hashMix == expected.hashMix);
+}
+
+BOOST_AUTO_TEST_CASE(ethash_epoch_context_residency)
+{
+    // Building a context on first use counts as a miss, later uses do not count.
+    const auto before = ethash::get_epoch_context_stats();
+    const auto context = ethash::get_epoch_context(5);
+    BOOST_REQUIRE(context);
+    BOOST_CHECK_EQUAL(ethash::get_epoch_context_stats().misses, before.misses + 1);
+    BOOST_CHECK_EQUAL(ethash::get_epoch_context(5).get(), context.get());
+    BOOST_CHECK_EQUAL(ethash::get_epoch_context_stats().misses, before.misses + 1);
+    BOOST_CHECK_EQUAL(ethash::get_epoch_context_stats().hits, before.hits);
+
+    // Shrinking the resident set keeps the most recently used context only.
+    ethash::get_epoch_context(4);
+    ethash::set_max_resident_epoch_contexts(1);
+    const auto recent = ethash::get_epoch_context_stats();
+    BOOST_CHECK(ethash::get_epoch_context(4));
+    BOOST_CHECK_EQUAL(ethash::get_epoch_context_stats().misses, recent.misses);
+    BOOST_CHECK(ethash::get_epoch_context(5));
+    BOOST_CHECK_EQUAL(ethash::get_epoch_context_stats().misses, recent.misses + 1);
+    ethash::set_max_resident_epoch_contexts(ethash::default_max_resident_epoch_contexts);
+}
+
+BOOST_AUTO_TEST_CASE(ethash_epoch_file)
+{
+    const fs::path dir{m_path_root / "progpow"};
+    const auto context = ethash::create_epoch_context(0);
+    BOOST_REQUIRE(node::WriteProgPowEpochFile(dir, *context));
+
+    const auto loaded = node::ReadProgPowEpochFile(dir, 0);
+    BOOST_REQUIRE(loaded);
+    BOOST_CHECK_EQUAL(loaded->epoch_number, 0);
+    BOOST_CHECK_EQUAL(loaded->light_cache_num_items, context->light_cache_num_items);
+    BOOST_CHECK_EQUAL(loaded->full_dataset_num_items, context->full_dataset_num_items);
+    BOOST_CHECK(std::memcmp(loaded->l1_cache, context->l1_cache, progpow::l1_cache_size) == 0);
+    const auto expected = progpow::hash(*context, 1000, {}, 7);
+    const auto result = progpow::hash(*loaded, 1000, {}, 7);
+    BOOST_CHECK(result.final_hash == expected.final_hash);
+    BOOST_CHECK(result.hashMix == expected.hashMix);
+
+    // Missing epochs are not found.
+    BOOST_CHECK(!node::ReadProgPowEpochFile(dir, 1));
+
+    // A corrupted file fails the checksum and is removed.
+    const fs::path path{dir / "epoch-0.bin"};
+    FILE* file{fsbridge::fopen(path, "r+b")};
+    BOOST_REQUIRE(file);
+    BOOST_REQUIRE_EQUAL(std::fseek(file, 4096, SEEK_SET), 0);
+    const int byte{std::fgetc(file)};
+    BOOST_REQUIRE_EQUAL(std::fseek(file, 4096, SEEK_SET), 0);
+    BOOST_REQUIRE(std::fputc(byte ^ 0xff, file) != EOF);
+    std::fclose(file);
+    BOOST_CHECK(!node::ReadProgPowEpochFile(dir, 0));
+    BOOST_CHECK(!fs::exists(path));
+}
+
+BOOST_AUTO_TEST_CASE(progpow_epoch_dataset)
+{
+    const auto context = ethash::get_epoch_context(0);
+    BOOST_REQUIRE(context);
+    BOOST_CHECK(!progpow::create_epoch_dataset(context, 0));
+
+    // A partial dataset: some lookups hit stored items, the rest are computed.
+    const auto dataset = progpow::create_epoch_dataset(context, 1 << 20);
+    BOOST_REQUIRE(dataset);
+    BOOST_CHECK_EQUAL(dataset->epoch_number, 0);
+    BOOST_CHECK(dataset->num_items > 0);
+    BOOST_CHECK(dataset->num_items < uint32_t(context->full_dataset_num_items / 2));
+    progpow::fill_epoch_dataset(*dataset, 0, 64);
+    BOOST_CHECK_EQUAL(dataset->num_filled.load(), 64U);
+
+    // Concurrent lookups fill the dataset without changing any result.
+    std::vector<int> matches(4, 0);
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 4; ++t) {
+        threads.emplace_back([&context, &dataset, &matches, t] {
+            for (uint64_t nonce = 0; nonce < 4; ++nonce) {
+                const auto expected = progpow::hash(*context, 100 + t, {}, nonce);
+                const auto result = progpow::hash(*dataset, 100 + t, {}, nonce);
+                matches[t] += result.final_hash == expected.final_hash && result.hashMix == expected.hashMix;
+            }
+        });
+    }
+    for (auto& thread : threads) thread.join();
+    for (int match : matches) BOOST_CHECK_EQUAL(match, 4);
+
+    const auto item = progpow::lookup_dataset_item(*dataset, 3);
+    BOOST_CHECK(std::memcmp(&item, &dataset->items[3], sizeof(item)) == 0);
+}
+
+BOOST_AUTO_TEST_CASE(ethash_memory_modes)
+{
+    // Contexts give the same results whichever pages back them.
+    ethash::set_huge_pages(false);
+    const auto regular = ethash::create_epoch_context(0);
+    const auto regular_info = ethash::get_memory_info(ethash::memory_use::epoch_context);
+    ethash::set_huge_pages(true);
+    const auto huge = ethash::create_epoch_context(0);
+    const auto huge_info = ethash::get_memory_info(ethash::memory_use::epoch_context);
+    BOOST_REQUIRE(regular && huge);
+    BOOST_CHECK(regular_info.mode != ethash::memory_mode::none);
+    BOOST_CHECK(regular_info.mode != ethash::memory_mode::huge_pages);
+    BOOST_CHECK(regular_info.mode != ethash::memory_mode::transparent_huge_pages);
+    BOOST_CHECK(huge_info.mode != ethash::memory_mode::none);
+    BOOST_CHECK(std::memcmp(regular->l1_cache, huge->l1_cache, progpow::l1_cache_size) == 0);
+    for (uint64_t nonce = 0; nonce < 4; ++nonce) {
+        const auto expected = progpow::hash(*regular, 100, {}, nonce);
+        const auto result = progpow::hash(*huge, 100, {}, nonce);
+        BOOST_CHECK(result.final_hash == expected.final_hash && result.hashMix == expected.hashMix);
+    }
+
+    const auto dataset = progpow::create_epoch_dataset(ethash::get_epoch_context(0), 1 << 20);
+    BOOST_REQUIRE(dataset);
+    BOOST_CHECK(ethash::get_memory_info(ethash::memory_use::dataset).mode != ethash::memory_mode::none);
+}
+
+BOOST_AUTO_TEST_CASE(progpow_item_cache)
+{
+    const auto context = ethash::get_epoch_context(0);
+    BOOST_REQUIRE(context);
+    const auto header_hash = to_hash256("ffeeddccbbaa9988776655443322110000112233445566778899aabbccddeeff");
+    const auto expected = progpow::hash(*context, 100, header_hash, 42);
+    const auto other = ethash::get_epoch_context(1);
+    BOOST_REQUIRE(other);
+    const auto other_expected = progpow::hash(*other, ethash::epoch_length + 100, header_hash, 42);
+    BOOST_CHECK_EQUAL(progpow::get_item_cache_stats().size, 0U);
+
+    progpow::set_item_cache_size(16 << 20);
+    const auto empty = progpow::get_item_cache_stats();
+    BOOST_CHECK(empty.size > 0 && empty.size <= 16 << 20);
+    BOOST_CHECK_EQUAL(empty.hits + empty.misses, 0U);
+
+    // Items computed for the first hash are reused by the second and by verify().
+    const auto first = progpow::hash(*context, 100, header_hash, 42);
+    const auto computed = progpow::get_item_cache_stats();
+    BOOST_CHECK(computed.misses > 0);
+    const auto second = progpow::hash(*context, 100, header_hash, 42);
+    const auto reused = progpow::get_item_cache_stats();
+    BOOST_CHECK(reused.hits > computed.hits);
+    BOOST_CHECK(progpow::verify(*context, 100, header_hash, expected.hashMix, 42, expected.final_hash));
+    BOOST_CHECK(progpow::get_item_cache_stats().hits > reused.hits);
+    for (const auto& result : {first, second}) {
+        BOOST_CHECK(result.final_hash == expected.final_hash && result.hashMix == expected.hashMix);
+    }
+
+    // Items of another epoch with the same index are not mistaken for these.
+    const auto other_result = progpow::hash(*other, ethash::epoch_length + 100, header_hash, 42);
+    BOOST_CHECK(other_result.final_hash == other_expected.final_hash);
+
+    progpow::set_item_cache_size(0);
+    BOOST_CHECK_EQUAL(progpow::get_item_cache_stats().size, 0U);
+}
+
 BOOST_AUTO_TEST_CASE(ethash_search)
 {
     auto ctxp = ethash::create_epoch_context_full(0);
@@ -0,0 +1,145 @@
+// Copyright (c) 2024 The Regus Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <coins.h>
+#include <flathashmap.h>
+#include <memusage.h>
+#include <test/util/random.h>
+#include <test/util/setup_common.h>
+
+#include <boost/test/unit_test.hpp>
+
+#include <map>
+
+BOOST_FIXTURE_TEST_SUITE(flathashmap_tests, BasicTestingSetup)
+
+namespace {
+/** Maps all keys to a few hashes, so that lookups probe across groups. */
+struct CollidingHasher {
+    size_t operator()(uint32_t key) const { return (key % 4) * 0x9E3779B97F4A7C15ULL; }
+};
+
+template <typename Map>
+void CheckEqual(const Map& map, const std::map<uint32_t, uint32_t>& expected)
+{
+    BOOST_REQUIRE_EQUAL(map.size(), expected.size());
+    BOOST_CHECK_EQUAL(map.empty(), expected.empty());
+    size_t count{0};
+    for (const auto& [key, value] : map) {
+        const auto it{expected.find(key)};
+        BOOST_REQUIRE(it != expected.end());
+        BOOST_CHECK_EQUAL(value, it->second);
+        ++count;
+    }
+    BOOST_CHECK_EQUAL(count, expected.size());
+}
+
+template <typename Hasher>
+void RandomOperations(Hasher hasher, uint32_t key_range)
+{
+    FlatHashMap<uint32_t, uint32_t, Hasher> map{0, hasher};
+    std::map<uint32_t, uint32_t> expected;
+
+    for (int i{0}; i < 20000; ++i) {
+        const uint32_t key{static_cast<uint32_t>(InsecureRandRange(key_range))};
+        const uint32_t value{InsecureRand32()};
+        switch (InsecureRandRange(5)) {
+        case 0: {
+            const auto [it, inserted]{map.try_emplace(key, value)};
+            const auto [expected_it, expected_inserted]{expected.try_emplace(key, value)};
+            BOOST_CHECK_EQUAL(inserted, expected_inserted);
+            BOOST_CHECK_EQUAL(it->first, key);
+            BOOST_CHECK_EQUAL(it->second, expected_it->second);
+            break;
+        }
+        case 1:
+            map[key] = value;
+            expected[key] = value;
+            break;
+        case 2:
+            BOOST_CHECK_EQUAL(map.erase(key), expected.erase(key));
+            break;
+        case 3: {
+            const auto it{map.find(key)};
+            const auto expected_it{expected.find(key)};
+            BOOST_REQUIRE_EQUAL(it == map.end(), expected_it == expected.end());
+            if (it != map.end()) BOOST_CHECK_EQUAL(it->second, expected_it->second);
+            break;
+        }
+        case 4:
+            // Erase some of the entries while iterating, as BatchWrite() does.
+            if (InsecureRandRange(100) == 0) {
+                for (auto it{map.begin()}; it != map.end();) {
+                    if (it->second % 2) {
+                        expected.erase(it->first);
+                        it = map.erase(it);
+                    } else {
+                        ++it;
+                    }
+                }
+            }
+            break;
+        }
+    }
+    CheckEqual(map, expected);
+
+    const auto copy{map};
+    CheckEqual(copy, expected);
+    map.clear();
+    CheckEqual(map, {});
+    BOOST_CHECK(map.find(0) == map.end());
+    CheckEqual(copy, expected);
+}
+} // namespace
+
+BOOST_AUTO_TEST_CASE(flathashmap_random)
+{
+    RandomOperations(std::hash<uint32_t>{}, 1000);
+    RandomOperations(CollidingHasher{}, 200);
+}
+
+BOOST_AUTO_TEST_CASE(flathashmap_erase_reuses_slots)
+{
+    FlatHashMap<uint32_t, uint32_t, std::hash<uint32_t>> map;
+    BOOST_CHECK_EQUAL(map.capacity(), 0U);
+    BOOST_CHECK_EQUAL(memusage::DynamicUsage(map), 0U);
+    BOOST_CHECK(map.begin() == map.end());
+
+    map.reserve(100);
+    const size_t capacity{map.capacity()};
+    BOOST_CHECK(capacity >= 100);
+    BOOST_CHECK_EQUAL(memusage::DynamicUsage(map), memusage::MallocUsage(capacity * sizeof(std::pair<const uint32_t, uint32_t>) + capacity + 1));
+
+    // Entries that come and go must not make the map keep growing.
+    for (uint32_t i{0}; i < 100000; ++i) {
+        map.emplace(i, i);
+        if (i >= 100) BOOST_CHECK_EQUAL(map.erase(i - 100), 1U);
+    }
+    BOOST_CHECK_EQUAL(map.size(), 100U);
+    BOOST_CHECK(map.capacity() <= 2 * capacity);
+}
+
+BOOST_AUTO_TEST_CASE(flathashmap_coins)
+{
+    CCoinsFlatMap map{0, SaltedOutpointHasher{/*deterministic=*/true}, CCoinsFlatMap::key_equal{}};
+    const COutPoint outpoint{Txid::FromUint256(InsecureRand256()), 1};
+    Coin coin{CTxOut{1, CScript{} << OP_TRUE}, /*nHeightIn=*/1, /*fCoinBaseIn=*/false};
+
+    auto [it, inserted]{map.emplace(std::piecewise_construct, std::forward_as_tuple(outpoint),
+                                    std::forward_as_tuple(std::move(coin), CCoinsCacheEntry::DIRTY | CCoinsCacheEntry::FRESH))};
+    BOOST_CHECK(inserted);
+    BOOST_CHECK_EQUAL(it->second.flags, CCoinsCacheEntry::DIRTY | CCoinsCacheEntry::FRESH);
+    BOOST_CHECK_EQUAL(it->second.coin.out.nValue, 1);
+
+    std::tie(it, inserted) = map.emplace(std::piecewise_construct, std::forward_as_tuple(outpoint), std::tuple<>());
+    BOOST_CHECK(!inserted);
+    BOOST_CHECK_EQUAL(map.size(), 1U);
+
+    const auto& entry{map[COutPoint{outpoint.hash, 2}]};
+    BOOST_CHECK(entry.coin.IsSpent());
+    BOOST_CHECK_EQUAL(entry.flags, 0);
+    BOOST_CHECK_EQUAL(map.size(), 2U);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -9,6 +9,7 @@
 #include <consensus/consensus.h>
 #include <consensus/merkle.h>
 #include <consensus/tx_verify.h>
+#include <hash.h>
 #include <node/miner.h>
 #include <policy/policy.h>
 #include <test/util/random.h>
@@ -24,6 +25,7 @@
 #include <test/util/setup_common.h>
 
 #include <memory>
+#include <optional>
 
 #include <boost/test/unit_test.hpp>
 
@@ -660,4 +662,48 @@ BOOST_AUTO_TEST_CASE(CreateNewBlock_validity)
     TestPrioritisedMining(scriptPubKey, txFirst);
 }
 
+BOOST_AUTO_TEST_CASE(SearchProofOfWork_threads)
+{
+    // About one in 16 hashes meets this target.
+    Consensus::Params params{m_node.chainman->GetConsensus()};
+    params.powLimit = uint256S("0x7fffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffff");
+    CBlockHeader header;
+    header.nHeight = 1;
+    header.nBits = 0x200fffff;
+
+    // The threads find the same (lowest) solution as a single thread.
+    std::optional<CBlockHeader> expected;
+    for (const int threads : {1, 3}) {
+        CBlockHeader solved{header};
+        uint64_t max_tries{1000};
+        BOOST_REQUIRE(node::SearchProofOfWork(solved, params, max_tries, threads, m_node.chainman->m_interrupt));
+        uint256 mix;
+        BOOST_CHECK(CheckProofOfWork(ETHash(solved, mix), solved.nBits, params));
+        BOOST_CHECK_EQUAL(mix, solved.hashMix);
+        // Only the nonces below the solution count, whichever thread tried them.
+        BOOST_CHECK_EQUAL(max_tries, 1000 - solved.nNonce);
+        if (!expected) {
+            expected = solved;
+        } else {
+            BOOST_CHECK_EQUAL(solved.nNonce, expected->nNonce);
+            BOOST_CHECK_EQUAL(solved.hashMix, expected->hashMix);
+        }
+    }
+
+    // Running out of tries leaves the nonce after the last one tried.
+    BOOST_REQUIRE(expected->nNonce > 0);
+    CBlockHeader unsolved{header};
+    uint64_t max_tries{expected->nNonce};
+    BOOST_CHECK(!node::SearchProofOfWork(unsolved, params, max_tries, 2, m_node.chainman->m_interrupt));
+    BOOST_CHECK_EQUAL(max_tries, 0U);
+    BOOST_CHECK_EQUAL(unsolved.nNonce, expected->nNonce);
+
+    // An invalid nBits cannot be met.
+    header.nBits = 0x01803456;
+    max_tries = 5;
+    BOOST_CHECK(!node::SearchProofOfWork(header, params, max_tries, 2, m_node.chainman->m_interrupt));
+    BOOST_CHECK_EQUAL(max_tries, 0U);
+    BOOST_CHECK_EQUAL(header.nNonce, 5U);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -3,15 +3,23 @@
 // Distributed under the MIT software license, see the accompanying
 // file COPYING or http://www.opensource.org/licenses/mit-license.php.
 
+#include <arith_uint256.h>
 #include <chain.h>
 #include <chainparams.h>
+#include <checkqueue.h>
+#include <hash.h>
 #include <pow.h>
+#include <primitives/block.h>
+#include <streams.h>
 #include <test/util/random.h>
 #include <test/util/setup_common.h>
 #include <util/chaintype.h>
+#include <validation.h>
 
 #include <boost/test/unit_test.hpp>
 
+#include <algorithm>
+
 const std::vector<std::pair<uint32_t, uint32_t>> blockIndexData = {
     {1712232000, 0x1f0affff}, {1712232030, 0x1f0affff}, {1712232060, 0x1f0affff}, {1712232090, 0x1f0affff}, {1712232120, 0x1f0affff}, {1712232150, 0x1f0affff}, 
     {1712232180, 0x1f0affff}, {1712232210, 0x1f0affff}, {1712232240, 0x1f0affff}, {1712232270, 0x1f0affff}, {1712232300, 0x1f0affff}, {1712232330, 0x1f0affff},
@@ -64,6 +72,7 @@ BOOST_AUTO_TEST_CASE(get_next_work)
     const auto chainParams = CreateChainParams(ChainType::MAIN);
     const auto blockIndexes = GenerateBlockIndexes(blockIndexData);
 
+    LOCK(cs_main);
     for (const auto &blockIndex : blockIndexes) {
         uint32_t nBits = CalculateNextWorkRequired(blockIndex->pprev, chainParams->GetConsensus());
 
@@ -72,6 +81,64 @@ BOOST_AUTO_TEST_CASE(get_next_work)
     }
 }
 
+/** The retarget algorithm as originally written, without the cache. */
+static unsigned int ReferenceNextWorkRequired(const CBlockIndex* pindexLast, const Consensus::Params& params)
+{
+    const arith_uint256 bnPowLimit = UintToArith256(params.powLimit);
+    const int64_t nPastBlocks = params.nPowTargetWindow;
+    if (!pindexLast || pindexLast->nHeight < nPastBlocks) return bnPowLimit.GetCompact();
+
+    const CBlockIndex* pindex = pindexLast;
+    arith_uint256 bnPastTargetAvg;
+    for (unsigned int nCountBlocks = 1; nCountBlocks <= nPastBlocks; nCountBlocks++) {
+        const arith_uint256 bnTarget = arith_uint256().SetCompact(pindex->nBits);
+        if (nCountBlocks == 1) {
+            bnPastTargetAvg = bnTarget;
+        } else {
+            bnPastTargetAvg = (bnPastTargetAvg * nCountBlocks + bnTarget) / (nCountBlocks + 1);
+        }
+        if (nCountBlocks != nPastBlocks) pindex = pindex->pprev;
+    }
+
+    arith_uint256 bnNew(bnPastTargetAvg);
+    int64_t nActualTimespan = pindexLast->GetBlockTime() - pindex->GetBlockTime();
+    const int64_t nTargetTimespan = nPastBlocks * params.nPowTargetSpacing;
+    nActualTimespan = std::clamp(nActualTimespan, nTargetTimespan / 3, nTargetTimespan * 3);
+    bnNew *= nActualTimespan;
+    bnNew /= nTargetTimespan;
+    if (bnNew > bnPowLimit) bnNew = bnPowLimit;
+    return bnNew.GetCompact();
+}
+
+BOOST_AUTO_TEST_CASE(get_next_work_cache)
+{
+    const auto chainParams = CreateChainParams(ChainType::MAIN);
+    const Consensus::Params& params{chainParams->GetConsensus()};
+
+    // A chain with erratic block times, each block at its required target.
+    std::vector<std::unique_ptr<CBlockIndex>> blockIndexes;
+    uint32_t time{1712232000};
+    for (int height = 0; height < 500; ++height) {
+        auto blockIndex = std::make_unique<CBlockIndex>();
+        blockIndex->nHeight = height;
+        blockIndex->pprev = blockIndexes.empty() ? nullptr : blockIndexes.back().get();
+        time += InsecureRandRange(300);
+        blockIndex->nTime = time;
+        blockIndex->nBits = ReferenceNextWorkRequired(blockIndex->pprev, params);
+        blockIndexes.push_back(std::move(blockIndex));
+    }
+
+    LOCK(cs_main);
+    for (const auto& blockIndex : blockIndexes) {
+        const unsigned int expected{ReferenceNextWorkRequired(blockIndex.get(), params)};
+        BOOST_CHECK_EQUAL(CalculateNextWorkRequiredUncached(blockIndex.get(), params), expected);
+        BOOST_CHECK_EQUAL(blockIndex->nNextWorkRequired, 0U);
+        BOOST_CHECK_EQUAL(CalculateNextWorkRequired(blockIndex.get(), params), expected);
+        BOOST_CHECK_EQUAL(blockIndex->nNextWorkRequired, expected);
+        BOOST_CHECK_EQUAL(CalculateNextWorkRequired(blockIndex.get(), params), expected);
+    }
+}
+
 BOOST_AUTO_TEST_CASE(CheckProofOfWork_test_negative_target)
 {
     const auto consensus = CreateChainParams(ChainType::MAIN)->GetConsensus();
@@ -148,6 +215,107 @@ BOOST_AUTO_TEST_CASE(GetBlockProofEquivalentTime_test)
     }
 }
 
+BOOST_AUTO_TEST_CASE(CheckProofOfWork_two_stages)
+{
+    const auto chainParams = CreateChainParams(ChainType::REGTEST);
+    const auto& consensus = chainParams->GetConsensus();
+    CBlockHeader header = chainParams->GenesisBlock().GetBlockHeader();
+    BOOST_CHECK(CheckProofOfWorkFinalHash(header, consensus));
+    BOOST_CHECK(CheckProofOfWorkMix(header));
+
+    // With the easy regtest target, a claimed mix can be ground until the
+    // cheap first stage accepts it; only the second stage catches it.
+    const uint256 real_mix = header.hashMix;
+    for (uint8_t i = 1; !CheckProofOfWorkFinalHash(header, consensus) || header.hashMix == real_mix; ++i) {
+        header.hashMix = real_mix;
+        *header.hashMix.begin() ^= i;
+    }
+    BOOST_CHECK(!CheckProofOfWorkMix(header));
+
+    // A target nothing can meet is rejected by the first stage.
+    header = chainParams->GenesisBlock().GetBlockHeader();
+    header.nBits = 0x03000001;
+    BOOST_CHECK(!CheckProofOfWorkFinalHash(header, consensus));
+}
+
+BOOST_AUTO_TEST_CASE(CheckProofOfWorkMix_cache)
+{
+    const auto chainParams = CreateChainParams(ChainType::REGTEST);
+    CBlockHeader header = chainParams->GenesisBlock().GetBlockHeader();
+    BOOST_CHECK(CheckProofOfWorkMix(header));
+    // Served from the cache the second time.
+    BOOST_CHECK(CheckProofOfWorkMix(header));
+
+    // A cached header must not vouch for any field the mix commits to.
+    CBlockHeader other_mix = header;
+    *other_mix.hashMix.begin() ^= 1;
+    BOOST_CHECK(!CheckProofOfWorkMix(other_mix));
+    BOOST_CHECK(!CheckProofOfWorkMix(other_mix));
+    CBlockHeader other_nonce = header;
+    ++other_nonce.nNonce;
+    BOOST_CHECK(!CheckProofOfWorkMix(other_nonce));
+    CBlockHeader other_time = header;
+    ++other_time.nTime;
+    BOOST_CHECK(!CheckProofOfWorkMix(other_time));
+
+    BOOST_CHECK(CheckProofOfWorkMix(header));
+}
+
+BOOST_AUTO_TEST_CASE(HasValidProofOfWork_parallel)
+{
+    const auto chainParams = CreateChainParams(ChainType::REGTEST);
+    const auto& consensus = chainParams->GetConsensus();
+    const CBlock& genesis = chainParams->GenesisBlock();
+
+    // A few chunks of mined headers, the last one partial.
+    std::vector<CBlockHeader> headers(HEADERS_POW_CHECK_CHUNK * 2 + 5);
+    uint256 prev = genesis.GetHash();
+    for (size_t i = 0; i < headers.size(); ++i) {
+        CBlockHeader& header = headers[i];
+        header.hashPrevBlock = prev;
+        header.nHeight = i + 1;
+        header.nTime = genesis.nTime + 60 * (i + 1);
+        header.nBits = genesis.nBits;
+        uint256 mix;
+        while (!CheckProofOfWork(ETHash(header, mix), header.nBits, consensus)) ++header.nNonce;
+        header.hashMix = mix;
+        prev = header.GetHash();
+    }
+
+    CCheckQueue<CHeaderPowCheck> queue{/*batch_size=*/1, /*worker_threads_num=*/3, "powcheck"};
+    for (CCheckQueue<CHeaderPowCheck>* q : {&queue, static_cast<CCheckQueue<CHeaderPowCheck>*>(nullptr)}) {
+        for (const auto mix_check : {HeadersMixCheck::NONE, HeadersMixCheck::SAMPLE, HeadersMixCheck::ALL}) {
+            BOOST_CHECK(HasValidProofOfWork(headers, consensus, mix_check, q));
+        }
+        BOOST_CHECK(HasValidProofOfWork({}, consensus, HeadersMixCheck::ALL, q));
+
+        // A ground mix in the middle is only caught when every mix is checked.
+        std::vector<CBlockHeader> bad_mix = headers;
+        CBlockHeader& middle = bad_mix[HEADERS_POW_CHECK_CHUNK + 3];
+        for (uint8_t i = 1; !CheckProofOfWorkFinalHash(middle, consensus) || middle.hashMix == headers[HEADERS_POW_CHECK_CHUNK + 3].hashMix; ++i) {
+            middle.hashMix = headers[HEADERS_POW_CHECK_CHUNK + 3].hashMix;
+            *middle.hashMix.begin() ^= i;
+        }
+        BOOST_CHECK(HasValidProofOfWork(bad_mix, consensus, HeadersMixCheck::NONE, q));
+        BOOST_CHECK(!HasValidProofOfWork(bad_mix, consensus, HeadersMixCheck::ALL, q));
+
+        // The sample always includes the last header.
+        std::vector<CBlockHeader> bad_last = headers;
+        CBlockHeader& last = bad_last.back();
+        for (uint8_t i = 1; !CheckProofOfWorkFinalHash(last, consensus) || last.hashMix == headers.back().hashMix; ++i) {
+            last.hashMix = headers.back().hashMix;
+            *last.hashMix.begin() ^= i;
+        }
+        BOOST_CHECK(HasValidProofOfWork(bad_last, consensus, HeadersMixCheck::NONE, q));
+        BOOST_CHECK(!HasValidProofOfWork(bad_last, consensus, HeadersMixCheck::SAMPLE, q));
+
+        // A final hash above the target fails without looking at any mix.
+        std::vector<CBlockHeader> bad_bits = headers;
+        bad_bits[HEADERS_POW_CHECK_CHUNK * 2].nBits = 0x03000001;
+        BOOST_CHECK(!HasValidProofOfWork(bad_bits, consensus, HeadersMixCheck::NONE, q));
+    }
+}
+
 void sanity_check_chainparams(ChainType chain_type)
 {
     const auto chainParams = CreateChainParams(chain_type);
@@ -171,6 +339,51 @@ void sanity_check_chainparams(ChainType chain_type)
     }
 }
 
+BOOST_AUTO_TEST_CASE(CBlockHeader_CacheHashes)
+{
+    const auto chainParams = CreateChainParams(ChainType::REGTEST);
+    CBlock block{chainParams->GenesisBlock()};
+    const uint256 hash{block.GetHash()};
+    const uint256 header_hash{block.GetHeaderHash()};
+    BOOST_CHECK(!block.HasCachedHashes());
+
+    block.CacheHashes();
+    BOOST_CHECK(block.HasCachedHashes());
+    BOOST_CHECK_EQUAL(block.GetHash(), hash);
+    BOOST_CHECK_EQUAL(block.GetHeaderHash(), header_hash);
+
+    // A copy can be modified, so it does not inherit the cache.
+    CBlock copy{block};
+    BOOST_CHECK(!copy.HasCachedHashes());
+    ++copy.nTime;
+    BOOST_CHECK(copy.GetHash() != hash);
+    BOOST_CHECK(copy.GetHeaderHash() != header_hash);
+    copy = block;
+    BOOST_CHECK(!copy.HasCachedHashes());
+    BOOST_CHECK_EQUAL(copy.GetHash(), hash);
+
+    // Moving keeps it.
+    CBlock moved{std::move(copy)};
+    BOOST_CHECK(!moved.HasCachedHashes());
+    CBlock moved_cached{std::move(block)};
+    BOOST_CHECK(moved_cached.HasCachedHashes());
+    BOOST_CHECK_EQUAL(moved_cached.GetHash(), hash);
+
+    // Deserializing into a cached block clears it.
+    DataStream stream{};
+    stream << TX_WITH_WITNESS(chainParams->GenesisBlock());
+    CBlock other{chainParams->GenesisBlock()};
+    ++other.nNonce;
+    other.CacheHashes();
+    stream >> TX_WITH_WITNESS(other);
+    BOOST_CHECK(!other.HasCachedHashes());
+    BOOST_CHECK_EQUAL(other.GetHash(), hash);
+
+    other.CacheHashes();
+    other.SetNull();
+    BOOST_CHECK(!other.HasCachedHashes());
+}
+
 BOOST_AUTO_TEST_CASE(ChainParams_MAIN_sanity)
 {
     sanity_check_chainparams(ChainType::MAIN);
@@ -0,0 +1,122 @@
+// Copyright (c) 2024 The Regus Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <chain.h>
+#include <consensus/consensus.h>
+#include <node/miner.h>
+#include <node/template_builder.h>
+#include <primitives/transaction.h>
+#include <test/util/mining.h>
+#include <test/util/script.h>
+#include <test/util/setup_common.h>
+#include <txmempool.h>
+#include <validation.h>
+#include <validationinterface.h>
+
+#include <boost/test/unit_test.hpp>
+
+#include <chrono>
+#include <thread>
+
+using node::BlockTemplateBuilder;
+using node::CBlockTemplate;
+
+namespace {
+//! A regtest chain with one mature coinbase, paying to P2WSH_OP_TRUE.
+struct TemplateBuilderTestingSetup : public RegTestingSetup {
+    std::shared_ptr<CBlock> m_spendable;
+
+    TemplateBuilderTestingSetup()
+    {
+        const auto chain{CreateBlockChain(COINBASE_MATURITY + 1, m_node.chainman->GetParams())};
+        for (const auto& block : chain) {
+            BOOST_REQUIRE(m_node.chainman->ProcessNewBlock(block, /*force_processing=*/true, /*min_pow_checked=*/true, /*new_block=*/nullptr));
+        }
+        m_spendable = chain.front();
+    }
+};
+} // namespace
+
+BOOST_FIXTURE_TEST_SUITE(template_builder_tests, TemplateBuilderTestingSetup)
+
+static std::shared_ptr<const CBlockTemplate> WaitForTemplate(BlockTemplateBuilder& builder, const CBlockIndex* tip)
+{
+    for (int i = 0; i < 1000; ++i) {
+        if (auto block_template{builder.GetTemplate(tip).first}) return block_template;
+        std::this_thread::sleep_for(std::chrono::milliseconds{10});
+    }
+    return nullptr;
+}
+
+BOOST_AUTO_TEST_CASE(template_follows_tip)
+{
+    BlockTemplateBuilder builder{*m_node.chainman, *m_node.mempool};
+    RegisterValidationInterface(&builder);
+    builder.Start();
+
+    const CBlockIndex* tip{WITH_LOCK(cs_main, return m_node.chainman->ActiveChain().Tip())};
+    // Nothing is built before the first request.
+    BOOST_CHECK_EQUAL(builder.GetStats().rebuilds, 0U);
+    auto block_template{WaitForTemplate(builder, tip)};
+    BOOST_REQUIRE(block_template);
+    BOOST_CHECK(block_template->block.hashPrevBlock == tip->GetBlockHash());
+    BOOST_CHECK(builder.GetStats().built_time);
+
+    // A new tip makes the template stale until it is rebuilt on top of it.
+    MineBlock(m_node, P2WSH_OP_TRUE);
+    SyncWithValidationInterfaceQueue();
+    BOOST_CHECK(!builder.GetTemplate(tip).first);
+    tip = WITH_LOCK(cs_main, return m_node.chainman->ActiveChain().Tip());
+    block_template = WaitForTemplate(builder, tip);
+    BOOST_REQUIRE(block_template);
+    BOOST_CHECK(block_template->block.hashPrevBlock == tip->GetBlockHash());
+    BOOST_CHECK(builder.GetStats().rebuilds >= 2);
+
+    UnregisterValidationInterface(&builder);
+    builder.Stop();
+}
+
+BOOST_AUTO_TEST_CASE(template_follows_mempool)
+{
+    BlockTemplateBuilder builder{*m_node.chainman, *m_node.mempool};
+    RegisterValidationInterface(&builder);
+    builder.Start();
+
+    const CBlockIndex* tip{WITH_LOCK(cs_main, return m_node.chainman->ActiveChain().Tip())};
+    const auto block_template{WaitForTemplate(builder, tip)};
+    BOOST_REQUIRE(block_template);
+    BOOST_CHECK_EQUAL(block_template->block.vtx.size(), 1U);
+
+    CMutableTransaction mtx;
+    mtx.vin.emplace_back(COutPoint{m_spendable->vtx[0]->GetHash(), 0});
+    mtx.vin[0].scriptWitness.stack.push_back(WITNESS_STACK_ELEM_OP_TRUE);
+    mtx.vout.emplace_back(m_spendable->vtx[0]->vout[0].nValue - 10000, P2WSH_OP_TRUE);
+    const CTransactionRef tx{MakeTransactionRef(std::move(mtx))};
+    const MempoolAcceptResult result{WITH_LOCK(cs_main, return m_node.chainman->ProcessTransaction(tx))};
+    BOOST_REQUIRE_EQUAL(result.m_result_type, MempoolAcceptResult::ResultType::VALID);
+    SyncWithValidationInterfaceQueue();
+
+    // getblocktemplate relies on the builder to notice mempool changes, so the
+    // template is rebuilt with the new transaction, if not right away.
+    const unsigned int transactions_updated{m_node.mempool->GetTransactionsUpdated()};
+    std::shared_ptr<const CBlockTemplate> refreshed;
+    for (int i = 0; i < 1000; ++i) {
+        const auto [current, current_updated] = builder.GetTemplate(tip);
+        if (current && current_updated == transactions_updated) {
+            refreshed = current;
+            break;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds{10});
+    }
+    BOOST_REQUIRE(refreshed);
+    BOOST_CHECK(refreshed != block_template);
+    BOOST_REQUIRE_EQUAL(refreshed->block.vtx.size(), 2U);
+    BOOST_CHECK(refreshed->block.vtx[1]->GetHash() == tx->GetHash());
+    BOOST_CHECK_EQUAL(builder.GetStats().rebuilds, 2U);
+
+    UnregisterValidationInterface(&builder);
+    builder.Stop();
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -149,6 +149,7 @@ BasicTestingSetup::BasicTestingSetup(const ChainType chainType, const std::vecto
     ApplyArgsManOptions(*m_node.args, validation_cache_sizes);
     Assert(InitSignatureCache(validation_cache_sizes.signature_cache_bytes));
     Assert(InitScriptExecutionCache(validation_cache_sizes.script_execution_cache_bytes));
+    Assert(InitPowCache(validation_cache_sizes.pow_cache_bytes));
 
     m_node.chain = interfaces::MakeChain(m_node);
     static bool noui_connected = false;
@@ -189,8 +190,10 @@ ChainTestingSetup::ChainTestingSetup(const ChainType chainType, const std::vecto
         .chainparams = chainparams,
         .datadir = m_args.GetDataDirNet(),
         .check_block_index = true,
+        .coins_view = {.background_flush = m_node.args->GetBoolArg("-backgroundflush", DEFAULT_BACKGROUND_FLUSH)},
         .notifications = *m_node.notifications,
         .worker_threads_num = 2,
+        .utxo_prefetch = m_node.args->GetBoolArg("-utxoprefetch", DEFAULT_UTXO_PREFETCH),
     };
     const BlockManager::Options blockman_opts{
         .chainparams = chainman_opts.chainparams,
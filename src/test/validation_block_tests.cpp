@@ -11,9 +11,12 @@
 #include <node/miner.h>
 #include <pow.h>
 #include <random.h>
+#include <streams.h>
+#include <test/util/mining.h>
 #include <test/util/random.h>
 #include <test/util/script.h>
 #include <test/util/setup_common.h>
+#include <util/fs.h>
 #include <util/time.h>
 #include <validation.h>
 #include <validationinterface.h>
@@ -360,4 +363,56 @@ BOOST_AUTO_TEST_CASE(witness_commitment_index)
 
     BOOST_CHECK_EQUAL(GetWitnessCommitmentIndex(pblock), 2);
 }
+
+BOOST_AUTO_TEST_CASE(load_external_block_files)
+{
+    ChainstateManager& chainman{*Assert(m_node.chainman)};
+    const CChainParams& params{chainman.GetParams()};
+    const auto chain{CreateBlockChain(30, params)};
+
+    const auto write_file{[&](const fs::path& path, size_t begin, size_t end) {
+        AutoFile file{fsbridge::fopen(path, "ab")};
+        for (size_t i{begin}; i < end; ++i) {
+            // Data between the blocks is skipped.
+            file << params.MessageStart() << uint32_t{1};
+            file << params.MessageStart() << uint32_t(GetSerializeSize(TX_WITH_WITNESS(*chain[i]))) << TX_WITH_WITNESS(*chain[i]);
+        }
+    }};
+    const auto tip_height{[&]() { return WITH_LOCK(cs_main, return chainman.ActiveHeight()); }};
+    const auto activate{[&]() {
+        BlockValidationState state;
+        BOOST_CHECK(chainman.ActiveChainstate().ActivateBestChain(state));
+    }};
+
+    const fs::path first{m_path_root / "first.dat"};
+    const fs::path second{m_path_root / "second.dat"};
+    write_file(first, 0, 10);
+    write_file(second, 15, 20);
+    write_file(second, 10, 15);
+
+    // A file that can't be opened is skipped, and blocks found before their
+    // parent are dropped.
+    chainman.LoadExternalBlockFiles({first, m_path_root / "missing.dat", second}, /*reindex=*/false);
+    activate();
+    BOOST_CHECK_EQUAL(tip_height(), 15);
+    BOOST_CHECK(WITH_LOCK(cs_main, return chainman.m_blockman.LookupBlockIndex(chain[19]->GetHash())) == nullptr);
+
+    chainman.LoadExternalBlockFiles({second}, /*reindex=*/false);
+    activate();
+    BOOST_CHECK_EQUAL(tip_height(), 20);
+    BOOST_CHECK_EQUAL(WITH_LOCK(cs_main, return chainman.ActiveTip()->GetBlockHash()), chain[19]->GetHash());
+
+    // With reindex, blocks found before their parent are imported once it is,
+    // also when it is in a later file.
+    std::vector<fs::path> block_files;
+    for (int n{0}; n < 3; ++n) {
+        block_files.push_back(chainman.m_blockman.GetBlockPosFilename(FlatFilePos(n, 0)));
+    }
+    write_file(block_files[1], 25, 30);
+    write_file(block_files[2], 20, 25);
+    chainman.LoadExternalBlockFiles(block_files, /*reindex=*/true);
+    activate();
+    BOOST_CHECK_EQUAL(tip_height(), 30);
+    BOOST_CHECK_EQUAL(WITH_LOCK(cs_main, return chainman.ActiveTip()->GetBlockPos().nFile), 1);
+}
 BOOST_AUTO_TEST_SUITE_END()
\ No newline at end of file
@@ -5,6 +5,7 @@
 //
 #include <chainparams.h>
 #include <consensus/validation.h>
+#include <kernel/coinstats.h>
 #include <kernel/disconnected_transactions.h>
 #include <node/kernel_notifications.h>
 #include <node/utxo_snapshot.h>
@@ -13,6 +14,7 @@
 #include <sync.h>
 #include <test/util/chainstate.h>
 #include <test/util/logging.h>
+#include <test/util/mining.h>
 #include <test/util/random.h>
 #include <test/util/setup_common.h>
 #include <test/util/validation.h>
@@ -22,12 +24,15 @@
 
 #include <tinyformat.h>
 
+#include <algorithm>
+#include <iterator>
 #include <vector>
 
 #include <boost/test/unit_test.hpp>
 
 using node::BlockManager;
 using node::KernelNotifications;
+using node::SnapshotCoinsReader;
 using node::SnapshotMetadata;
 
 BOOST_FIXTURE_TEST_SUITE(validation_chainstatemanager_tests, TestingSetup)
@@ -106,6 +111,67 @@ BOOST_FIXTURE_TEST_CASE(chainstatemanager, TestChain100Setup)
     SyncWithValidationInterfaceQueue();
 }
 
+//! Test that blocks are read and checked ahead of ConnectTip().
+BOOST_FIXTURE_TEST_CASE(chainstatemanager_block_prevalidator, RegTestingSetup)
+{
+    ChainstateManager& manager = *m_node.chainman;
+    Chainstate& chainstate = manager.ActiveChainstate();
+    node::BlockPrevalidator& prevalidator = manager.GetBlockPrevalidator();
+    const auto chain{CreateBlockChain(24, manager.GetParams())};
+    for (size_t i = 0; i < 20; ++i) {
+        BOOST_REQUIRE(manager.ProcessNewBlock(chain[i], /*force_processing=*/true, /*min_pow_checked=*/true, /*new_block=*/nullptr));
+    }
+    CBlockIndex* fork = WITH_LOCK(::cs_main, return manager.ActiveChain()[10]);
+    const CBlockIndex* tip = WITH_LOCK(::cs_main, return manager.ActiveTip());
+    BOOST_REQUIRE_EQUAL(tip->nHeight, 20);
+
+    // Reconnecting the last 11 blocks uses the copies prefetched by the worker threads.
+    BlockValidationState state;
+    BOOST_REQUIRE(chainstate.InvalidateBlock(state, fork));
+    WITH_LOCK(::cs_main, chainstate.ResetBlockFailureFlags(fork));
+    const auto before = prevalidator.GetStats();
+    BOOST_REQUIRE(chainstate.ActivateBestChain(state));
+    BOOST_CHECK_EQUAL(WITH_LOCK(::cs_main, return manager.ActiveTip()), tip);
+    const auto after = prevalidator.GetStats();
+    BOOST_CHECK_EQUAL(after.prefetched - before.prefetched, 11U);
+    BOOST_CHECK_EQUAL(after.hits - before.hits, 11U);
+    BOOST_CHECK_EQUAL(after.misses, before.misses);
+
+    // A checked block is handed out once.
+    prevalidator.Add(chain[0]);
+    BOOST_CHECK_EQUAL(prevalidator.Take(chain[0]->GetHash()), chain[0]);
+    BOOST_CHECK(!prevalidator.Take(chain[0]->GetHash()));
+
+    // A block that cannot be read is not handed out.
+    prevalidator.Prefetch(uint256::ONE, FlatFilePos{});
+    BOOST_CHECK(!prevalidator.Take(uint256::ONE));
+    BOOST_CHECK_EQUAL(prevalidator.GetStats().misses, after.misses + 2);
+
+    // A block received ahead of its parent is kept until it can be connected.
+    BOOST_REQUIRE(manager.ProcessNewBlockHeaders({chain[20]->GetBlockHeader()}, /*min_pow_checked=*/true, state));
+    bool new_block{false};
+    BOOST_REQUIRE(manager.ProcessNewBlock(chain[21], /*force_processing=*/true, /*min_pow_checked=*/true, &new_block));
+    BOOST_CHECK(new_block);
+    BOOST_CHECK_EQUAL(prevalidator.Take(chain[21]->GetHash()), chain[21]);
+
+    // Another copy of a block that is stored already is not kept: it was not
+    // checked in context, and here carries a witness the stored one lacks.
+    auto mutated{std::make_shared<CBlock>(*chain[21])};
+    CMutableTransaction coinbase{*mutated->vtx[0]};
+    coinbase.vin[0].scriptWitness.stack.push_back({1});
+    mutated->vtx[0] = MakeTransactionRef(std::move(coinbase));
+    BOOST_REQUIRE(mutated->GetHash() == chain[21]->GetHash());
+    BOOST_REQUIRE(manager.ProcessNewBlock(mutated, /*force_processing=*/true, /*min_pow_checked=*/true, &new_block));
+    BOOST_CHECK(!new_block);
+    BOOST_CHECK(!prevalidator.Take(chain[21]->GetHash()));
+
+    // Once its parent arrives, the block is connected from the stored copy.
+    BOOST_REQUIRE(manager.ProcessNewBlock(chain[20], /*force_processing=*/true, /*min_pow_checked=*/true, /*new_block=*/nullptr));
+    BOOST_CHECK_EQUAL(WITH_LOCK(::cs_main, return manager.ActiveTip()->GetBlockHash()), chain[21]->GetHash());
+
+    SyncWithValidationInterfaceQueue();
+}
+
 //! Test rebalancing the caches associated with each chainstate.
 BOOST_FIXTURE_TEST_CASE(chainstatemanager_rebalance_caches, TestChain100Setup)
 {
@@ -774,4 +840,50 @@ BOOST_FIXTURE_TEST_CASE(chainstatemanager_snapshot_completion_hash_mismatch, Sna
     }
 }
 
+//! Ensure that snapshots are hashed while they are written and read, the same
+//! way ComputeUTXOStats() hashes the coins database.
+BOOST_FIXTURE_TEST_CASE(chainstatemanager_snapshot_streamed_hash, TestChain100Setup)
+{
+    Chainstate& chainstate{m_node.chainman->ActiveChainstate()};
+    const fs::path snapshot_path{m_path_root / "streamed_hash.dat"};
+
+    AutoFile outfile{fsbridge::fopen(snapshot_path, "wb")};
+    const auto info{node::WriteUTXOSnapshot(chainstate, outfile)};
+    BOOST_REQUIRE(info);
+    const auto stats{kernel::ComputeUTXOStats(kernel::CoinStatsHashType::HASH_SERIALIZED, &chainstate.CoinsDB(), m_node.chainman->m_blockman)};
+    BOOST_REQUIRE(stats);
+    BOOST_CHECK_EQUAL(info->hash_serialized, stats->hashSerialized);
+    BOOST_CHECK_EQUAL(info->coins_count, stats->coins_count);
+    BOOST_CHECK_EQUAL(info->base_height, 100);
+    BOOST_CHECK_EQUAL(info->base_blockhash, WITH_LOCK(::cs_main, return m_node.chainman->ActiveTip()->GetBlockHash()));
+
+    AutoFile infile{fsbridge::fopen(snapshot_path, "rb")};
+    SnapshotMetadata metadata;
+    infile >> metadata;
+    BOOST_CHECK_EQUAL(metadata.m_base_blockhash, info->base_blockhash);
+    BOOST_CHECK_EQUAL(metadata.m_coins_count, info->coins_count);
+
+    std::vector<std::pair<COutPoint, Coin>> coins;
+    {
+        SnapshotCoinsReader reader{infile, metadata.m_coins_count, info->base_height};
+        while (auto batch{reader.Next()}) {
+            coins.insert(coins.end(), std::make_move_iterator(batch->begin()), std::make_move_iterator(batch->end()));
+        }
+        BOOST_REQUIRE(reader.Complete());
+        BOOST_REQUIRE(reader.Commitment());
+        BOOST_CHECK_EQUAL(*reader.Commitment(), info->hash_serialized);
+    }
+    BOOST_REQUIRE_EQUAL(coins.size(), info->coins_count);
+
+    // Coins that are out of order, or repeated, can't be hashed as they are read.
+    const auto other{std::find_if(coins.begin(), coins.end(), [&](const auto& c) { return c.first.hash != coins.front().first.hash; })};
+    BOOST_REQUIRE(other != coins.end());
+    kernel::SerializedCoinsHasher reordered;
+    BOOST_CHECK(reordered.Add(other->first, other->second));
+    BOOST_CHECK(!reordered.Add(coins.front().first, coins.front().second));
+    kernel::SerializedCoinsHasher repeated;
+    BOOST_CHECK(repeated.Add(coins.front().first, coins.front().second));
+    BOOST_CHECK(!repeated.Add(coins.front().first, coins.front().second));
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -8,9 +8,13 @@
 #include <test/util/random.h>
 #include <test/util/setup_common.h>
 #include <validation.h>
+#include <validationinterface.h>
 
 #include <boost/test/unit_test.hpp>
 
+#include <atomic>
+#include <future>
+
 BOOST_FIXTURE_TEST_SUITE(validation_flush_tests, TestingSetup)
 
 //! Test utilities for detecting when we need to flush the coins cache based
@@ -155,4 +159,76 @@ BOOST_AUTO_TEST_CASE(getcoinscachesizestate)
         CoinsCacheSizeState::OK);
 }
 
+struct BackgroundFlushTestingSetup : public TestingSetup {
+    // Without a mempool allowance, a small coins cache is soon over its limit.
+    BackgroundFlushTestingSetup() : TestingSetup{ChainType::MAIN, {"-backgroundflush", "-maxmempool=0"}} {}
+};
+
+//! ChainStateFlushed() must not be signalled before the coins are written.
+BOOST_FIXTURE_TEST_CASE(chainstateflushed_after_background_write, BackgroundFlushTestingSetup)
+{
+    //! Holds writes until released
+    class BlockingCoinsView : public CCoinsViewBacked
+    {
+    public:
+        std::promise<void> release;
+        std::shared_future<void> released{release.get_future().share()};
+
+        using CCoinsViewBacked::CCoinsViewBacked;
+
+        bool BatchWrite(CCoinsMap& mapCoins, const uint256& hashBlock, bool erase) override
+        {
+            released.wait();
+            return CCoinsViewBacked::BatchWrite(mapCoins, hashBlock, erase);
+        }
+    };
+
+    class FlushListener : public CValidationInterface
+    {
+    public:
+        std::atomic<int> flushed{0};
+
+    protected:
+        void ChainStateFlushed(ChainstateRole role, const CBlockLocator& locator) override { ++flushed; }
+    };
+
+    Chainstate& chainstate{m_node.chainman->ActiveChainstate()};
+    BlockValidationState state;
+    {
+        LOCK(::cs_main);
+        // Shrinking the cache flushes it synchronously.
+        BOOST_REQUIRE(chainstate.ResizeCoinsCaches(/*coinstip_size=*/1 << 10, /*coinsdb_size=*/1 << 20));
+    }
+    SyncWithValidationInterfaceQueue();
+    auto listener{std::make_shared<FlushListener>()};
+    RegisterSharedValidationInterface(listener);
+
+    CCoinsView* db{WITH_LOCK(::cs_main, return &chainstate.CoinsDB())};
+    BlockingCoinsView blocking{db};
+    {
+        LOCK(::cs_main);
+        chainstate.CoinsErrorCatcher().SetBackend(blocking);
+        AddTestCoin(chainstate.CoinsTip());
+        BOOST_CHECK(chainstate.GetCoinsCacheSizeState() == CoinsCacheSizeState::CRITICAL);
+        BOOST_CHECK(chainstate.FlushStateToDisk(state, FlushStateMode::IF_NEEDED));
+        BOOST_CHECK(chainstate.GetCoinsFlushStats().pending);
+        BOOST_CHECK_EQUAL(chainstate.CoinsTip().GetCacheSize(), 0U);
+        // Later calls do not signal the flush either while it is written.
+        BOOST_CHECK(chainstate.FlushStateToDisk(state, FlushStateMode::NONE));
+    }
+    SyncWithValidationInterfaceQueue();
+    BOOST_CHECK_EQUAL(listener->flushed, 0);
+
+    blocking.release.set_value();
+    while (WITH_LOCK(::cs_main, return chainstate.GetCoinsFlushStats().pending)) {
+        UninterruptibleSleep(std::chrono::milliseconds{1});
+    }
+    BOOST_CHECK(WITH_LOCK(::cs_main, return chainstate.FlushStateToDisk(state, FlushStateMode::NONE)));
+    SyncWithValidationInterfaceQueue();
+    BOOST_CHECK_EQUAL(listener->flushed, 1);
+
+    UnregisterSharedValidationInterface(listener);
+    WITH_LOCK(::cs_main, chainstate.CoinsErrorCatcher().SetBackend(chainstate.CoinsDB()));
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -7,8 +7,10 @@
 #include <consensus/amount.h>
 #include <consensus/merkle.h>
 #include <core_io.h>
+#include <crypto/ethash/include/ethash/ethash.hpp>
 #include <hash.h>
 #include <net.h>
+#include <pow.h>
 #include <uint256.h>
 #include <util/chaintype.h>
 #include <validation.h>
@@ -296,4 +298,24 @@ BOOST_AUTO_TEST_CASE(block_malleation)
     }
 }
 
+BOOST_AUTO_TEST_CASE(headers_pow_unconnected_high_height)
+{
+    // A header from an unknown parent claiming a height far ahead of the
+    // chain, with a final hash that meets its target. Its nHeight cannot be
+    // checked, so its mix must not be verified: that would build the light
+    // cache of an epoch of the sender's choosing.
+    CBlockHeader header;
+    header.hashPrevBlock = uint256::ONE;
+    header.nHeight = 1000 * ethash::epoch_length - 1;
+    header.nTime = Params().GenesisBlock().nTime + 60;
+    header.nBits = Params().GenesisBlock().nBits;
+    while (!CheckProofOfWorkFinalHash(header, Params().GetConsensus())) ++header.nNonce;
+
+    const ethash::epoch_context_stats before{ethash::get_epoch_context_stats()};
+    BOOST_CHECK(m_node.chainman->HasValidProofOfWork({header}));
+    const ethash::epoch_context_stats after{ethash::get_epoch_context_stats()};
+    BOOST_CHECK_EQUAL(after.hits, before.hits);
+    BOOST_CHECK_EQUAL(after.misses, before.misses);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
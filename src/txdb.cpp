@@ -13,11 +13,16 @@
 #include <random.h>
 #include <serialize.h>
 #include <uint256.h>
+#include <util/threadnames.h>
+#include <util/time.h>
 #include <util/vector.h>
 
+#include <algorithm>
 #include <cassert>
 #include <cstdlib>
+#include <exception>
 #include <iterator>
+#include <stdexcept>
 #include <utility>
 
 static constexpr uint8_t DB_COIN{'C'};
@@ -227,3 +232,255 @@ void CCoinsViewDBCursor::Next()
         keyTmp.first = entry.key;
     }
 }
+
+void CCoinsViewPrefetch::Stage::Fetch(std::vector<COutPoint> outpoints)
+{
+    uint64_t generation;
+    {
+        LOCK(m_mutex);
+        if (m_paused || m_coins.size() >= MAX_PREFETCHED_COINS) return;
+        generation = m_generation;
+        ++m_reading;
+    }
+
+    // Coins are keyed by outpoint in the database, so reading them in order
+    // touches fewer blocks.
+    std::sort(outpoints.begin(), outpoints.end());
+    std::vector<std::pair<COutPoint, Coin>> coins;
+    coins.reserve(outpoints.size());
+    try {
+        for (const COutPoint& outpoint : outpoints) {
+            Coin coin;
+            if (m_view.GetCoin(outpoint, coin) && !coin.IsSpent()) coins.emplace_back(outpoint, std::move(coin));
+        }
+    } catch (const std::exception& e) {
+        LogPrintf("Unable to prefetch coins: %s\n", e.what());
+        coins.clear();
+    }
+
+    LOCK(m_mutex);
+    --m_reading;
+    m_cv.notify_all();
+    if (generation != m_generation) return;
+    for (auto& [outpoint, coin] : coins) {
+        if (m_coins.size() >= MAX_PREFETCHED_COINS) break;
+        if (m_coins.try_emplace(outpoint, std::move(coin)).second) ++m_stats.fetched;
+    }
+}
+
+CCoinsViewPrefetch::Stage::Stats CCoinsViewPrefetch::Stage::GetStats() const
+{
+    LOCK(m_mutex);
+    return m_stats;
+}
+
+std::optional<Coin> CCoinsViewPrefetch::Stage::Take(const COutPoint& outpoint)
+{
+    LOCK(m_mutex);
+    auto it{m_coins.find(outpoint)};
+    if (it == m_coins.end()) return std::nullopt;
+    std::optional<Coin> coin{std::move(it->second)};
+    m_coins.erase(it);
+    ++m_stats.used;
+    return coin;
+}
+
+void CCoinsViewPrefetch::Stage::Clear()
+{
+    LOCK(m_mutex);
+    ++m_generation;
+    m_coins.clear();
+}
+
+void CCoinsViewPrefetch::Stage::Pause()
+{
+    WAIT_LOCK(m_mutex, lock);
+    m_paused = true;
+    m_cv.wait(lock, [&]() EXCLUSIVE_LOCKS_REQUIRED(m_mutex) { return m_reading == 0; });
+}
+
+void CCoinsViewPrefetch::Stage::Resume()
+{
+    LOCK(m_mutex);
+    m_paused = false;
+}
+
+CCoinsViewPrefetch::CCoinsViewPrefetch(CCoinsView* view)
+    : CCoinsViewBacked(view), m_stage{std::make_shared<Stage>(*view)} {}
+
+CCoinsViewPrefetch::~CCoinsViewPrefetch()
+{
+    // Threads may still hold the stage; make sure they no longer read from the view below.
+    m_stage->Pause();
+}
+
+bool CCoinsViewPrefetch::GetCoin(const COutPoint& outpoint, Coin& coin) const
+{
+    if (auto prefetched{m_stage->Take(outpoint)}) {
+        coin = std::move(*prefetched);
+        return true;
+    }
+    return base->GetCoin(outpoint, coin);
+}
+
+bool CCoinsViewPrefetch::BatchWrite(CCoinsMap& mapCoins, const uint256& hashBlock, bool erase)
+{
+    const bool ret{base->BatchWrite(mapCoins, hashBlock, erase)};
+    // Coins read before or during the write may be stale now.
+    m_stage->Clear();
+    return ret;
+}
+
+CCoinsViewBackgroundFlush::CCoinsViewBackgroundFlush(CCoinsView* view, bool background)
+    : CCoinsViewBacked(view), m_background{background}
+{
+    if (!m_background) return;
+    m_thread = std::thread([this]() {
+        util::ThreadRename("coinsflush");
+        ThreadFlush();
+    });
+}
+
+CCoinsViewBackgroundFlush::~CCoinsViewBackgroundFlush()
+{
+    if (!m_thread.joinable()) return;
+    WITH_LOCK(m_mutex, m_stop = true);
+    m_cv.notify_all();
+    m_thread.join();
+}
+
+std::shared_ptr<const CCoinsViewBackgroundFlush::PendingWrite> CCoinsViewBackgroundFlush::GetPending() const
+{
+    LOCK(m_mutex);
+    return m_pending;
+}
+
+bool CCoinsViewBackgroundFlush::GetCoin(const COutPoint& outpoint, Coin& coin) const
+{
+    // The pending write is not modified while it is written, so it can be
+    // read without holding the lock.
+    if (const auto pending{GetPending()}) {
+        const auto it{pending->coins.find(outpoint)};
+        if (it != pending->coins.end()) {
+            if (it->second.coin.IsSpent()) return false;
+            coin = it->second.coin;
+            return true;
+        }
+    }
+    return base->GetCoin(outpoint, coin);
+}
+
+bool CCoinsViewBackgroundFlush::HaveCoin(const COutPoint& outpoint) const
+{
+    Coin coin;
+    return GetCoin(outpoint, coin);
+}
+
+uint256 CCoinsViewBackgroundFlush::GetBestBlock() const
+{
+    if (const auto pending{GetPending()}) return pending->block;
+    return base->GetBestBlock();
+}
+
+void CCoinsViewBackgroundFlush::AllowBackgroundWrite()
+{
+    LOCK(m_mutex);
+    m_allow_background = m_background;
+}
+
+bool CCoinsViewBackgroundFlush::WaitForPending(UniqueLock<Mutex>& lock)
+{
+    AssertLockHeld(m_mutex);
+    const auto start{SteadyClock::now()};
+    m_cv.wait(lock, [&]() EXCLUSIVE_LOCKS_REQUIRED(m_mutex) { return !m_pending || m_failed; });
+    m_stats.stall += std::chrono::duration_cast<std::chrono::microseconds>(SteadyClock::now() - start);
+    return !m_failed;
+}
+
+bool CCoinsViewBackgroundFlush::WaitForFlush()
+{
+    WAIT_LOCK(m_mutex, lock);
+    return WaitForPending(lock);
+}
+
+bool CCoinsViewBackgroundFlush::BatchWrite(CCoinsMap& mapCoins, const uint256& hashBlock, bool erase)
+{
+    bool background;
+    {
+        WAIT_LOCK(m_mutex, lock);
+        background = std::exchange(m_allow_background, false) && erase;
+        if (!WaitForPending(lock)) return false;
+    }
+
+    if (!background) {
+        const auto start{SteadyClock::now()};
+        const auto count{std::count_if(mapCoins.begin(), mapCoins.end(), [](const auto& entry) { return entry.second.flags & CCoinsCacheEntry::DIRTY; })};
+        const bool ret{base->BatchWrite(mapCoins, hashBlock, erase)};
+        const auto duration{std::chrono::duration_cast<std::chrono::microseconds>(SteadyClock::now() - start)};
+        LOCK(m_mutex);
+        ++m_stats.flushes;
+        m_stats.coins += count;
+        m_stats.duration += duration;
+        m_stats.last_duration = duration;
+        m_stats.stall += duration;
+        return ret;
+    }
+
+    // Only the changed coins need writing; the rest is in the database already.
+    auto pending{std::make_shared<PendingWrite>()};
+    pending->block = hashBlock;
+    for (auto it{mapCoins.begin()}; it != mapCoins.end(); it = mapCoins.erase(it)) {
+        if (!(it->second.flags & CCoinsCacheEntry::DIRTY)) continue;
+        pending->coins.emplace(std::piecewise_construct, std::forward_as_tuple(it->first),
+                               std::forward_as_tuple(std::move(it->second.coin), CCoinsCacheEntry::DIRTY));
+    }
+
+    WITH_LOCK(m_mutex, m_pending = std::move(pending));
+    m_cv.notify_all();
+    return true;
+}
+
+void CCoinsViewBackgroundFlush::ThreadFlush()
+{
+    WAIT_LOCK(m_mutex, lock);
+    while (true) {
+        m_cv.wait(lock, [&]() EXCLUSIVE_LOCKS_REQUIRED(m_mutex) { return m_stop || (m_pending && !m_failed); });
+        // Finish the pending write before stopping.
+        if (!m_pending || m_failed) return;
+        const std::shared_ptr<const PendingWrite> pending{m_pending};
+
+        const auto start{SteadyClock::now()};
+        bool ok{false};
+        {
+            REVERSE_LOCK(lock);
+            try {
+                // Keep the coins, which are read until the write is done.
+                ok = base->BatchWrite(const_cast<CCoinsMap&>(pending->coins), pending->block, /*erase=*/false);
+            } catch (const std::runtime_error& e) {
+                LogPrintf("Error writing coins to the database in the background: %s\n", e.what());
+            }
+        }
+        const auto duration{std::chrono::duration_cast<std::chrono::microseconds>(SteadyClock::now() - start)};
+        LogPrint(BCLog::BENCH, "Wrote %u coins in the background in %.2fms\n",
+                 pending->coins.size(), Ticks<MillisecondsDouble>(duration));
+
+        ++m_stats.flushes;
+        m_stats.coins += pending->coins.size();
+        m_stats.duration += duration;
+        m_stats.last_duration = duration;
+        if (ok) {
+            m_pending.reset();
+        } else {
+            m_failed = true;
+        }
+        m_cv.notify_all();
+    }
+}
+
+CCoinsViewBackgroundFlush::Stats CCoinsViewBackgroundFlush::GetStats() const
+{
+    LOCK(m_mutex);
+    Stats stats{m_stats};
+    stats.pending = m_pending != nullptr;
+    return stats;
+}
@@ -12,11 +12,16 @@
 #include <kernel/cs_main.h>
 #include <sync.h>
 #include <util/fs.h>
+#include <util/hasher.h>
 
+#include <chrono>
+#include <condition_variable>
 #include <cstddef>
 #include <cstdint>
 #include <memory>
 #include <optional>
+#include <thread>
+#include <unordered_map>
 #include <vector>
 
 class COutPoint;
@@ -40,6 +45,8 @@ static const int64_t nMaxTxIndexCache = 1024;
 static const int64_t max_filter_index_cache = 1024;
 //! Max memory allocated to coin DB specific cache (MiB)
 static const int64_t nMaxCoinsDBCache = 8;
+//! -backgroundflush default
+static constexpr bool DEFAULT_BACKGROUND_FLUSH{false};
 
 //! User-controlled performance and debug options.
 struct CoinsViewOptions {
@@ -48,6 +55,8 @@ struct CoinsViewOptions {
     //! If non-zero, randomly exit when the database is flushed with (1/ratio)
     //! probability.
     int simulate_crash_ratio = 0;
+    //! Write the coins cache to the database on a background thread.
+    bool background_flush = DEFAULT_BACKGROUND_FLUSH;
 };
 
 /** CCoinsView backed by the coin database (chainstate/) */
@@ -78,4 +87,155 @@ public:
     std::optional<fs::path> StoragePath() { return m_db->StoragePath(); }
 };
 
+/** Maximum number of coins a CCoinsViewPrefetch holds */
+static constexpr size_t MAX_PREFETCHED_COINS{1 << 17};
+
+/**
+ * CCoinsView between the coins cache and the database, which serves coins
+ * that other threads read from the database ahead of use. Connecting a block
+ * then finds most of its inputs without waiting for a database read.
+ *
+ * A prefetched coin is only valid while the database is unchanged, since the
+ * cache above may hold a newer version of it. So each one is handed out at
+ * most once, to the cache, which keeps it from then on; and all of them,
+ * including those still being read, are dropped whenever the cache writes
+ * back.
+ */
+class CCoinsViewPrefetch final : public CCoinsViewBacked
+{
+public:
+    /** The prefetched coins, shared with the threads reading them. */
+    class Stage
+    {
+    public:
+        struct Stats {
+            //! Coins read ahead of use
+            uint64_t fetched{0};
+            //! Coins handed to the cache
+            uint64_t used{0};
+        };
+
+        explicit Stage(CCoinsView& view) : m_view{view} {}
+
+        /** Read coins from the view below and keep those that exist. A no-op while paused. */
+        void Fetch(std::vector<COutPoint> outpoints) EXCLUSIVE_LOCKS_REQUIRED(!m_mutex);
+
+        Stats GetStats() const EXCLUSIVE_LOCKS_REQUIRED(!m_mutex);
+
+    private:
+        friend class CCoinsViewPrefetch;
+
+        std::optional<Coin> Take(const COutPoint& outpoint) EXCLUSIVE_LOCKS_REQUIRED(!m_mutex);
+        void Clear() EXCLUSIVE_LOCKS_REQUIRED(!m_mutex);
+        void Pause() EXCLUSIVE_LOCKS_REQUIRED(!m_mutex);
+        void Resume() EXCLUSIVE_LOCKS_REQUIRED(!m_mutex);
+
+        CCoinsView& m_view;
+        mutable Mutex m_mutex;
+        //! Pause() waits for reads in progress
+        std::condition_variable m_cv;
+        bool m_paused GUARDED_BY(m_mutex){false};
+        int m_reading GUARDED_BY(m_mutex){0};
+        //! Incremented by Clear(), so that reads started before are discarded
+        uint64_t m_generation GUARDED_BY(m_mutex){0};
+        std::unordered_map<COutPoint, Coin, SaltedOutpointHasher> m_coins GUARDED_BY(m_mutex);
+        Stats m_stats GUARDED_BY(m_mutex);
+    };
+
+    explicit CCoinsViewPrefetch(CCoinsView* view);
+    ~CCoinsViewPrefetch();
+
+    bool GetCoin(const COutPoint& outpoint, Coin& coin) const override;
+    bool BatchWrite(CCoinsMap& mapCoins, const uint256& hashBlock, bool erase = true) override;
+
+    /** Stop reading from the view below until ResumeFetching(), e.g. while it
+     * is being reconfigured. Waits for reads in progress. */
+    void PauseFetching() { m_stage->Pause(); }
+    void ResumeFetching() { m_stage->Resume(); }
+
+    /** The stage to prefetch coins into. It stays safe to use after the view is gone. */
+    const std::shared_ptr<Stage>& GetStage() const { return m_stage; }
+
+private:
+    const std::shared_ptr<Stage> m_stage;
+};
+
+/**
+ * CCoinsView between the coins cache and the database, which can write the
+ * cache out on a background thread, so that blocks are connected while the
+ * database is written instead of waiting for it under cs_main.
+ *
+ * A BatchWrite() that was allowed to (see AllowBackgroundWrite()) moves the
+ * changed coins into a pending write and returns. Until the thread has
+ * written them, reads find them in the pending write rather than in the
+ * database. Writes happen one at a time and in order, each in batches of
+ * -dbbatchsize, so the database goes through the same states as with
+ * synchronous flushes and its head-blocks marker still covers a write that is
+ * interrupted by a crash. Cursor() sees the database only; callers flush
+ * synchronously first.
+ *
+ * The coins of the pending write take memory in addition to the cache, which
+ * grows again while they are written.
+ */
+class CCoinsViewBackgroundFlush final : public CCoinsViewBacked
+{
+public:
+    struct Stats {
+        //! Writes to the view below
+        uint64_t flushes{0};
+        //! Changed coins written
+        uint64_t coins{0};
+        //! Time spent writing
+        std::chrono::microseconds duration{0};
+        std::chrono::microseconds last_duration{0};
+        //! Time callers of BatchWrite() and WaitForFlush() were held up by writes
+        std::chrono::microseconds stall{0};
+        //! Whether a write is in progress
+        bool pending{false};
+    };
+
+    CCoinsViewBackgroundFlush(CCoinsView* view, bool background);
+    /** Finishes the pending write, if any. */
+    ~CCoinsViewBackgroundFlush();
+
+    bool GetCoin(const COutPoint& outpoint, Coin& coin) const override;
+    bool HaveCoin(const COutPoint& outpoint) const override;
+    uint256 GetBestBlock() const override;
+    bool BatchWrite(CCoinsMap& mapCoins, const uint256& hashBlock, bool erase = true) override;
+
+    /** Let the next BatchWrite() that erases the written coins return before
+     * they are written, if enabled. Other writes wait for the pending one and
+     * are written synchronously. */
+    void AllowBackgroundWrite() EXCLUSIVE_LOCKS_REQUIRED(!m_mutex);
+
+    /** Wait until the pending write is done. Returns false if a write failed. */
+    bool WaitForFlush() EXCLUSIVE_LOCKS_REQUIRED(!m_mutex);
+
+    Stats GetStats() const EXCLUSIVE_LOCKS_REQUIRED(!m_mutex);
+
+private:
+    struct PendingWrite {
+        CCoinsMapMemoryResource resource;
+        CCoinsMap coins{0, SaltedOutpointHasher{}, CCoinsMap::key_equal{}, &resource};
+        uint256 block;
+    };
+
+    void ThreadFlush() EXCLUSIVE_LOCKS_REQUIRED(!m_mutex);
+    /** Wait for the pending write, adding the wait to the stall time. */
+    bool WaitForPending(UniqueLock<Mutex>& lock) EXCLUSIVE_LOCKS_REQUIRED(m_mutex);
+    std::shared_ptr<const PendingWrite> GetPending() const EXCLUSIVE_LOCKS_REQUIRED(!m_mutex);
+
+    const bool m_background;
+    mutable Mutex m_mutex;
+    //! Signals a new or finished pending write
+    std::condition_variable m_cv;
+    std::shared_ptr<const PendingWrite> m_pending GUARDED_BY(m_mutex);
+    bool m_allow_background GUARDED_BY(m_mutex){false};
+    //! Set when a write failed, after which the pending write is kept for reads but nothing more is written
+    bool m_failed GUARDED_BY(m_mutex){false};
+    bool m_stop GUARDED_BY(m_mutex){false};
+    Stats m_stats GUARDED_BY(m_mutex);
+    std::thread m_thread;
+};
+
 #endif // REGUS_TXDB_H
@@ -20,6 +20,7 @@
 #include <consensus/tx_check.h>
 #include <consensus/tx_verify.h>
 #include <consensus/validation.h>
+#include <crypto/ethash/include/ethash/progpow.hpp>
 #include <cuckoocache.h>
 #include <flatfile.h>
 #include <hash.h>
@@ -32,6 +33,7 @@
 #include <kernel/notifications_interface.h>
 #include <logging.h>
 #include <logging/timer.h>
+#include <node/block_file_scanner.h>
 #include <node/blockstorage.h>
 #include <node/utxo_snapshot.h>
 #include <policy/v3_policy.h>
@@ -86,6 +88,7 @@ using node::BlockMap;
 using node::CBlockIndexHeightOnlyComparator;
 using node::CBlockIndexWorkComparator;
 using node::fReindex;
+using node::SnapshotCoinsReader;
 using node::SnapshotMetadata;
 
 /** Time to wait between writing blocks/block index to disk. */
@@ -1708,13 +1711,15 @@ CAmount GetBlockSubsidy(int nHeight, const Consensus::Params& consensusParams)
 }
 
 CoinsViews::CoinsViews(DBParams db_params, CoinsViewOptions options)
-    : m_dbview{std::move(db_params), std::move(options)},
-      m_catcherview(&m_dbview) {}
+    : m_dbview{std::move(db_params), options},
+      m_catcherview(&m_dbview),
+      m_flushview(&m_catcherview, options.background_flush),
+      m_prefetchview(&m_flushview) {}
 
 void CoinsViews::InitCache()
 {
     AssertLockHeld(::cs_main);
-    m_cacheview = std::make_unique<CCoinsViewCache>(&m_catcherview);
+    m_cacheview = std::make_unique<CCoinsViewCache>(&m_prefetchview);
 }
 
 Chainstate::Chainstate(
@@ -2188,8 +2193,9 @@ bool Chainstate::ConnectBlock(const CBlock& block, BlockValidationState& state,
     AssertLockHeld(cs_main);
     assert(pindex);
 
-    uint256 hashMix;
-    uint256 block_hash{block.GetHash(hashMix)};
+    // The mix was verified when the block was checked, so only the final
+    // hash is needed to identify it.
+    uint256 block_hash{block.GetHash()};
     assert(*pindex->phashBlock == block_hash);
     const bool parallel_script_checks{m_chainman.GetCheckQueue().HasThreads()};
 
@@ -2593,6 +2599,12 @@ bool Chainstate::FlushStateToDisk(
             if (!CheckDiskSpace(m_chainman.m_options.datadir, 48 * 2 * 2 * CoinsTip().GetCacheSize())) {
                 return FatalError(m_chainman.GetNotifications(), state, "Disk space is too low!", _("Disk space is too low!"));
             }
+            // Write the coins on a background thread, unless the caller needs
+            // them on disk or the flush comes with pruning, whose block files
+            // the database may no longer need once the coins are written.
+            if (mode != FlushStateMode::ALWAYS && !fFlushForPrune) {
+                m_coins_views->m_flushview.AllowBackgroundWrite();
+            }
             // Flush the chainstate (which may refer to block index entries).
             if (!CoinsTip().Flush())
                 return FatalError(m_chainman.GetNotifications(), state, "Failed to write to coin database");
@@ -2607,8 +2619,15 @@ bool Chainstate::FlushStateToDisk(
         }
     }
     if (full_flush_completed) {
+        m_unsignalled_flush = m_chain.GetLocator();
+    }
+    // Indexes and wallets record the locator as their progress, so it must not
+    // get ahead of the coins on disk. A flush written in the background is
+    // signalled by the first call that finds the write done.
+    if (m_unsignalled_flush && !m_coins_views->m_flushview.GetStats().pending) {
         // Update best block in wallet (so we can detect restored wallets).
-        GetMainSignals().ChainStateFlushed(this->GetRole(), m_chain.GetLocator());
+        GetMainSignals().ChainStateFlushed(this->GetRole(), *m_unsignalled_flush);
+        m_unsignalled_flush.reset();
     }
     } catch (const std::runtime_error& e) {
         return FatalError(m_chainman.GetNotifications(), state, std::string("System error while flushing: ") + e.what());
@@ -2661,6 +2680,22 @@ static void UpdateTipLog(
         !warning_messages.empty() ? strprintf(" warning='%s'", warning_messages) : "");
 }
 
+/**
+ * Build the light caches of the epochs after the tip's in the background, so
+ * that ConnectTip() does not wait for one when the chain crosses into the
+ * next epoch. When the best header is further ahead, as during initial block
+ * download and -reindex, up to lookahead epochs are built concurrently; the
+ * tip's epoch is marked as recently used so that it stays resident.
+ */
+static void PrebuildEpochContexts(int tip_height, int best_header_height, int lookahead)
+{
+    const int epoch{ethash::get_epoch_number(tip_height + 1)};
+    const int last_epoch{std::min(epoch + lookahead, ethash::get_epoch_number(std::max(tip_height + 1, best_header_height)))};
+    for (int n = epoch; n <= last_epoch; ++n) {
+        ethash::prebuild_epoch_context(n);
+    }
+}
+
 void Chainstate::UpdateTip(const CBlockIndex* pindexNew)
 {
     AssertLockHeld(::cs_main);
@@ -2690,6 +2725,15 @@ void Chainstate::UpdateTip(const CBlockIndex* pindexNew)
         g_best_block_cv.notify_all();
     }
 
+    // Keep the -powdag dataset on the epoch of the next block. During initial
+    // block download the chain moves through epochs too quickly for it to pay off.
+    if (!m_chainman.IsInitialBlockDownload()) {
+        progpow::select_dataset_epoch(ethash::get_epoch_number(pindexNew->nHeight + 1));
+    }
+
+    const CBlockIndex* best_header{m_chainman.m_best_header};
+    PrebuildEpochContexts(pindexNew->nHeight, best_header ? best_header->nHeight : pindexNew->nHeight, m_chainman.m_options.pow_epoch_lookahead);
+
     bilingual_str warning_messages;
     if (!m_chainman.IsInitialBlockDownload()) {
         const CBlockIndex* pindex = pindexNew;
@@ -2840,11 +2884,17 @@ bool Chainstate::ConnectTip(BlockValidationState& state, CBlockIndex* pindexNew,
     const auto time_1{SteadyClock::now()};
     std::shared_ptr<const CBlock> pthisBlock;
     if (!pblock) {
-        std::shared_ptr<CBlock> pblockNew = std::make_shared<CBlock>();
-        if (!m_blockman.ReadBlockFromDisk(*pblockNew, *pindexNew)) {
-            return FatalError(m_chainman.GetNotifications(), state, "Failed to read block");
+        // Use the copy checked ahead of time by the prevalidator if there is one.
+        pthisBlock = m_chainman.GetBlockPrevalidator().Take(pindexNew->GetBlockHash());
+        if (pthisBlock) {
+            LogPrint(BCLog::BENCH, "  - Using prevalidated block\n");
+        } else {
+            std::shared_ptr<CBlock> pblockNew = std::make_shared<CBlock>();
+            if (!m_blockman.ReadBlockFromDisk(*pblockNew, *pindexNew)) {
+                return FatalError(m_chainman.GetNotifications(), state, "Failed to read block");
+            }
+            pthisBlock = pblockNew;
         }
-        pthisBlock = pblockNew;
     } else {
         LogPrint(BCLog::BENCH, "  - Using cached block\n");
         pthisBlock = pblock;
@@ -2900,6 +2950,12 @@ bool Chainstate::ConnectTip(BlockValidationState& state, CBlockIndex* pindexNew,
     // Update m_chain & related variables.
     m_chain.SetTip(*pindexNew);
     UpdateTip(pindexNew);
+    if (pindexNew->nHeight % ethash::epoch_length == 0) {
+        const ethash::epoch_context_stats stats{ethash::get_epoch_context_stats()};
+        LogPrintf("Reached ProgPoW epoch %d; %u of %u epoch contexts were built ahead of their first use (%.1f%%)\n",
+                  ethash::get_epoch_number(pindexNew->nHeight), stats.hits, stats.hits + stats.misses,
+                  100.0 * stats.hits / std::max<uint64_t>(stats.hits + stats.misses, 1));
+    }
 
     const auto time_6{SteadyClock::now()};
     time_post_connect += time_6 - time_5;
@@ -3049,6 +3105,15 @@ bool Chainstate::ActivateBestChainStep(BlockValidationState& state, CBlockIndex*
         }
         nHeight = nTargetHeight;
 
+        // Have the blocks read and checked, and the coins they spend read,
+        // on the worker threads while the ones before them are connected.
+        const auto coins{m_chainman.m_options.utxo_prefetch ? m_coins_views->m_prefetchview.GetStage() : nullptr};
+        for (CBlockIndex* pindexConnect : reverse_iterate(vpindexToConnect)) {
+            if (pindexConnect == pindexMostWork && pblock) continue;
+            if (!(pindexConnect->nStatus & BLOCK_HAVE_DATA)) continue;
+            m_chainman.GetBlockPrevalidator().Prefetch(pindexConnect->GetBlockHash(), pindexConnect->GetBlockPos(), coins);
+        }
+
         // Connect new blocks.
         for (CBlockIndex* pindexConnect : reverse_iterate(vpindexToConnect)) {
             if (!ConnectTip(state, pindexConnect, pindexConnect == pindexMostWork ? pblock : std::shared_ptr<const CBlock>(), connectTrace, disconnectpool)) {
@@ -3566,11 +3631,15 @@ void ChainstateManager::ReceivedBlockTransactions(const CBlock& block, CBlockInd
 
 static bool CheckBlockHeader(const CBlockHeader& block, BlockValidationState& state, const Consensus::Params& consensusParams, bool fCheckPOW = true)
 {
-    uint256 hashMix;
-    if (fCheckPOW && !CheckProofOfWork(block.GetHash(hashMix), block.nBits, consensusParams))
+    if (!fCheckPOW) return true;
+
+    // Reject headers that do not claim enough work before paying for the mix.
+    if (!CheckProofOfWorkFinalHash(block, consensusParams))
         return state.Invalid(BlockValidationResult::BLOCK_INVALID_HEADER, "high-hash", "proof of work failed");
-        
-    if (fCheckPOW && hashMix != block.hashMix)
+
+    // The claimed hashMix yields a final hash below the target, so a wrong
+    // mix can only be the result of grinding the cheap first stage.
+    if (!CheckProofOfWorkMix(block))
         return state.Invalid(BlockValidationResult::BLOCK_INVALID_HEADER, "invalid-hash-mix", "hashMix validity failed");
 
     return true;
@@ -3666,8 +3735,11 @@ bool CheckBlock(const CBlock& block, BlockValidationState& state, const Consensu
 
     // Check that the header is valid (particularly PoW).  This is mostly
     // redundant with the call in AcceptBlockHeader.
-    if (!CheckBlockHeader(block, state, consensusParams, fCheckPOW))
-        return false;
+    if (!block.m_checked_pow) {
+        if (!CheckBlockHeader(block, state, consensusParams, fCheckPOW))
+            return false;
+        block.m_checked_pow = fCheckPOW;
+    }
 
     // Check the merkle root.
     if (fCheckMerkleRoot && !CheckMerkleRoot(block, state)) {
@@ -3756,10 +3828,49 @@ std::vector<unsigned char> ChainstateManager::GenerateCoinbaseCommitment(CBlock&
     return commitment;
 }
 
-bool HasValidProofOfWork(const std::vector<CBlockHeader>& headers, const Consensus::Params& consensusParams)
+bool CHeaderPowCheck::operator()()
 {
-    return std::all_of(headers.cbegin(), headers.cend(),
-            [&](const auto& header) { return CheckProofOfWork(header.GetHash(), header.nBits, consensusParams);});
+    // The final hashes of the whole chunk are computed at once, and the mix
+    // is only paid for once all of them claim enough work.
+    const std::vector<uint256> hashes{ETHashBatch(m_headers)};
+    for (size_t i = 0; i < m_headers.size(); ++i) {
+        if (!CheckProofOfWork(hashes[i], m_headers[i].nBits, *m_params)) return false;
+    }
+    for (size_t i = 0; i < m_headers.size(); ++i) {
+        if (m_check_mix[i] && !CheckProofOfWorkMix(m_headers[i])) return false;
+    }
+    return true;
+}
+
+bool HasValidProofOfWork(Span<const CBlockHeader> headers, const Consensus::Params& consensusParams,
+                         HeadersMixCheck mix_check, CCheckQueue<CHeaderPowCheck>* queue)
+{
+    FastRandomContext rng;
+    std::vector<CHeaderPowCheck> checks;
+    checks.reserve((headers.size() + HEADERS_POW_CHECK_CHUNK - 1) / HEADERS_POW_CHECK_CHUNK);
+    for (size_t begin = 0; begin < headers.size(); begin += HEADERS_POW_CHECK_CHUNK) {
+        const size_t end{std::min(begin + HEADERS_POW_CHECK_CHUNK, headers.size())};
+        std::vector<bool> check_mix(end - begin, mix_check == HeadersMixCheck::ALL);
+        if (mix_check == HeadersMixCheck::SAMPLE) {
+            for (size_t i = begin; i < end; ++i) {
+                check_mix[i - begin] = i + 1 == headers.size() || rng.randrange(HEADERS_MIX_SAMPLE_RATE) == 0;
+            }
+        }
+        checks.emplace_back(headers.subspan(begin, end - begin), std::move(check_mix), consensusParams);
+    }
+
+    if (!queue || !queue->HasThreads()) {
+        return std::all_of(checks.begin(), checks.end(), [](CHeaderPowCheck& check) { return check(); });
+    }
+    CCheckQueueControl<CHeaderPowCheck> control(queue);
+    control.Add(std::move(checks));
+    return control.Wait();
+}
+
+bool ChainstateManager::HasValidProofOfWork(const std::vector<CBlockHeader>& headers)
+{
+    AssertLockNotHeld(::cs_main);
+    return ::HasValidProofOfWork(headers, GetConsensus(), HeadersMixCheck::NONE, &m_header_pow_check_queue);
 }
 
 bool IsBlockMutated(const CBlock& block, bool check_witness_root)
@@ -4033,6 +4144,29 @@ bool ChainstateManager::AcceptBlockHeader(const CBlockHeader& block, BlockValida
 bool ChainstateManager::ProcessNewBlockHeaders(const std::vector<CBlockHeader>& headers, bool min_pow_checked, BlockValidationState& state, const CBlockIndex** ppindex)
 {
     AssertLockNotHeld(cs_main);
+    // Verify the mix of the headers on the -par threads with the
+    // -headersmixcheck policy, so that AcceptBlockHeader() finds it cached. A
+    // mix needs the light cache of the epoch given by nHeight, which the sender
+    // picks, so only the headers that extend a known block at the right height
+    // are checked, up to the epoch after the best header's. The rest, and any
+    // failure, are left to AcceptBlockHeader().
+    size_t connected{0};
+    {
+        LOCK(cs_main);
+        const CBlockIndex* prev{headers.empty() ? nullptr : m_blockman.LookupBlockIndex(headers[0].hashPrevBlock)};
+        if (prev && m_best_header) {
+            const int max_epoch{ethash::get_epoch_number(m_best_header->nHeight) + 1};
+            for (; connected < headers.size(); ++connected) {
+                const CBlockHeader& header{headers[connected]};
+                if (header.nHeight != prev->nHeight + 1 + int(connected)) break;
+                if (ethash::get_epoch_number(header.nHeight) > max_epoch) break;
+                if (connected > 0 && header.hashPrevBlock != headers[connected - 1].GetHash()) break;
+            }
+        }
+    }
+    if (connected > 0) {
+        ::HasValidProofOfWork(Span{headers}.first(connected), GetConsensus(), m_options.headers_mix_check, &m_header_pow_check_queue);
+    }
     {
         LOCK(cs_main);
         for (const CBlockHeader& header : headers) {
@@ -4196,9 +4330,20 @@ bool ChainstateManager::ProcessNewBlock(const std::shared_ptr<const CBlock>& blo
         // https://lists.linuxfoundation.org/pipermail/regus-dev/2019-February/016697.html.  Because CheckBlock() is
         // not very expensive, the anti-DoS benefits of caching failure (of a definitely-invalid block) are not substantial.
         bool ret = CheckBlock(*block, state, GetConsensus());
+        bool stored{false};
         if (ret) {
             // Store to disk
-            ret = AcceptBlock(block, state, &pindex, force_processing, nullptr, new_block, min_pow_checked);
+            ret = AcceptBlock(block, state, &pindex, force_processing, nullptr, &stored, min_pow_checked);
+        }
+        if (new_block) *new_block = stored;
+        // A block received ahead of its parents stays checked until it can
+        // be connected, unless it is too far ahead to be kept that long. Only
+        // the copy AcceptBlock() just wrote is kept: a block it already had,
+        // or did not want, skipped ContextualCheckBlock(), so this copy may
+        // differ from the one on disk, e.g. in its witness.
+        if (ret && stored && !pindex->HaveNumChainTxs() &&
+            pindex->nHeight <= ActiveHeight() + static_cast<int>(node::MAX_PREVALIDATED_BLOCKS)) {
+            m_block_prevalidator.Add(block);
         }
         if (!ret) {
             GetMainSignals().BlockChecked(*block, state);
@@ -4248,8 +4393,7 @@ bool TestBlockValidity(BlockValidationState& state,
     assert(pindexPrev && pindexPrev == chainstate.m_chain.Tip());
     CCoinsViewCache viewNew(&chainstate.CoinsTip());
 
-    uint256 hashMix;
-    uint256 block_hash(block.GetHash(hashMix));
+    uint256 block_hash(block.GetHash());
     CBlockIndex indexDummy(block);
     indexDummy.pprev = pindexPrev;
     indexDummy.nHeight = pindexPrev->nHeight + 1;
@@ -4652,6 +4796,127 @@ bool Chainstate::LoadGenesisBlock()
     return true;
 }
 
+//! Read a block found earlier in a block file, or return null if it can't be read.
+static std::shared_ptr<CBlock> ReadExternalBlock(const BlockManager& blockman, const FlatFilePos& pos)
+{
+    auto pblock{std::make_shared<CBlock>()};
+    if (!blockman.ReadBlockFromDisk(*pblock, pos)) return nullptr;
+    return pblock;
+}
+
+ChainstateManager::ExternalBlockResult ChainstateManager::ImportExternalBlock(
+    const CBlockHeader& header,
+    const std::function<std::shared_ptr<CBlock>()>& read_block,
+    const std::function<std::shared_ptr<CBlock>(const FlatFilePos&)>& read_child,
+    FlatFilePos* dbp,
+    std::multimap<uint256, FlatFilePos>* blocks_with_unknown_parent,
+    int& nLoaded)
+{
+    const CChainParams& params{GetParams()};
+    const uint256 hash{header.GetHash()};
+
+    std::shared_ptr<CBlock> pblock{}; // needs to remain available after the cs_main lock is released to avoid duplicate reads from disk
+
+    {
+        LOCK(cs_main);
+        // detect out of order blocks, and store them for later
+        if (hash != params.GetConsensus().hashGenesisBlock && !m_blockman.LookupBlockIndex(header.hashPrevBlock)) {
+            LogPrint(BCLog::REINDEX, "LoadExternalBlockFile: Out of order block %s, parent %s not known\n", hash.ToString(),
+                     header.hashPrevBlock.ToString());
+            if (dbp && blocks_with_unknown_parent) {
+                blocks_with_unknown_parent->emplace(header.hashPrevBlock, *dbp);
+                return ExternalBlockResult::DEFERRED;
+            }
+            return ExternalBlockResult::DONE;
+        }
+
+        // process in case the block isn't known yet
+        const CBlockIndex* pindex = m_blockman.LookupBlockIndex(hash);
+        if (!pindex || (pindex->nStatus & BLOCK_HAVE_DATA) == 0) {
+            // This block can be processed immediately; read and deserialize it.
+            pblock = read_block();
+
+            BlockValidationState state;
+            if (AcceptBlock(pblock, state, nullptr, true, dbp, nullptr, true)) {
+                nLoaded++;
+            }
+            if (state.IsError()) {
+                return ExternalBlockResult::STOP;
+            }
+        } else if (hash != params.GetConsensus().hashGenesisBlock && pindex->nHeight % 1000 == 0) {
+            LogPrint(BCLog::REINDEX, "Block Import: already had block %s at height %d\n", hash.ToString(), pindex->nHeight);
+        }
+    }
+
+    // Activate the genesis block so normal node progress can continue
+    if (hash == params.GetConsensus().hashGenesisBlock) {
+        bool genesis_activation_failure = false;
+        for (auto c : GetAll()) {
+            BlockValidationState state;
+            if (!c->ActivateBestChain(state, nullptr)) {
+                genesis_activation_failure = true;
+                break;
+            }
+        }
+        if (genesis_activation_failure) {
+            return ExternalBlockResult::STOP;
+        }
+    }
+
+    if (m_blockman.IsPruneMode() && !fReindex && pblock) {
+        // must update the tip for pruning to work while importing with -loadblock.
+        // this is a tradeoff to conserve disk space at the expense of time
+        // spent updating the tip to be able to prune.
+        // otherwise, ActivateBestChain won't be called by the import process
+        // until after all of the block files are loaded. ActivateBestChain can be
+        // called by concurrent network message processing. but, that is not
+        // reliable for the purpose of pruning while importing.
+        bool activation_failure = false;
+        for (auto c : GetAll()) {
+            BlockValidationState state;
+            if (!c->ActivateBestChain(state, pblock)) {
+                LogPrint(BCLog::REINDEX, "failed to activate chain (%s)\n", state.ToString());
+                activation_failure = true;
+                break;
+            }
+        }
+        if (activation_failure) {
+            return ExternalBlockResult::STOP;
+        }
+    }
+
+    NotifyHeaderTip(*this);
+
+    if (!blocks_with_unknown_parent) return ExternalBlockResult::DONE;
+
+    // Recursively process earlier encountered successors of this block
+    std::deque<uint256> queue;
+    queue.push_back(hash);
+    while (!queue.empty()) {
+        uint256 head = queue.front();
+        queue.pop_front();
+        auto range = blocks_with_unknown_parent->equal_range(head);
+        while (range.first != range.second) {
+            std::multimap<uint256, FlatFilePos>::iterator it = range.first;
+            std::shared_ptr<CBlock> pblockrecursive = read_child(it->second);
+            if (pblockrecursive) {
+                LogPrint(BCLog::REINDEX, "LoadExternalBlockFile: Processing out of order child %s of %s\n", pblockrecursive->GetHash().ToString(),
+                        head.ToString());
+                LOCK(cs_main);
+                BlockValidationState dummy;
+                if (AcceptBlock(pblockrecursive, dummy, nullptr, true, &it->second, nullptr, true)) {
+                    nLoaded++;
+                    queue.push_back(pblockrecursive->GetHash());
+                }
+            }
+            range.first++;
+            blocks_with_unknown_parent->erase(it);
+            NotifyHeaderTip(*this);
+        }
+    }
+    return ExternalBlockResult::DONE;
+}
+
 void ChainstateManager::LoadExternalBlockFile(
     AutoFile& file_in,
     FlatFilePos* dbp,
@@ -4702,113 +4967,24 @@ void ChainstateManager::LoadExternalBlockFile(
                 blkdat.SetLimit(nBlockPos + nSize);
                 CBlockHeader header;
                 blkdat >> header;
-                const uint256 hash{header.GetHash()};
                 // Skip the rest of this block (this may read from disk into memory); position to the marker before the
                 // next block, but it's still possible to rewind to the start of the current block (without a disk read).
                 nRewind = nBlockPos + nSize;
                 blkdat.SkipTo(nRewind);
 
-                std::shared_ptr<CBlock> pblock{}; // needs to remain available after the cs_main lock is released to avoid duplicate reads from disk
-
-                {
-                    LOCK(cs_main);
-                    // detect out of order blocks, and store them for later
-                    if (hash != params.GetConsensus().hashGenesisBlock && !m_blockman.LookupBlockIndex(header.hashPrevBlock)) {
-                        LogPrint(BCLog::REINDEX, "%s: Out of order block %s, parent %s not known\n", __func__, hash.ToString(),
-                                 header.hashPrevBlock.ToString());
-                        if (dbp && blocks_with_unknown_parent) {
-                            blocks_with_unknown_parent->emplace(header.hashPrevBlock, *dbp);
-                        }
-                        continue;
-                    }
-
-                    // process in case the block isn't known yet
-                    const CBlockIndex* pindex = m_blockman.LookupBlockIndex(hash);
-                    if (!pindex || (pindex->nStatus & BLOCK_HAVE_DATA) == 0) {
-                        // This block can be processed immediately; rewind to its start, read and deserialize it.
+                const auto result{ImportExternalBlock(
+                    header,
+                    [&] {
+                        // Rewind to the start of the block, read and deserialize it.
                         blkdat.SetPos(nBlockPos);
-                        pblock = std::make_shared<CBlock>();
+                        auto pblock{std::make_shared<CBlock>()};
                         blkdat >> TX_WITH_WITNESS(*pblock);
                         nRewind = blkdat.GetPos();
-
-                        BlockValidationState state;
-                        if (AcceptBlock(pblock, state, nullptr, true, dbp, nullptr, true)) {
-                            nLoaded++;
-                        }
-                        if (state.IsError()) {
-                            break;
-                        }
-                    } else if (hash != params.GetConsensus().hashGenesisBlock && pindex->nHeight % 1000 == 0) {
-                        LogPrint(BCLog::REINDEX, "Block Import: already had block %s at height %d\n", hash.ToString(), pindex->nHeight);
-                    }
-                }
-
-                // Activate the genesis block so normal node progress can continue
-                if (hash == params.GetConsensus().hashGenesisBlock) {
-                    bool genesis_activation_failure = false;
-                    for (auto c : GetAll()) {
-                        BlockValidationState state;
-                        if (!c->ActivateBestChain(state, nullptr)) {
-                            genesis_activation_failure = true;
-                            break;
-                        }
-                    }
-                    if (genesis_activation_failure) {
-                        break;
-                    }
-                }
-
-                if (m_blockman.IsPruneMode() && !fReindex && pblock) {
-                    // must update the tip for pruning to work while importing with -loadblock.
-                    // this is a tradeoff to conserve disk space at the expense of time
-                    // spent updating the tip to be able to prune.
-                    // otherwise, ActivateBestChain won't be called by the import process
-                    // until after all of the block files are loaded. ActivateBestChain can be
-                    // called by concurrent network message processing. but, that is not
-                    // reliable for the purpose of pruning while importing.
-                    bool activation_failure = false;
-                    for (auto c : GetAll()) {
-                        BlockValidationState state;
-                        if (!c->ActivateBestChain(state, pblock)) {
-                            LogPrint(BCLog::REINDEX, "failed to activate chain (%s)\n", state.ToString());
-                            activation_failure = true;
-                            break;
-                        }
-                    }
-                    if (activation_failure) {
-                        break;
-                    }
-                }
-
-                NotifyHeaderTip(*this);
-
-                if (!blocks_with_unknown_parent) continue;
-
-                // Recursively process earlier encountered successors of this block
-                std::deque<uint256> queue;
-                queue.push_back(hash);
-                while (!queue.empty()) {
-                    uint256 head = queue.front();
-                    queue.pop_front();
-                    auto range = blocks_with_unknown_parent->equal_range(head);
-                    while (range.first != range.second) {
-                        std::multimap<uint256, FlatFilePos>::iterator it = range.first;
-                        std::shared_ptr<CBlock> pblockrecursive = std::make_shared<CBlock>();
-                        if (m_blockman.ReadBlockFromDisk(*pblockrecursive, it->second)) {
-                            LogPrint(BCLog::REINDEX, "%s: Processing out of order child %s of %s\n", __func__, pblockrecursive->GetHash().ToString(),
-                                    head.ToString());
-                            LOCK(cs_main);
-                            BlockValidationState dummy;
-                            if (AcceptBlock(pblockrecursive, dummy, nullptr, true, &it->second, nullptr, true)) {
-                                nLoaded++;
-                                queue.push_back(pblockrecursive->GetHash());
-                            }
-                        }
-                        range.first++;
-                        blocks_with_unknown_parent->erase(it);
-                        NotifyHeaderTip(*this);
-                    }
-                }
+                        return pblock;
+                    },
+                    [&](const FlatFilePos& pos) { return ReadExternalBlock(m_blockman, pos); },
+                    dbp, blocks_with_unknown_parent, nLoaded)};
+                if (result == ExternalBlockResult::STOP) break;
             } catch (const std::exception& e) {
                 // historical bugs added extra data to the block files that does not deserialize cleanly.
                 // commonly this data is between readable blocks, but it does not really matter. such data is not fatal to the import process.
@@ -4830,6 +5006,121 @@ void ChainstateManager::LoadExternalBlockFile(
     LogPrintf("Loaded %i blocks from external file in %dms\n", nLoaded, Ticks<std::chrono::milliseconds>(SteadyClock::now() - start));
 }
 
+/** Serialized size of the blocks with unknown parent LoadExternalBlockFiles() keeps in memory */
+static constexpr size_t MAX_DEFERRED_IMPORT_BYTES{64 << 20};
+
+void ChainstateManager::LoadExternalBlockFiles(const std::vector<fs::path>& files, bool reindex)
+{
+    // Map of disk positions for blocks with unknown parent (only used for reindex);
+    // parent hash -> child disk position, multiple children can have the same parent.
+    std::multimap<uint256, FlatFilePos> blocks_with_unknown_parent;
+
+    const auto log_file{[&](size_t n) {
+        if (reindex) {
+            LogPrintf("Reindexing block file blk%05u.dat...\n", (unsigned int)n);
+        } else {
+            LogPrintf("Importing blocks file %s...\n", fs::PathToString(files[n]));
+        }
+    }};
+    // A block file that can't be opened ends a reindex, while -loadblock
+    // moves on to the next file.
+    const auto open_failed{[&](size_t n) {
+        if (reindex) {
+            LogPrintf("Unable to open file %s\n", fs::PathToString(files[n]));
+        } else {
+            LogPrintf("Warning: Could not open blocks file %s\n", fs::PathToString(files[n]));
+        }
+        return reindex;
+    }};
+
+    if (m_options.worker_threads_num == 0) {
+        for (size_t n = 0; n < files.size(); ++n) {
+            AutoFile file{fsbridge::fopen(files[n], "rb")};
+            if (file.IsNull()) {
+                if (open_failed(n)) break;
+                continue;
+            }
+            log_file(n);
+            if (reindex) {
+                FlatFilePos pos(n, 0);
+                LoadExternalBlockFile(file, &pos, &blocks_with_unknown_parent);
+            } else {
+                LoadExternalBlockFile(file);
+            }
+            if (m_interrupt) return;
+        }
+        return;
+    }
+
+    node::BlockFileScanner scanner{GetParams(), files, m_options.worker_threads_num};
+
+    // Blocks with unknown parent are kept, up to MAX_DEFERRED_IMPORT_BYTES, so
+    // that they are not read and checked again once their parent is found.
+    struct DeferredBlock {
+        std::shared_ptr<CBlock> block;
+        unsigned int size;
+    };
+    std::map<std::pair<int, unsigned int>, DeferredBlock> deferred_blocks;
+    std::deque<std::pair<int, unsigned int>> deferred_order;
+    size_t deferred_bytes{0};
+    const auto read_child{[&](const FlatFilePos& pos) {
+        const auto it{deferred_blocks.find({pos.nFile, pos.nPos})};
+        if (it == deferred_blocks.end()) return ReadExternalBlock(m_blockman, pos);
+        std::shared_ptr<CBlock> pblock{std::move(it->second.block)};
+        deferred_bytes -= it->second.size;
+        deferred_blocks.erase(it);
+        return pblock;
+    }};
+
+    for (size_t n = 0; n < files.size(); ++n) {
+        if (!scanner.Open(n)) {
+            if (open_failed(n)) break;
+            scanner.Finish(n);
+            continue;
+        }
+        log_file(n);
+
+        const auto start{SteadyClock::now()};
+        int nLoaded = 0;
+        FlatFilePos pos(n, 0);
+        while (const auto found{scanner.Next(n)}) {
+            if (m_interrupt) return;
+
+            pos.nPos = found->pos;
+            try {
+                const auto result{ImportExternalBlock(
+                    *found->block,
+                    [&] { return found->block; },
+                    read_child,
+                    reindex ? &pos : nullptr,
+                    reindex ? &blocks_with_unknown_parent : nullptr,
+                    nLoaded)};
+                if (result == ExternalBlockResult::STOP) break;
+                if (result == ExternalBlockResult::DEFERRED) {
+                    deferred_blocks.try_emplace({pos.nFile, pos.nPos}, DeferredBlock{found->block, found->size});
+                    deferred_order.emplace_back(pos.nFile, pos.nPos);
+                    deferred_bytes += found->size;
+                    while (deferred_bytes > MAX_DEFERRED_IMPORT_BYTES) {
+                        const auto it{deferred_blocks.find(deferred_order.front())};
+                        if (it != deferred_blocks.end()) {
+                            deferred_bytes -= it->second.size;
+                            deferred_blocks.erase(it);
+                        }
+                        deferred_order.pop_front();
+                    }
+                }
+            } catch (const std::exception& e) {
+                // As in LoadExternalBlockFile(), such data is not fatal to the import process.
+                LogPrint(BCLog::REINDEX, "LoadExternalBlockFile: unexpected data at file offset 0x%x - %s. continuing\n", found->pos, e.what());
+            }
+        }
+        if (const auto error{scanner.Finish(n)}) {
+            GetNotifications().fatalError(*error);
+        }
+        LogPrintf("Loaded %i blocks from external file in %dms\n", nLoaded, Ticks<std::chrono::milliseconds>(SteadyClock::now() - start));
+    }
+}
+
 void ChainstateManager::CheckBlockIndex()
 {
     if (!ShouldCheckBlockIndex()) {
@@ -5102,7 +5393,15 @@ bool Chainstate::ResizeCoinsCaches(size_t coinstip_size, size_t coinsdb_size)
     size_t old_coinstip_size = m_coinstip_cache_size_bytes;
     m_coinstip_cache_size_bytes = coinstip_size;
     m_coinsdb_cache_size_bytes = coinsdb_size;
+    m_coins_views->m_prefetchview.PauseFetching();
+    // The database is reopened, so the background write must be done.
+    if (!m_coins_views->m_flushview.WaitForFlush()) {
+        m_coins_views->m_prefetchview.ResumeFetching();
+        BlockValidationState state;
+        return FatalError(m_chainman.GetNotifications(), state, "Failed to write to coin database");
+    }
     CoinsDB().ResizeCache(coinsdb_size);
+    m_coins_views->m_prefetchview.ResumeFetching();
 
     LogPrintf("[%s] resized coinsdb cache to %.1f MiB\n",
         this->ToString(), coinsdb_size * (1.0 / 1024 / 1024));
@@ -5406,72 +5705,58 @@ bool ChainstateManager::PopulateAndValidateSnapshot(
         return false;
     }
 
-    COutPoint outpoint;
-    Coin coin;
     const uint64_t coins_count = metadata.m_coins_count;
-    uint64_t coins_left = metadata.m_coins_count;
 
     LogPrintf("[snapshot] loading coins from snapshot %s\n", base_blockhash.ToString());
     int64_t coins_processed{0};
 
-    while (coins_left > 0) {
-        try {
-            coins_file >> outpoint;
-            coins_file >> coin;
-        } catch (const std::ios_base::failure&) {
-            LogPrintf("[snapshot] bad snapshot format or truncated snapshot after deserializing %d coins\n",
-                      coins_count - coins_left);
-            return false;
-        }
-        if (coin.nHeight > base_height ||
-            outpoint.n >= std::numeric_limits<decltype(outpoint.n)>::max() // Avoid integer wrap-around in coinstats.cpp:ApplyHash
-        ) {
-            LogPrintf("[snapshot] bad snapshot data after deserializing %d coins\n",
-                      coins_count - coins_left);
-            return false;
-        }
-        if (!MoneyRange(coin.out.nValue)) {
-            LogPrintf("[snapshot] bad snapshot data after deserializing %d coins - bad tx out value\n",
-                      coins_count - coins_left);
-            return false;
-        }
-
-        coins_cache.EmplaceCoinInternalDANGER(std::move(outpoint), std::move(coin));
+    // Coins are deserialized, checked and hashed on background threads, while
+    // this thread inserts them into the cache.
+    SnapshotCoinsReader reader{coins_file, coins_count, base_height};
 
-        --coins_left;
-        ++coins_processed;
+    while (auto batch{reader.Next()}) {
+        for (auto& [outpoint, coin] : *batch) {
+            coins_cache.EmplaceCoinInternalDANGER(std::move(outpoint), std::move(coin));
 
-        if (coins_processed % 1000000 == 0) {
-            LogPrintf("[snapshot] %d coins loaded (%.2f%%, %.2f MB)\n",
-                coins_processed,
-                static_cast<float>(coins_processed) * 100 / static_cast<float>(coins_count),
-                coins_cache.DynamicMemoryUsage() / (1000 * 1000));
-        }
+            ++coins_processed;
 
-        // Batch write and flush (if we need to) every so often.
-        //
-        // If our average Coin size is roughly 41 bytes, checking every 120,000 coins
-        // means <5MB of memory imprecision.
-        if (coins_processed % 120000 == 0) {
-            if (m_interrupt) {
-                return false;
+            if (coins_processed % 1000000 == 0) {
+                LogPrintf("[snapshot] %d coins loaded (%.2f%%, %.2f MB)\n",
+                    coins_processed,
+                    static_cast<float>(coins_processed) * 100 / static_cast<float>(coins_count),
+                    coins_cache.DynamicMemoryUsage() / (1000 * 1000));
             }
 
-            const auto snapshot_cache_state = WITH_LOCK(::cs_main,
-                return snapshot_chainstate.GetCoinsCacheSizeState());
+            // Batch write and flush (if we need to) every so often.
+            //
+            // If our average Coin size is roughly 41 bytes, checking every 120,000 coins
+            // means <5MB of memory imprecision.
+            if (coins_processed % 120000 == 0) {
+                if (m_interrupt) {
+                    return false;
+                }
 
-            if (snapshot_cache_state >= CoinsCacheSizeState::CRITICAL) {
-                // This is a hack - we don't know what the actual best block is, but that
-                // doesn't matter for the purposes of flushing the cache here. We'll set this
-                // to its correct value (`base_blockhash`) below after the coins are loaded.
-                coins_cache.SetBestBlock(GetRandHash());
+                const auto snapshot_cache_state = WITH_LOCK(::cs_main,
+                    return snapshot_chainstate.GetCoinsCacheSizeState());
 
-                // No need to acquire cs_main since this chainstate isn't being used yet.
-                FlushSnapshotToDisk(coins_cache, /*snapshot_loaded=*/false);
+                if (snapshot_cache_state >= CoinsCacheSizeState::CRITICAL) {
+                    // This is a hack - we don't know what the actual best block is, but that
+                    // doesn't matter for the purposes of flushing the cache here. We'll set this
+                    // to its correct value (`base_blockhash`) below after the coins are loaded.
+                    coins_cache.SetBestBlock(GetRandHash());
+
+                    // No need to acquire cs_main since this chainstate isn't being used yet.
+                    FlushSnapshotToDisk(coins_cache, /*snapshot_loaded=*/false);
+                }
             }
         }
     }
 
+    // The reader has logged why the snapshot is bad.
+    if (!reader.Complete()) {
+        return false;
+    }
+
     // Important that we set this. This and the coins_cache accesses above are
     // sort of a layer violation, but either we reach into the innards of
     // CCoinsViewCache here or we have to invert some of the Chainstate to
@@ -5479,19 +5764,6 @@ bool ChainstateManager::PopulateAndValidateSnapshot(
     // method.
     coins_cache.SetBestBlock(base_blockhash);
 
-    bool out_of_coins{false};
-    try {
-        coins_file >> outpoint;
-    } catch (const std::ios_base::failure&) {
-        // We expect an exception since we should be out of coins.
-        out_of_coins = true;
-    }
-    if (!out_of_coins) {
-        LogPrintf("[snapshot] bad snapshot - coins left over after deserializing %d coins\n",
-            coins_count);
-        return false;
-    }
-
     LogPrintf("[snapshot] loaded %d (%.2f MB) coins from snapshot %s\n",
         coins_count,
         coins_cache.DynamicMemoryUsage() / (1000 * 1000),
@@ -5502,27 +5774,34 @@ bool ChainstateManager::PopulateAndValidateSnapshot(
 
     assert(coins_cache.GetBestBlock() == base_blockhash);
 
-    // As above, okay to immediately release cs_main here since no other context knows
-    // about the snapshot_chainstate.
-    CCoinsViewDB* snapshot_coinsdb = WITH_LOCK(::cs_main, return &snapshot_chainstate.CoinsDB());
+    // The reader hashed the coins as they were loaded. That is the hash of the
+    // loaded coins database too, unless the snapshot held them in a different
+    // order, in which case the database has to be hashed.
+    std::optional<uint256> hash_serialized{reader.Commitment()};
+    if (!hash_serialized) {
+        // As above, okay to immediately release cs_main here since no other context knows
+        // about the snapshot_chainstate.
+        CCoinsViewDB* snapshot_coinsdb = WITH_LOCK(::cs_main, return &snapshot_chainstate.CoinsDB());
 
-    std::optional<CCoinsStats> maybe_stats;
+        std::optional<CCoinsStats> maybe_stats;
 
-    try {
-        maybe_stats = ComputeUTXOStats(
-            CoinStatsHashType::HASH_SERIALIZED, snapshot_coinsdb, m_blockman, [&interrupt = m_interrupt] { SnapshotUTXOHashBreakpoint(interrupt); });
-    } catch (StopHashingException const&) {
-        return false;
-    }
-    if (!maybe_stats.has_value()) {
-        LogPrintf("[snapshot] failed to generate coins stats\n");
-        return false;
+        try {
+            maybe_stats = ComputeUTXOStats(
+                CoinStatsHashType::HASH_SERIALIZED, snapshot_coinsdb, m_blockman, [&interrupt = m_interrupt] { SnapshotUTXOHashBreakpoint(interrupt); });
+        } catch (StopHashingException const&) {
+            return false;
+        }
+        if (!maybe_stats.has_value()) {
+            LogPrintf("[snapshot] failed to generate coins stats\n");
+            return false;
+        }
+        hash_serialized = maybe_stats->hashSerialized;
     }
 
     // Assert that the deserialized chainstate contents match the expected assumeutxo value.
-    if (AssumeutxoHash{maybe_stats->hashSerialized} != au_data.hash_serialized) {
+    if (AssumeutxoHash{*hash_serialized} != au_data.hash_serialized) {
         LogPrintf("[snapshot] bad snapshot content hash: expected %s, got %s\n",
-            au_data.hash_serialized.ToString(), maybe_stats->hashSerialized.ToString());
+            au_data.hash_serialized.ToString(), hash_serialized->ToString());
         return false;
     }
 
@@ -5797,10 +6076,13 @@ static ChainstateManager::Options&& Flatten(ChainstateManager::Options&& opts)
 
 ChainstateManager::ChainstateManager(const util::SignalInterrupt& interrupt, Options options, node::BlockManager::Options blockman_options)
     : m_script_check_queue{/*batch_size=*/128, options.worker_threads_num},
+      m_header_pow_check_queue{/*batch_size=*/1, options.worker_threads_num, "powcheck"},
       m_interrupt{interrupt},
       m_options{Flatten(std::move(options))},
-      m_blockman{interrupt, std::move(blockman_options)}
+      m_blockman{interrupt, std::move(blockman_options)},
+      m_block_prevalidator{m_blockman, m_options.chainparams.GetConsensus(), m_options.worker_threads_num}
 {
+    ethash::set_max_resident_epoch_contexts(ethash::default_max_resident_epoch_contexts + m_options.pow_epoch_lookahead);
 }
 
 ChainstateManager::~ChainstateManager()
@@ -17,11 +17,13 @@
 #include <kernel/chainparams.h>
 #include <kernel/chainstatemanager_opts.h>
 #include <kernel/cs_main.h> // IWYU pragma: export
+#include <node/block_prevalidator.h>
 #include <node/blockstorage.h>
 #include <policy/feerate.h>
 #include <policy/packages.h>
 #include <policy/policy.h>
 #include <script/script_error.h>
+#include <span.h>
 #include <sync.h>
 #include <txdb.h>
 #include <txmempool.h> // For CTxMemPool::cs
@@ -34,6 +36,7 @@
 #include <versionbits.h>
 
 #include <atomic>
+#include <functional>
 #include <map>
 #include <memory>
 #include <optional>
@@ -360,6 +363,36 @@ static_assert(std::is_nothrow_move_assignable_v<CScriptCheck>);
 static_assert(std::is_nothrow_move_constructible_v<CScriptCheck>);
 static_assert(std::is_nothrow_destructible_v<CScriptCheck>);
 
+/**
+ * Closure representing the proof-of-work verification of a run of headers:
+ * the final hash of each header against its nBits, and the ProgPoW mix of the
+ * headers selected by check_mix.
+ * Note that this stores references to the headers and consensus parameters
+ */
+class CHeaderPowCheck
+{
+private:
+    Span<const CBlockHeader> m_headers;
+    std::vector<bool> m_check_mix;
+    const Consensus::Params* m_params;
+
+public:
+    CHeaderPowCheck(Span<const CBlockHeader> headers, std::vector<bool> check_mix, const Consensus::Params& params) :
+        m_headers(headers), m_check_mix(std::move(check_mix)), m_params(&params) { }
+
+    CHeaderPowCheck(const CHeaderPowCheck&) = delete;
+    CHeaderPowCheck& operator=(const CHeaderPowCheck&) = delete;
+    CHeaderPowCheck(CHeaderPowCheck&&) = default;
+    CHeaderPowCheck& operator=(CHeaderPowCheck&&) = default;
+
+    bool operator()();
+};
+
+/** Number of consecutive headers verified by one CHeaderPowCheck */
+static constexpr size_t HEADERS_POW_CHECK_CHUNK{16};
+/** With HeadersMixCheck::SAMPLE, the mix of one in this many headers is verified on average */
+static constexpr int HEADERS_MIX_SAMPLE_RATE{32};
+
 /** Initializes the script-execution cache */
 [[nodiscard]] bool InitScriptExecutionCache(size_t max_size_bytes);
 
@@ -377,8 +410,22 @@ bool TestBlockValidity(BlockValidationState& state,
                        bool fCheckPOW = true,
                        bool fCheckMerkleRoot = true) EXCLUSIVE_LOCKS_REQUIRED(cs_main);
 
-/** Check with the proof of work on each blockheader matches the value in nBits */
-bool HasValidProofOfWork(const std::vector<CBlockHeader>& headers, const Consensus::Params& consensusParams);
+/**
+ * Check with the proof of work on each blockheader matches the value in nBits.
+ *
+ * The final hash of every header is checked. Depending on mix_check, the
+ * ProgPoW mix of none, a random sample, or all of the headers is verified as
+ * well; the sample always includes the last header. Verified mixes are
+ * remembered by CheckProofOfWorkMix(), so accepting the headers afterwards
+ * does not recompute them. A mix needs the light cache of the epoch given by
+ * nHeight, so it must only be checked for headers whose height is known to be
+ * right.
+ *
+ * The headers are split into chunks of HEADERS_POW_CHECK_CHUNK that are
+ * verified on the threads of queue, or on the calling thread if it is null.
+ */
+bool HasValidProofOfWork(Span<const CBlockHeader> headers, const Consensus::Params& consensusParams,
+                         HeadersMixCheck mix_check = HeadersMixCheck::NONE, CCheckQueue<CHeaderPowCheck>* queue = nullptr);
 
 /** Check if a block has been mutated (with respect to its merkle root and witness commitments). */
 bool IsBlockMutated(const CBlock& block, bool check_witness_root);
@@ -447,11 +494,18 @@ public:
     //! This view wraps access to the leveldb instance and handles read errors gracefully.
     CCoinsViewErrorCatcher m_catcherview GUARDED_BY(cs_main);
 
+    //! This view writes the cache to the database on a background thread with -backgroundflush.
+    CCoinsViewBackgroundFlush m_flushview GUARDED_BY(cs_main);
+
+    //! This view serves coins read ahead of use by the BlockPrevalidator.
+    CCoinsViewPrefetch m_prefetchview GUARDED_BY(cs_main);
+
     //! This is the top layer of the cache hierarchy - it keeps as many coins in memory as
     //! can fit per the dbcache setting.
     std::unique_ptr<CCoinsViewCache> m_cacheview GUARDED_BY(cs_main);
 
-    //! This constructor initializes CCoinsViewDB and CCoinsViewErrorCatcher instances, but it
+    //! This constructor initializes the CCoinsViewDB, CCoinsViewErrorCatcher, CCoinsViewBackgroundFlush and
+    //! CCoinsViewPrefetch instances, but it
     //! *does not* create a CCoinsViewCache instance by default. This is done separately because the
     //! presence of the cache has implications on whether or not we're allowed to flush the cache's
     //! state to disk, which should not be done until the health of the database is verified.
@@ -620,6 +674,13 @@ public:
         return Assert(m_coins_views)->m_catcherview;
     }
 
+    //! @returns Statistics of the writes of the coins cache to the database.
+    CCoinsViewBackgroundFlush::Stats GetCoinsFlushStats() const EXCLUSIVE_LOCKS_REQUIRED(::cs_main)
+    {
+        AssertLockHeld(::cs_main);
+        return Assert(m_coins_views)->m_flushview.GetStats();
+    }
+
     //! Destructs all objects related to accessing the UTXO set.
     void ResetCoinsViews() { m_coins_views.reset(); }
 
@@ -785,6 +846,9 @@ private:
 
     SteadyClock::time_point m_last_write{};
     SteadyClock::time_point m_last_flush{};
+    //! Locator of the last full flush whose coins are still written in the
+    //! background. ChainStateFlushed() is only signalled once they are on disk.
+    std::optional<CBlockLocator> m_unsignalled_flush GUARDED_BY(::cs_main);
 
     /**
      * In case of an invalid snapshot, rename the coins leveldb directory so
@@ -920,6 +984,33 @@ private:
     //! A queue for script verifications that have to be performed by worker threads.
     CCheckQueue<CScriptCheck> m_script_check_queue;
 
+    //! A queue for the proof-of-work verification of headers received from peers.
+    CCheckQueue<CHeaderPowCheck> m_header_pow_check_queue;
+
+    enum class ExternalBlockResult {
+        DONE,     //!< The block was processed or skipped
+        DEFERRED, //!< The block's position was added to blocks_with_unknown_parent
+        STOP,     //!< No more blocks should be read from the file
+    };
+
+    /**
+     * Internal helper for LoadExternalBlockFile() and LoadExternalBlockFiles():
+     * process a block found in an external file, and then any blocks read before
+     * it that were waiting for it as their parent.
+     *
+     * @param[in]     header      Header of the block, read from the file
+     * @param[in]     read_block  Returns the full block, if it is to be processed
+     * @param[in]     read_child  Returns the block at a position taken from
+     *                            blocks_with_unknown_parent, or null if it can't be read
+     */
+    ExternalBlockResult ImportExternalBlock(
+        const CBlockHeader& header,
+        const std::function<std::shared_ptr<CBlock>()>& read_block,
+        const std::function<std::shared_ptr<CBlock>(const FlatFilePos&)>& read_child,
+        FlatFilePos* dbp,
+        std::multimap<uint256, FlatFilePos>* blocks_with_unknown_parent,
+        int& nLoaded);
+
 public:
     using Options = kernel::ChainstateManagerOpts;
 
@@ -963,6 +1054,9 @@ public:
     //! chainstate to avoid duplicating block metadata.
     node::BlockManager m_blockman;
 
+    //! Checks blocks on worker threads ahead of ConnectTip().
+    node::BlockPrevalidator m_block_prevalidator;
+
     /**
      * Whether initial block download has ended and IsInitialBlockDownload
      * should return false from now on.
@@ -1135,6 +1229,17 @@ public:
         FlatFilePos* dbp = nullptr,
         std::multimap<uint256, FlatFilePos>* blocks_with_unknown_parent = nullptr);
 
+    /**
+     * Import blocks from a sequence of external files, as LoadExternalBlockFile()
+     * does for each of them. With reindex, the files are the block files in
+     * order, and blocks with unknown parent are tracked across them.
+     *
+     * With worker threads, the files are read and the blocks checked on the
+     * worker threads (see node::BlockFileScanner), while blocks are still
+     * accepted in file order on the calling thread.
+     */
+    void LoadExternalBlockFiles(const std::vector<fs::path>& files, bool reindex);
+
     /**
      * Process an incoming block. This only returns after the best known valid
      * block is made active. Note that it does not, however, guarantee that the
@@ -1272,6 +1377,16 @@ public:
 
     CCheckQueue<CScriptCheck>& GetCheckQueue() { return m_script_check_queue; }
 
+    node::BlockPrevalidator& GetBlockPrevalidator() { return m_block_prevalidator; }
+
+    /**
+     * Check the final hash of each header with HasValidProofOfWork(), in
+     * parallel on the -par threads. The mix is not verified, as the headers
+     * may not connect to a known block, so their nHeight is unchecked. Blocks
+     * until all headers are checked, so it must not be called with cs_main held.
+     */
+    bool HasValidProofOfWork(const std::vector<CBlockHeader>& headers) LOCKS_EXCLUDED(::cs_main);
+
     ~ChainstateManager();
 };
 
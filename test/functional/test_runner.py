@@ -256,6 +256,7 @@ BASE_SCRIPTS = [
     'rpc_setban.py --v2transport',
     'p2p_blocksonly.py',
     'mining_prioritisetransaction.py',
+    'mining_progpowwork.py',
     'p2p_invalid_locator.py',
     'p2p_invalid_block.py',
     'p2p_invalid_block.py --v2transport',